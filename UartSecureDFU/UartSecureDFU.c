@@ -2,11 +2,117 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "uart_drv.h"
 #include "uart_slip.h"
 #include "dfu.h"
+#include "dfu_serial.h"
+#include "fleet.h"
+#include "hotplug.h"
 #include "logging.h"
+#include "service.h"
+#include "sys_time.h"
+
+// prefix of the serial port selecting the daemon mode
+#define DAEMON_PORT_PREFIX      "hotplug:"
+
+// prefix of the serial port selecting the service mode
+#define SERVICE_PORT_PREFIX     "service:"
+
+// prefix of the serial port selecting the fleet mode
+#define FLEET_PORT_PREFIX       "batch:"
+
+// maximum number of device matches in daemon mode
+#define DAEMON_MATCH_MAX        8
+
+// maximum number of devices updated at once in daemon mode
+#define DAEMON_SESSION_MAX      16
+
+// time given to the transfers to abort after SIGINT or SIGTERM, in seconds
+#define ABORT_TIMEOUT_S         5
+
+typedef struct
+{
+	uart_drv_t uart;                    //!< Device port.
+	dfu_package_t *p_pkg;               //!< Package, images loaded.
+	int skip_installed;                 //!< Skip the images the target already runs.
+	char dev_name[HOTPLUG_NAME_MAX];    //!< Device node.
+	char serial[HOTPLUG_SERIAL_MAX];    //!< USB serial number.
+	int err_code;                       //!< Update result.
+	int active;                         //!< Session slot in use.
+	int done;                           //!< Update finished, the slot may be reused.
+#ifndef WIN32
+	pthread_t thread;
+	int started;                        //!< Session thread started.
+#endif
+} daemon_session_t;
+
+#ifndef WIN32
+static pthread_mutex_t daemon_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// set on SIGINT or SIGTERM, the transfers in progress are aborted
+static volatile int dfu_cancel;
+
+#ifndef WIN32
+// a transfer did not stop in time, or a second signal came: the process ends at once,
+// the serial ports are left as they were found
+static void on_abort(int sig)
+{
+	(void)sig;
+
+	uart_tty_restore_all();
+
+	_exit(1);
+}
+#endif
+
+static void on_signal(int sig)
+{
+#ifndef WIN32
+	if (dfu_cancel)
+		on_abort(sig);
+#endif
+
+	dfu_cancel = 1;
+
+#ifndef WIN32
+	// the process ends even if a transfer does not stop, a second signal ends it at once
+	alarm(ABORT_TIMEOUT_S);
+#else
+	signal(sig, SIG_DFL);
+#endif
+}
+
+// abort the transfers on SIGINT or SIGTERM, leaving the target ready for the next run
+// instead of waiting for its inactivity timeout
+static void set_signal_handlers(void)
+{
+#ifndef WIN32
+	struct sigaction action;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = on_signal;
+	sigemptyset(&action.sa_mask);
+	// the blocking reads and waits return at once
+	action.sa_flags = 0;
+
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	action.sa_handler = on_abort;
+	sigaction(SIGALRM, &action, NULL);
+#else
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+#endif
+}
 
 
 static int is_argv_verbose(char *p_argv)
@@ -21,6 +127,281 @@ static int is_argv_verbose(char *p_argv)
 	return err_code;
 }
 
+// check the targets on a comma separated list of ports against a package
+static int verify_ports(char *portNames, char *zipName, const uart_drv_t *p_uart_cfg)
+{
+	int err_code = 0;
+	int num_ports = 1;
+	uart_drv_t *p_uarts;
+	dfu_verify_t *p_verify;
+	char *p_name;
+	int i;
+
+	for (i = 0; portNames[i]; i++)
+	{
+		if (portNames[i] == ',')
+			num_ports++;
+	}
+
+	p_uarts = (uart_drv_t *)calloc(num_ports, sizeof(uart_drv_t));
+	p_verify = (dfu_verify_t *)calloc(num_ports, sizeof(dfu_verify_t));
+
+	if (p_uarts == NULL || p_verify == NULL)
+	{
+		logger_error("Cannot allocate memory!");
+
+		err_code = 1;
+	}
+
+	if (!err_code)
+	{
+		p_name = strtok(portNames, ",");
+
+		for (i = 0; i < num_ports && p_name != NULL; i++)
+		{
+			p_uarts[i] = *p_uart_cfg;
+			p_uarts[i].p_PortName = p_name;
+			// a session record is kept for a single port only
+			if (num_ports > 1)
+				p_uarts[i].p_RecordName = NULL;
+
+			p_verify[i].err_code = 1;
+
+			if (!uart_slip_open(p_uarts + i))
+				p_verify[i].p_uart = p_uarts + i;
+
+			p_name = strtok(NULL, ",");
+		}
+		num_ports = i;
+
+		err_code = dfu_verify_package(zipName, p_verify, num_ports);
+
+		for (i = 0; i < num_ports; i++)
+		{
+			printf("%s: %s (%.1f ms)\n", p_uarts[i].p_PortName, p_verify[i].err_code ? "FAIL" : "PASS",
+				p_verify[i].time_us / 1000.0);
+
+			if (p_verify[i].p_uart != NULL)
+				uart_slip_close(p_uarts + i);
+		}
+	}
+
+	free(p_uarts);
+	free(p_verify);
+
+	return err_code;
+}
+
+static void *daemon_session_thread(void *p_context)
+{
+	daemon_session_t *p_session = (daemon_session_t *)p_context;
+	uint64_t time_us = sys_time_us();
+	int err_code;
+
+	err_code = uart_slip_open(&p_session->uart);
+
+	if (!err_code)
+	{
+		err_code = dfu_send_loaded_package(&p_session->uart, p_session->p_pkg, p_session->skip_installed, NULL);
+
+		uart_slip_close(&p_session->uart);
+	}
+
+	printf("%s%s%s: %s (%.1f s)\n", p_session->dev_name, p_session->serial[0] ? " " : "", p_session->serial,
+		err_code ? "FAIL" : "PASS", (sys_time_us() - time_us) / 1000000.0);
+	fflush(stdout);
+
+#ifndef WIN32
+	pthread_mutex_lock(&daemon_lock);
+#endif
+	p_session->err_code = err_code;
+	p_session->done = 1;
+#ifndef WIN32
+	pthread_mutex_unlock(&daemon_lock);
+#endif
+
+	return NULL;
+}
+
+// free the slots of the sessions finished, returns the number of failed updates
+static int daemon_reap(daemon_session_t *p_sessions, int wait)
+{
+	int num_failed = 0;
+	int i, done;
+
+	for (i = 0; i < DAEMON_SESSION_MAX; i++)
+	{
+		if (!p_sessions[i].active)
+			continue;
+
+#ifndef WIN32
+		pthread_mutex_lock(&daemon_lock);
+#endif
+		done = p_sessions[i].done;
+#ifndef WIN32
+		pthread_mutex_unlock(&daemon_lock);
+#endif
+		if (!done && !wait)
+			continue;
+
+#ifndef WIN32
+		if (p_sessions[i].started)
+			pthread_join(p_sessions[i].thread, NULL);
+#endif
+		if (p_sessions[i].err_code)
+			num_failed++;
+
+		p_sessions[i].active = 0;
+	}
+
+	return num_failed;
+}
+
+static daemon_session_t *daemon_find(daemon_session_t *p_sessions, const char *p_dev_name)
+{
+	int i;
+
+	for (i = 0; i < DAEMON_SESSION_MAX; i++)
+	{
+		if (p_sessions[i].active && !strcmp(p_sessions[i].dev_name, p_dev_name))
+			return p_sessions + i;
+	}
+
+	return NULL;
+}
+
+// update every matching device as soon as it is plugged in, until the end of the events
+static int run_daemon(char *matchList, char *zipName, const uart_drv_t *p_uart_cfg, const char *p_event_file, int skip_installed)
+{
+	int err_code = 0;
+	hotplug_match_t match[DAEMON_MATCH_MAX];
+	int num_match = 0;
+	daemon_session_t *p_sessions = NULL;
+	daemon_session_t *p_session;
+	dfu_package_t *p_pkg = NULL;
+	hotplug_t hotplug;
+	hotplug_event_t event;
+	int num_started = 0, num_failed = 0;
+	char *p_str;
+	int i;
+
+	for (p_str = strtok(matchList, ","); p_str != NULL && !err_code; p_str = strtok(NULL, ","))
+	{
+		if (num_match >= DAEMON_MATCH_MAX)
+		{
+			logger_error("Too many device matches!");
+
+			err_code = 1;
+		}
+		else
+		{
+			err_code = hotplug_parse_match(p_str, match + num_match++);
+		}
+	}
+
+	if (!err_code)
+	{
+		p_sessions = (daemon_session_t *)calloc(DAEMON_SESSION_MAX, sizeof(daemon_session_t));
+
+		if (p_sessions == NULL)
+		{
+			logger_error("Cannot allocate memory!");
+
+			err_code = 1;
+		}
+	}
+
+	// the package is decompressed once and shared by all the updates
+	if (!err_code)
+		err_code = dfu_package_load(zipName, &p_pkg);
+
+	if (!err_code)
+		err_code = hotplug_open(&hotplug, p_event_file);
+
+	if (err_code)
+	{
+		free(p_sessions);
+		dfu_package_free(p_pkg);
+
+		return err_code;
+	}
+
+	logger_info_1("Waiting for devices...");
+
+	while (!hotplug_next(&hotplug, &event))
+	{
+		num_failed += daemon_reap(p_sessions, 0);
+
+		p_session = daemon_find(p_sessions, event.dev_name);
+
+		if (event.action == HOTPLUG_REMOVE)
+		{
+			if (p_session != NULL)
+				logger_info_1("%s removed during the update!", event.dev_name);
+
+			continue;
+		}
+
+		if (!hotplug_is_match(&event, match, num_match))
+		{
+			logger_info_2("%s (%04x:%04x) ignored.", event.dev_name, event.vid, event.pid);
+
+			continue;
+		}
+
+		if (p_session != NULL)
+			continue;
+
+		for (i = 0; i < DAEMON_SESSION_MAX && p_sessions[i].active; i++)
+			;
+
+		if (i >= DAEMON_SESSION_MAX)
+		{
+			logger_error("Too many devices, %s not updated!", event.dev_name);
+
+			num_failed++;
+
+			continue;
+		}
+
+		p_session = p_sessions + i;
+		memset(p_session, 0, sizeof(*p_session));
+
+		strcpy(p_session->dev_name, event.dev_name);
+		strcpy(p_session->serial, event.serial);
+		p_session->p_pkg = p_pkg;
+		p_session->skip_installed = skip_installed;
+		p_session->uart = *p_uart_cfg;
+		p_session->uart.p_PortName = p_session->dev_name;
+		// a session record is kept for a single port only
+		p_session->uart.p_RecordName = NULL;
+		p_session->active = 1;
+
+		logger_info_1("Updating %s.", event.dev_name);
+
+		num_started++;
+
+#ifndef WIN32
+		p_session->started = !pthread_create(&p_session->thread, NULL, daemon_session_thread, p_session);
+
+		if (!p_session->started)
+#endif
+		{
+			daemon_session_thread(p_session);
+		}
+	}
+
+	num_failed += daemon_reap(p_sessions, 1);
+
+	logger_info_1("%d devices updated, %d failed.", num_started, num_failed);
+
+	hotplug_close(&hotplug);
+	free(p_sessions);
+	dfu_package_free(p_pkg);
+
+	return num_failed > 0;
+}
+
 int main(int argc, char *argv[])
 {
 	int err_code = 0;
@@ -28,9 +409,27 @@ int main(int argc, char *argv[])
 	char *portName = NULL;
 	uart_drv_t uart_drv;
 	char *zipName = NULL;
+	char *recordName = NULL;
+	char *profileName = NULL;
+	char *eventName = NULL;
+	char *etaLogName = NULL;
+	char *journalName = NULL;
+	int replayRealtime = 0;
+	int rxThread = 0;
+	int slipResync = 0;
+	int skipInstalled = 0;
+	int verify = 0;
+	uint32_t baudRate = 0;
+	uint32_t batchSize = UART_SLIP_BATCH_SIZE_DEF;
+	uint32_t frameCap = 0;
+	uint32_t keepalivePercent = DFU_KEEPALIVE_PERCENT_DEF;
+	uint32_t targetTimeout = 0;
+	int maxJobs = SERVICE_JOBS_DEF;
 	int argn;
 	int info_lvl = LOGGER_INFO_LVL_0;
 
+	memset(&uart_drv, 0, sizeof(uart_drv));
+
 	if (argc >= 2 && strlen(argv[1]) > 0)
 		portName = argv[1];
 	else
@@ -49,15 +448,79 @@ int main(int argc, char *argv[])
 
 	for (argn = 3; argn < argc && !err_code; argn++)
 	{
-		err_code = is_argv_verbose(argv[argn]);
-		if (!err_code)
+		if (!strcmp(argv[argn], "--record") && argn + 1 < argc)
 		{
-			info_lvl++;
+			recordName = argv[++argn];
+		}
+		else if (!strcmp(argv[argn], "--tune") && argn + 1 < argc)
+		{
+			profileName = argv[++argn];
+		}
+		else if (!strcmp(argv[argn], "--eta-log") && argn + 1 < argc)
+		{
+			etaLogName = argv[++argn];
+		}
+		else if (!strcmp(argv[argn], "--journal") && argn + 1 < argc)
+		{
+			journalName = argv[++argn];
+		}
+		else if (!strcmp(argv[argn], "--events") && argn + 1 < argc)
+		{
+			eventName = argv[++argn];
+		}
+		else if (!strcmp(argv[argn], "--baud") && argn + 1 < argc)
+		{
+			baudRate = strtoul(argv[++argn], NULL, 10);
+		}
+		else if (!strcmp(argv[argn], "--batch") && argn + 1 < argc)
+		{
+			batchSize = strtoul(argv[++argn], NULL, 10);
+		}
+		else if (!strcmp(argv[argn], "--frame-max") && argn + 1 < argc)
+		{
+			frameCap = strtoul(argv[++argn], NULL, 10);
+		}
+		else if (!strcmp(argv[argn], "--keepalive") && argn + 1 < argc)
+		{
+			keepalivePercent = strtoul(argv[++argn], NULL, 10);
+		}
+		else if (!strcmp(argv[argn], "--target-timeout") && argn + 1 < argc)
+		{
+			targetTimeout = strtoul(argv[++argn], NULL, 10);
+		}
+		else if (!strcmp(argv[argn], "--jobs") && argn + 1 < argc)
+		{
+			maxJobs = atoi(argv[++argn]);
 
-			logger_set_info_level(info_lvl);
+			if (maxJobs < 1)
+				maxJobs = 1;
+		}
+		else if (!strcmp(argv[argn], "--realtime"))
+		{
+			replayRealtime = 1;
+		}
+		else if (!strcmp(argv[argn], "--rx-thread"))
+		{
+			rxThread = 1;
+		}
+		else if (!strcmp(argv[argn], "--resync"))
+		{
+			slipResync = 1;
+		}
+		else if (!strcmp(argv[argn], "--skip-installed"))
+		{
+			skipInstalled = 1;
+		}
+		else if (!strcmp(argv[argn], "--verify"))
+		{
+			verify = 1;
+		}
+		else if (!is_argv_verbose(argv[argn]))
+		{
+			if (info_lvl < LOGGER_INFO_LVL_3)
+				info_lvl++;
 
-			if (info_lvl >= LOGGER_INFO_LVL_3)
-				break;
+			logger_set_info_level(info_lvl);
 		}
 		else
 		{
@@ -70,10 +533,73 @@ int main(int argc, char *argv[])
 
 	if (show_usage)
 	{
-		printf("Usage: UartSecureDFU serial_port package_name [-v] [-v] [-v]\n");
+		printf("Usage: UartSecureDFU serial_port package_name [-v] [-v] [-v] [--baud rate] [--batch bytes] [--frame-max bytes] [--record file] [--realtime] [--tune file] [--skip-installed] [--verify] [--events file] [--jobs n] [--eta-log file] [--journal file] [--keepalive percent] [--target-timeout ms] [--rx-thread] [--resync]\n");
+		printf("  package_name may be %s to read the package from the standard input.\n", DFU_PKG_STDIN);
+		printf("  serial_port is a TTY name or path, tcp:<host>:<port> for a raw TCP serial server\n");
+		printf("  or rfc2217:<host>:<port> for a TCP serial server with remote bit rate control.\n");
+		printf("  serial_port may be replay:<file> to play back a session recorded with --record,\n");
+		printf("  as fast as possible or at the recorded speed with --realtime.\n");
+		printf("  serial_port may be hotplug:<vid>:<pid>[:<serial>][,...] to update every matching\n");
+		printf("  USB device as soon as it is plugged in, '*' matching any value. --events reads\n");
+		printf("  the device events from a file instead of the system, for testing.\n");
+		printf("  serial_port may be service:<socket> to run flash and verify jobs received on a\n");
+		printf("  Unix socket, --jobs at once, package_name being the default package.\n");
+		printf("  serial_port may be batch:<file> to update at once the ports listed in a file, one\n");
+		printf("  per line with its package, package_name being the default package.\n");
+		printf("  --tune probes the fastest reliable frame size and receipt notification window\n");
+		printf("  once per device and keeps it in the given profile file.\n");
+		printf("  --eta-log appends the predicted and actual firmware transfer times to a CSV file.\n");
+		printf("  --journal keeps the progress of each transfer in a file, a transfer interrupted\n");
+		printf("  by a host crash or restart resumes from the last image and object completed.\n");
+		printf("  --frame-max caps the frames sent, which take the size the target MTU allows\n");
+		printf("  (up to %d bytes by default).\n", UART_SLIP_SIZE_CAP_DEF);
+		printf("  --keepalive pings the target once the link is idle for this share of its timeout\n");
+		printf("  (%d%% by default, 0 never), --target-timeout being the shortest bootloader timeout\n", DFU_KEEPALIVE_PERCENT_DEF);
+		printf("  (NRF_BL_DFU_CONTINUATION_TIMEOUT_MS, %d ms by default).\n", DFU_CONTINUATION_TIMEOUT_MS);
+		printf("  --rx-thread receives from a TTY port on a thread of its own, as the frames arrive.\n");
+		printf("  --resync drops malformed frames and line noise, and sends a request again once if its response is lost.\n");
+		printf("  --skip-installed leaves out the images whose version the target already runs.\n");
+		printf("  --verify only checks that the target runs the package, serial_port may then be\n");
+		printf("  a comma separated list of ports checked in parallel.\n");
 	}
 
 	uart_drv.p_PortName = portName;
+	uart_drv.p_RecordName = recordName;
+	uart_drv.p_ProfileName = profileName;
+	uart_drv.p_EtaLogName = etaLogName;
+	uart_drv.p_JournalName = journalName;
+	uart_drv.replay_realtime = replayRealtime;
+	uart_drv.baud_rate = baudRate;
+	uart_drv.tx_batch_size = batchSize;
+	uart_drv.frame_size_cap = frameCap;
+	uart_drv.keepalive_percent = keepalivePercent;
+	uart_drv.target_timeout_ms = targetTimeout;
+	uart_drv.rx_thread = rxThread;
+	uart_drv.slip_resync = slipResync;
+	uart_drv.p_cancel = &dfu_cancel;
+
+	if (!err_code)
+		set_signal_handlers();
+
+	if (!err_code && !strncmp(portName, SERVICE_PORT_PREFIX, strlen(SERVICE_PORT_PREFIX)))
+	{
+		return service_run(portName + strlen(SERVICE_PORT_PREFIX), zipName, &uart_drv, maxJobs);
+	}
+
+	if (!err_code && !strncmp(portName, FLEET_PORT_PREFIX, strlen(FLEET_PORT_PREFIX)))
+	{
+		return fleet_run(portName + strlen(FLEET_PORT_PREFIX), zipName, &uart_drv, skipInstalled);
+	}
+
+	if (!err_code && !strncmp(portName, DAEMON_PORT_PREFIX, strlen(DAEMON_PORT_PREFIX)))
+	{
+		return run_daemon(portName + strlen(DAEMON_PORT_PREFIX), zipName, &uart_drv, eventName, skipInstalled);
+	}
+
+	if (!err_code && verify)
+	{
+		return verify_ports(portName, zipName, &uart_drv);
+	}
 
 	if (!err_code)
 	{
@@ -84,14 +610,21 @@ int main(int argc, char *argv[])
 	{
 		dfu_param_t dfu_param;
 
+		memset(&dfu_param, 0, sizeof(dfu_param));
 		dfu_param.p_uart = &uart_drv;
 		dfu_param.p_pkg_file = zipName;
+		dfu_param.skip_installed = skipInstalled;
 		err_code = dfu_send_package(&dfu_param);
 	}
 
 	if (!show_usage)
 	{
-		int err_code2 = uart_slip_close(&uart_drv);
+		int err_code2;
+
+		logger_info_1("UART: %u frames sent in %u writes, %u reads.",
+			uart_drv.stats.tx_frames, uart_drv.stats.tx_calls, uart_drv.stats.rx_calls);
+
+		err_code2 = uart_slip_close(&uart_drv);
 		
 		if (!err_code)
 			err_code = err_code2;
@@ -55,6 +55,16 @@
 extern "C" {
 #endif
 
+/**@brief Byte lookup table for the CRC-32 polynomial. */
+extern const uint32_t crc32_table[256];
+
+/**@brief Update a running CRC-32 register with one byte.
+ *
+ * The register holds the inverted CRC-32, i.e. it starts as 0xFFFFFFFF (or as the inverted
+ * result of a previous crc32_compute() call) and is inverted again to get the final value.
+ */
+#define CRC32_UPDATE(crc, byte)     (crc32_table[((crc) ^ (byte)) & 0xFF] ^ ((crc) >> 8))
+
 /**@brief Function for calculating CRC-32 in blocks.
  *
  * Feed each consecutive data block into this function, along with the current value of p_crc as
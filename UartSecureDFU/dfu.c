@@ -41,18 +41,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#endif
 #include "dfu.h"
 #include "dfu_serial.h"
+#include "crc32.h"
 #include "delay_connect.h"
+#include "init_packet.h"
+#include "journal.h"
 #include "logging.h"
+#include "sys_time.h"
 #include "zip.h"
-#include "jsmn.h"
+#include "manifest.h"
 
-// maximum number of JSON tokens to process
-#define JSON_TOKEN_NUM_MAX              30
+// maximum number of DFU images to send, one per image type
+#define DFU_OBJECT_NUM_MAX              DFU_IMAGE_NUM_MAX
 
-// maximum number of DFU objects to process
-#define DFU_OBJECT_NUM_MAX              3
+// first buffer size to read a package from a file descriptor, doubled as needed
+#define DFU_PKG_READ_SIZE               0x10000
+
+// maximum number of installed images to query
+#define DFU_INSTALLED_NUM_MAX           3
+
+// SoftDevice information structure, offsets in the SoftDevice BIN file
+#define SD_INFO_MAGIC_OFFSET            0x2004
+#define SD_INFO_VERSION_OFFSET          0x2014
+#define SD_INFO_MAGIC                   0x51B1E5DB
 
 typedef enum {
 	DFU_IMG_NIL = 0,                    //!< DFU image invalid
@@ -62,31 +81,60 @@ typedef enum {
 	DFU_IMG_SD_BL = 4                   //!< DFU SoftDevice & bootloader image
 } dfu_image_type_t;
 
-typedef enum {
-	STR_UNDEFINED = 0,
-	STR_FILE_BIN = 1,
-	STR_FILE_DAT = 2
-} dfu_json_str_t;
-
-typedef struct {
-	jsmntype_t type;                    //!< Token type.
-	int size;                           //!< Number of child tokens.
-	char *str;                          //!< String value.
-	dfu_json_str_t str_type;            //!< String usage type.
-} jsmn_entity_t;
-
 typedef struct {
 	dfu_image_type_t img_type;          //!< DFU image type.
-	const jsmn_entity_t *p_pattern;     //!< JSMN token pattern.
-} dfu_image_jsmn_pattern;
+	const char *p_key;                  //!< Manifest key.
+} dfu_image_key_t;
 
 typedef struct
 {
+	const manifest_image_t *p_obj;      //!< Manifest image.
 	dfu_image_type_t img_type;          //!< DFU image type.
 
-	char *file_bin;                     //!< BIN file name.
-	char *file_dat;                     //!< DAT file name.
-} dfu_json_object_t;
+	uint8_t *p_img_dat;                 //!< Image DAT pointer.
+	size_t n_dat_size;                  //!< Image DAT size.
+	uint8_t *p_img_bin;                 //!< Image BIN pointer.
+	size_t n_bin_size;                  //!< Image BIN size.
+	uint32_t dat_crc;                   //!< Image DAT CRC-32, from the package.
+	uint32_t bin_crc;                   //!< Image BIN CRC-32, from the package.
+
+	int ready;                          //!< Image has been loaded.
+	int err_code;                       //!< Image load result.
+} dfu_image_t;
+
+typedef struct
+{
+	struct zip_t *p_zip;                //!< Package.
+	dfu_image_t images[DFU_OBJECT_NUM_MAX];     //!< Images in send order.
+	int num_images;                     //!< Number of images.
+	uint32_t pkg_hash;                  //!< Package identity.
+	int stop;                           //!< Stop loading images.
+#ifndef WIN32
+	pthread_t thread;                   //!< Image loader.
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int started;                        //!< Image loader started.
+#endif
+} dfu_prefetch_t;
+
+struct dfu_package_s
+{
+	struct zip_t *p_zip;                //!< Package.
+	uint8_t *p_zip_buf;                 //!< Package read from a file descriptor.
+	uint8_t *buf_json;                  //!< Manifest.
+	manifest_t manifest;                //!< Parsed manifest, its strings in buf_json.
+	dfu_prefetch_t prefetch;            //!< Images in send order.
+};
+
+typedef struct
+{
+	const dfu_package_t *p_pkg;         //!< Package, images loaded.
+	dfu_verify_t *p_verify;             //!< Port to check.
+#ifndef WIN32
+	pthread_t thread;
+	int started;                        //!< Checker thread started.
+#endif
+} dfu_verify_ctx_t;
 
 typedef struct
 {
@@ -96,327 +144,564 @@ typedef struct
 	uint32_t n_dat_size;                //!< Image DAT size.
 	uint8_t *p_img_bin;                 //!< Image BIN pointer.
 	uint32_t n_bin_size;                //!< Image BIN size.
+	uint32_t dat_crc;                   //!< Image DAT CRC-32.
+	uint32_t bin_crc;                   //!< Image BIN CRC-32.
+	dfu_plan_t *p_plan;                 //!< Firmware transfer prediction, NULL if not needed.
 } dfu_img_param_t;
 
-// JSON tokens
-static jsmntok_t json_tokens[JSON_TOKEN_NUM_MAX];
-
-// DFU objects
-static dfu_json_object_t dfu_objects[DFU_OBJECT_NUM_MAX];
-
-// JSMN token pattern for Manifest
-static const jsmn_entity_t dfu_mft_pattern[] =
+// manifest keys of the DFU images
+static const dfu_image_key_t dfu_image_keys[] =
 {
-	{ JSMN_OBJECT,    1, NULL,       STR_UNDEFINED },
-	{ JSMN_STRING,    1, "manifest", STR_UNDEFINED },
-	{ JSMN_UNDEFINED, 0, NULL,       STR_UNDEFINED }
+	{ DFU_IMG_APP,   "application"           },
+	{ DFU_IMG_BL,    "bootloader"            },
+	{ DFU_IMG_SD,    "softdevice"            },
+	{ DFU_IMG_SD_BL, "softdevice_bootloader" },
+	{ DFU_IMG_NIL,   NULL                    }
 };
 
-// JSMN token pattern for 1 DFU image
-static const jsmn_entity_t dfu_img_1_pattern[] =
+// DFU image send order
+static const dfu_image_type_t dfu_send_order[] =
 {
-	{ JSMN_OBJECT,    1, NULL,       STR_UNDEFINED },
-	{ JSMN_UNDEFINED, 0, NULL,       STR_UNDEFINED }
+	DFU_IMG_SD_BL,
+	DFU_IMG_SD,
+	DFU_IMG_BL,
+	DFU_IMG_APP,
+	DFU_IMG_NIL
 };
 
-// JSMN token pattern for 2 DFU images
-static const jsmn_entity_t dfu_img_2_pattern[] =
+static const char *dfu_img_name(dfu_image_type_t img_type)
 {
-	{ JSMN_OBJECT,    2, NULL,       STR_UNDEFINED },
-	{ JSMN_UNDEFINED, 0, NULL,       STR_UNDEFINED }
-};
+	switch (img_type)
+	{
+	case DFU_IMG_APP:   return "Application";
+	case DFU_IMG_BL:    return "Bootloader";
+	case DFU_IMG_SD:    return "SoftDevice";
+	case DFU_IMG_SD_BL: return "SoftDevice+Bootloader";
+	default:            return "unknown";
+	}
+}
 
-// JSMN token pattern for DFU application
-static const jsmn_entity_t dfu_app_pattern[] =
+static int dfu_send_image_data(dfu_img_param_t *p_dfu_img)
 {
-	{ JSMN_STRING,    1, "application", STR_UNDEFINED },
-	{ JSMN_OBJECT,    2, NULL,          STR_UNDEFINED },
-	{ JSMN_STRING,    1, "bin_file",    STR_UNDEFINED },
-	{ JSMN_STRING,    0, NULL,          STR_FILE_BIN  },
-	{ JSMN_STRING,    1, "dat_file",    STR_UNDEFINED },
-	{ JSMN_STRING,    0, NULL,          STR_FILE_DAT  },
-	{ JSMN_UNDEFINED, 0, NULL,          STR_UNDEFINED }
-};
+	int err_code;
 
-// JSMN token pattern for DFU bootloader
-static const jsmn_entity_t dfu_bl_pattern[] =
-{
-	{ JSMN_STRING,    1, "bootloader",  STR_UNDEFINED },
-	{ JSMN_OBJECT,    2, NULL,          STR_UNDEFINED },
-	{ JSMN_STRING,    1, "bin_file",    STR_UNDEFINED },
-	{ JSMN_STRING,    0, NULL,          STR_FILE_BIN  },
-	{ JSMN_STRING,    1, "dat_file",    STR_UNDEFINED },
-	{ JSMN_STRING,    0, NULL,          STR_FILE_DAT  },
-	{ JSMN_UNDEFINED, 0, NULL,          STR_UNDEFINED }
-};
+	err_code = dfu_serial_send_init_packet(p_dfu_img->p_uart, p_dfu_img->p_img_dat, p_dfu_img->n_dat_size, p_dfu_img->dat_crc);
 
-// JSMN token pattern for DFU SoftDevice
-static const jsmn_entity_t dfu_sd_pattern[] =
-{
-	{ JSMN_STRING,    1, "softdevice",  STR_UNDEFINED },
-	{ JSMN_OBJECT,    2, NULL,          STR_UNDEFINED },
-	{ JSMN_STRING,    1, "bin_file",    STR_UNDEFINED },
-	{ JSMN_STRING,    0, NULL,          STR_FILE_BIN  },
-	{ JSMN_STRING,    1, "dat_file",    STR_UNDEFINED },
-	{ JSMN_STRING,    0, NULL,          STR_FILE_DAT  },
-	{ JSMN_UNDEFINED, 0, NULL,          STR_UNDEFINED }
-};
+	if (!err_code)
+	{
+		err_code = dfu_serial_send_firmware(p_dfu_img->p_uart, p_dfu_img->p_img_bin, p_dfu_img->n_bin_size, p_dfu_img->bin_crc, p_dfu_img->p_plan);
+	}
 
-// JSMN token pattern for DFU SoftDevice & bootloader
-static const jsmn_entity_t dfu_sd_bl_pattern[] =
-{
-	{ JSMN_STRING,    1, "softdevice_bootloader",   STR_UNDEFINED },
-	{ JSMN_OBJECT,    3, NULL,                      STR_UNDEFINED },
-	{ JSMN_STRING,    1, "bin_file",                STR_UNDEFINED },
-	{ JSMN_STRING,    0, NULL,                      STR_FILE_BIN  },
-	{ JSMN_STRING,    1, "dat_file",                STR_UNDEFINED },
-	{ JSMN_STRING,    0, NULL,                      STR_FILE_DAT  },
-	{ JSMN_STRING,    1, "info_read_only_metadata", STR_UNDEFINED },
-	{ JSMN_OBJECT,    2, NULL,                      STR_UNDEFINED },
-	{ JSMN_STRING,    1, "bl_size",                 STR_UNDEFINED },
-	{ JSMN_PRIMITIVE, 0, NULL,                      STR_UNDEFINED },
-	{ JSMN_STRING,    1, "sd_size",                 STR_UNDEFINED },
-	{ JSMN_PRIMITIVE, 0, NULL,                      STR_UNDEFINED },
-	{ JSMN_UNDEFINED, 0, NULL,                      STR_UNDEFINED }
-};
+	return err_code;
+}
 
-// JSMN token pattern table
-static const dfu_image_jsmn_pattern dfu_pattern_tbl[] =
+static int dfu_send_image(dfu_img_param_t *p_dfu_img)
 {
-	{ DFU_IMG_APP,   dfu_app_pattern   },
-	{ DFU_IMG_BL,    dfu_bl_pattern    },
-	{ DFU_IMG_SD,    dfu_sd_pattern    },
-	{ DFU_IMG_SD_BL, dfu_sd_bl_pattern },
-	{ DFU_IMG_NIL,   NULL              }
-};
-
-static void free_dfu_json_obj(dfu_json_object_t *p_dfu_obj);
+	int err_code;
 
-// allocate memory to store a JSON string
-static char *put_json_to_string(const uint8_t *p_data, int len)
-{
-	char *p_str;
+	err_code = dfu_serial_open(p_dfu_img->p_uart);
 
-	if (len >= 0)
-		p_str = (char *)malloc(len + 1);
-	else
-		p_str = NULL;
+	if (!err_code)
+	{
+		err_code = dfu_send_image_data(p_dfu_img);
+	}
 
-	if (p_str != NULL)
+	// after an error, the objects are selected again and the transfer resumes from the target's offset and CRC
+	while (err_code && !dfu_serial_resync(p_dfu_img->p_uart))
 	{
-		memcpy(p_str, p_data, len);
-		*(p_str + len) = '\0';
+		err_code = dfu_send_image_data(p_dfu_img);
 	}
 
-	return p_str;
+	if (err_code && p_dfu_img->p_uart->p_cancel != NULL && *p_dfu_img->p_uart->p_cancel)
+		dfu_serial_abort(p_dfu_img->p_uart);
+
+	dfu_serial_close(p_dfu_img->p_uart);
+
+	return err_code;
 }
 
-// map a JSMN token to a DFU JSON pattern
-static int map_jsmn_token_to_pattern(dfu_json_object_t *p_dfu_obj, const jsmn_entity_t *p_pattern, const jsmntok_t *p_tokens, int num_tokens, const uint8_t *p_data)
+static int dfu_load_object(dfu_image_t *p_img, struct zip_t *p_zip_pkg)
 {
-	int i, j = 0;
-	jsmntype_t jsmn_type;
+	int err_code = 0;
+	const manifest_image_t *p_dfu_obj = p_img->p_obj;
+
+	// DEFLATED entries are checked while decompressing, STORED entries
+	// against the running CRC of the transfer, the entry CRC-32 is the
+	// expected CRC of the whole image
+	if (zip_entry_open(p_zip_pkg, p_dfu_obj->p_dat_file))
+	{
+		logger_error("Cannot open package DAT file!");
 
-	// compare the JSMN tokens one by one
-	for (i = 0; (jsmn_type = (p_pattern + i)->type) != JSMN_UNDEFINED; i++)
+		err_code = 1;
+	}
+	else
 	{
-		if (i >= num_tokens || 
-			jsmn_type != (p_tokens + i)->type || 
-			(p_pattern + i)->size != (p_tokens + i)->size)
+		p_img->dat_crc = zip_entry_crc32(p_zip_pkg);
+
+		if (zip_entry_read_unchecked(p_zip_pkg, (void **)&p_img->p_img_dat, &p_img->n_dat_size))
 		{
-			// type or size mismatch...
-			j = -1;
-			break;
+			logger_error("Cannot read package DAT file!");
+
+			err_code = 1;
 		}
 
-		if (jsmn_type == JSMN_STRING)
+		zip_entry_close(p_zip_pkg);
+	}
+
+	if (!err_code)
+	{
+		if (zip_entry_open(p_zip_pkg, p_dfu_obj->p_bin_file))
 		{
-			int len = (p_tokens + i)->end - (p_tokens + i)->start;
-			char *p_str = put_json_to_string(p_data + (p_tokens + i)->start, len);
+			logger_error("Cannot open package BIN file!");
 
-			if (p_str == NULL)
-			{
-				// cannot allocate memory...
-				j = -1;
-				break;
-			}
+			err_code = 1;
+		}
+		else
+		{
+			p_img->bin_crc = zip_entry_crc32(p_zip_pkg);
 
-			// check the pattern string
-			if ((p_pattern + i)->str != NULL && strcmp(p_str, (p_pattern + i)->str))
+			if (zip_entry_read_unchecked(p_zip_pkg, (void **)&p_img->p_img_bin, &p_img->n_bin_size))
 			{
-				free(p_str);
+				logger_error("Cannot read package BIN file!");
 
-				// mismatch...
-				j = -1;
-				break;
+				err_code = 1;
 			}
 
-			// store string target, if any
-			switch ((p_pattern + i)->str_type)
-			{
-			case STR_FILE_DAT:
-				if (p_dfu_obj != NULL)
-					p_dfu_obj->file_dat = p_str;
-				break;
-			case STR_FILE_BIN:
-				if (p_dfu_obj != NULL)
-					p_dfu_obj->file_bin = p_str;
-				break;
-			default:
-				free(p_str);
-				break;
-			}
+			zip_entry_close(p_zip_pkg);
 		}
 	}
 
-	if (j < 0)
+	return err_code;
+}
+
+static void dfu_free_image(dfu_image_t *p_img)
+{
+	if (p_img->p_img_dat != NULL)
 	{
-		i = j;
+		free(p_img->p_img_dat);
+		p_img->p_img_dat = NULL;
+	}
 
-		if (p_dfu_obj != NULL)
-			free_dfu_json_obj(p_dfu_obj);
+	if (p_img->p_img_bin != NULL)
+	{
+		free(p_img->p_img_bin);
+		p_img->p_img_bin = NULL;
 	}
+}
+
+static int dfu_send_object(uart_drv_t *p_uart, dfu_image_t *p_img, dfu_plan_t *p_plan)
+{
+	int err_code = 0;
+	dfu_img_param_t dfu_img;
 
-	return i;
+	dfu_img.p_uart = p_uart;
+	dfu_img.p_img_dat = p_img->p_img_dat;
+	dfu_img.n_dat_size = p_img->n_dat_size;
+	dfu_img.p_img_bin = p_img->p_img_bin;
+	dfu_img.n_bin_size = p_img->n_bin_size;
+	dfu_img.dat_crc = p_img->dat_crc;
+	dfu_img.bin_crc = p_img->bin_crc;
+	dfu_img.p_plan = p_plan;
+	err_code = dfu_send_image(&dfu_img);
+
+	return err_code;
 }
 
-// free allocated strings
-static void free_dfu_json_obj(dfu_json_object_t *p_dfu_obj)
+// load the images one after another, ahead of sending them
+static void *dfu_prefetch_thread(void *p_context)
 {
-	if (p_dfu_obj->file_dat != NULL)
+	dfu_prefetch_t *p_pf = (dfu_prefetch_t *)p_context;
+	int i, err_code;
+
+	for (i = 0; i < p_pf->num_images; i++)
 	{
-		free(p_dfu_obj->file_dat);
-		p_dfu_obj->file_dat = NULL;
+#ifndef WIN32
+		pthread_mutex_lock(&p_pf->lock);
+#endif
+		if (p_pf->stop)
+			i = p_pf->num_images;
+#ifndef WIN32
+		pthread_mutex_unlock(&p_pf->lock);
+#endif
+		if (i >= p_pf->num_images)
+			break;
+
+		err_code = dfu_load_object(p_pf->images + i, p_pf->p_zip);
+
+#ifndef WIN32
+		pthread_mutex_lock(&p_pf->lock);
+#endif
+		p_pf->images[i].err_code = err_code;
+		p_pf->images[i].ready = 1;
+#ifndef WIN32
+		pthread_cond_broadcast(&p_pf->cond);
+		pthread_mutex_unlock(&p_pf->lock);
+#endif
+		// later images are not needed after a failure
+		if (err_code)
+			break;
 	}
-	if (p_dfu_obj->file_bin != NULL)
+
+#ifndef WIN32
+	pthread_mutex_lock(&p_pf->lock);
+#endif
+	// release any waiter for the images not loaded
+	for (; i < p_pf->num_images; i++)
 	{
-		free(p_dfu_obj->file_bin);
-		p_dfu_obj->file_bin = NULL;
+		if (!p_pf->images[i].ready)
+		{
+			p_pf->images[i].err_code = 1;
+			p_pf->images[i].ready = 1;
+		}
 	}
+#ifndef WIN32
+	pthread_cond_broadcast(&p_pf->cond);
+	pthread_mutex_unlock(&p_pf->lock);
+#endif
+
+	return NULL;
 }
 
-static int dfu_send_image(dfu_img_param_t *p_dfu_img)
+static void dfu_prefetch_start(dfu_prefetch_t *p_pf)
 {
-	int err_code;
+#ifndef WIN32
+	pthread_condattr_t attr;
 
-	err_code = dfu_serial_open(p_dfu_img->p_uart);
+	pthread_mutex_init(&p_pf->lock, NULL);
 
-	if (!err_code)
-	{
-		err_code = dfu_serial_send_init_packet(p_dfu_img->p_uart, p_dfu_img->p_img_dat, p_dfu_img->n_dat_size);
-	}
+	// the waits for an image are timed on the clock of the keepalive
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&p_pf->cond, &attr);
+	pthread_condattr_destroy(&attr);
 
-	if (!err_code)
+	p_pf->started = !pthread_create(&p_pf->thread, NULL, dfu_prefetch_thread, p_pf);
+
+	if (!p_pf->started)
+#endif
 	{
-		err_code = dfu_serial_send_firmware(p_dfu_img->p_uart, p_dfu_img->p_img_bin, p_dfu_img->n_bin_size);
+		// no loader thread, load the images up front
+		dfu_prefetch_thread(p_pf);
 	}
+}
 
-	if (!err_code)
+// wait for an image, returns the image load result; the target on p_uart, if any,
+// is pinged meanwhile so that it does not time out
+static int dfu_prefetch_wait(uart_drv_t *p_uart, dfu_prefetch_t *p_pf, int img_n)
+{
+	int err_code;
+#ifndef WIN32
+	uint64_t wait_us, time_us;
+	struct timespec ts;
+
+	pthread_mutex_lock(&p_pf->lock);
+
+	while (!p_pf->images[img_n].ready)
 	{
-		err_code = dfu_serial_close(p_dfu_img->p_uart);
+		wait_us = 0;
+
+		if (p_uart != NULL)
+		{
+			pthread_mutex_unlock(&p_pf->lock);
+			wait_us = dfu_serial_keepalive(p_uart);
+			pthread_mutex_lock(&p_pf->lock);
+
+			if (p_pf->images[img_n].ready)
+				break;
+		}
+
+		if (wait_us)
+		{
+			time_us = sys_time_us() + wait_us;
+			ts.tv_sec = time_us / 1000000;
+			ts.tv_nsec = (time_us % 1000000) * 1000;
+
+			pthread_cond_timedwait(&p_pf->cond, &p_pf->lock, &ts);
+		}
+		else
+		{
+			pthread_cond_wait(&p_pf->cond, &p_pf->lock);
+		}
 	}
+#endif
+
+	err_code = p_pf->images[img_n].err_code;
+
+#ifndef WIN32
+	pthread_mutex_unlock(&p_pf->lock);
+#endif
 
 	return err_code;
 }
 
-static int dfu_send_object(uart_drv_t *p_uart, dfu_json_object_t *p_dfu_obj, struct zip_t *p_zip_pkg)
+// free an image sent, one the loader may still be writing into is freed once it stops
+static void dfu_prefetch_free(dfu_prefetch_t *p_pf, int img_n)
 {
-	int err_code = 0;
-	uint8_t *buf_dat = NULL;
-	size_t buf_dat_size;
-	uint8_t *buf_bin = NULL;
-	size_t buf_bin_size;
-	dfu_img_param_t dfu_img;
+#ifndef WIN32
+	pthread_mutex_lock(&p_pf->lock);
+#endif
 
-	if (zip_entry_open(p_zip_pkg, p_dfu_obj->file_dat))
+	if (p_pf->images[img_n].ready)
+		dfu_free_image(p_pf->images + img_n);
+
+#ifndef WIN32
+	pthread_mutex_unlock(&p_pf->lock);
+#endif
+}
+
+static void dfu_prefetch_stop(dfu_prefetch_t *p_pf)
+{
+	int i;
+
+#ifndef WIN32
+	pthread_mutex_lock(&p_pf->lock);
+	p_pf->stop = 1;
+	pthread_mutex_unlock(&p_pf->lock);
+
+	if (p_pf->started)
+		pthread_join(p_pf->thread, NULL);
+
+	pthread_cond_destroy(&p_pf->cond);
+	pthread_mutex_destroy(&p_pf->lock);
+#endif
+
+	for (i = 0; i < p_pf->num_images; i++)
+		dfu_free_image(p_pf->images + i);
+}
+
+// query the images installed on the target, the DFU session is open
+static void dfu_get_installed(uart_drv_t *p_uart, dfu_fw_version_t *p_fw, int *p_num)
+{
+	dfu_hw_version_t hw;
+	int n;
+
+	// informative only
+	dfu_serial_get_hw_version(p_uart, &hw);
+
+	for (n = 0; n < DFU_INSTALLED_NUM_MAX; n++)
 	{
-		logger_error("Cannot open package DAT file!");
+		if (dfu_serial_get_fw_version(p_uart, (uint8_t)n, p_fw + n) ||
+			(p_fw + n)->type == DFU_FW_TYPE_UNKNOWN)
+			break;
+	}
 
-		err_code = 1;
+	*p_num = n;
+}
+
+static const dfu_fw_version_t *find_installed(const dfu_fw_version_t *p_fw, int num_fw, uint8_t type)
+{
+	int n;
+
+	for (n = 0; n < num_fw; n++)
+	{
+		if ((p_fw + n)->type == type)
+			return p_fw + n;
 	}
-	else
+
+	return NULL;
+}
+
+static uint32_t get_bin_uint32_le(const dfu_image_t *p_img, size_t offset)
+{
+	const uint8_t *p_data = p_img->p_img_bin + offset;
+
+	return (uint32_t)p_data[0] | ((uint32_t)p_data[1] << 8) |
+		((uint32_t)p_data[2] << 16) | ((uint32_t)p_data[3] << 24);
+}
+
+// check whether the SoftDevice in the image is the one installed
+static int is_sd_installed(const dfu_image_t *p_img, const dfu_fw_version_t *p_fw, int num_fw)
+{
+	const dfu_fw_version_t *p_sd = find_installed(p_fw, num_fw, DFU_FW_TYPE_SOFTDEVICE);
+
+	if (p_sd == NULL || p_img->n_bin_size < SD_INFO_VERSION_OFFSET + 4 ||
+		get_bin_uint32_le(p_img, SD_INFO_MAGIC_OFFSET) != SD_INFO_MAGIC)
+		return 0;
+
+	return get_bin_uint32_le(p_img, SD_INFO_VERSION_OFFSET) == p_sd->version;
+}
+
+// check whether the image is already installed on the target
+static int is_image_installed(const dfu_image_t *p_img, const dfu_fw_version_t *p_fw, int num_fw)
+{
+	init_packet_t init;
+	const dfu_fw_version_t *p_inst;
+
+	if (init_packet_parse(p_img->p_img_dat, (uint32_t)p_img->n_dat_size, &init))
+		return 0;
+
+	switch (p_img->img_type)
 	{
-		if (zip_entry_read(p_zip_pkg, (void **)&buf_dat, &buf_dat_size))
-		{
-			logger_error("Cannot read package DAT file!");
+	case DFU_IMG_APP:
+		p_inst = find_installed(p_fw, num_fw, DFU_FW_TYPE_APPLICATION);
 
-			err_code = 1;
-		}
+		return p_inst != NULL && p_inst->version == init.fw_version &&
+			p_inst->len == init.app_size;
 
-		zip_entry_close(p_zip_pkg);
+	case DFU_IMG_BL:
+		p_inst = find_installed(p_fw, num_fw, DFU_FW_TYPE_BOOTLOADER);
+
+		return p_inst != NULL && p_inst->version == init.fw_version;
+
+	case DFU_IMG_SD:
+		return is_sd_installed(p_img, p_fw, num_fw);
+
+	case DFU_IMG_SD_BL:
+		p_inst = find_installed(p_fw, num_fw, DFU_FW_TYPE_BOOTLOADER);
+
+		return p_inst != NULL && p_inst->version == init.fw_version &&
+			is_sd_installed(p_img, p_fw, num_fw);
+
+	default:
+		return 0;
 	}
+}
 
-	if (!err_code)
+// the DFU image type of a manifest key
+static dfu_image_type_t find_image_type(const char *p_key)
+{
+	int t;
+
+	for (t = 0; dfu_image_keys[t].img_type != DFU_IMG_NIL; t++)
 	{
-		if (zip_entry_open(p_zip_pkg, p_dfu_obj->file_bin))
-		{
-			logger_error("Cannot open package BIN file!");
+		if (!strcmp(dfu_image_keys[t].p_key, p_key))
+			break;
+	}
 
-			err_code = 1;
-		}
-		else
-		{
-			if (zip_entry_read(p_zip_pkg, (void **)&buf_bin, &buf_bin_size))
-			{
-				logger_error("Cannot read package BIN file!");
+	return dfu_image_keys[t].img_type;
+}
 
-				err_code = 1;
-			}
+static const manifest_image_t *find_manifest_image(const manifest_t *p_mft, dfu_image_type_t img_type)
+{
+	const manifest_image_t *p_img = NULL;
+	int i;
 
-			zip_entry_close(p_zip_pkg);
+	for (i = 0; i < p_mft->num_images; i++)
+	{
+		if (find_image_type(p_mft->p_images[i].p_name) == img_type)
+		{
+			p_img = p_mft->p_images + i;
+			break;
 		}
 	}
 
-	if (!err_code)
+	return p_img;
+}
+
+// identify the package content by the names, sizes and CRCs of its entries
+static uint32_t dfu_package_hash(struct zip_t *p_zip)
+{
+	uint32_t hash = 0;
+	uint32_t entry[3];
+	const char *p_name;
+	int num_entries;
+	int i;
+
+	num_entries = zip_total_entries(p_zip);
+
+	for (i = 0; i < num_entries; i++)
 	{
-		dfu_img.p_uart = p_uart;
-		dfu_img.p_img_dat = buf_dat;
-		dfu_img.n_dat_size = buf_dat_size;
-		dfu_img.p_img_bin = buf_bin;
-		dfu_img.n_bin_size = buf_bin_size;
-		err_code = dfu_send_image(&dfu_img);
-	}
+		if (zip_entry_openbyindex(p_zip, i))
+			continue;
 
-	if (buf_dat != NULL)
-		free(buf_dat);
+		p_name = zip_entry_name(p_zip);
+		if (p_name != NULL)
+			hash = crc32_compute((const uint8_t *)p_name, (uint32_t)strlen(p_name), &hash);
 
-	if (buf_bin != NULL)
-		free(buf_bin);
+		entry[0] = (uint32_t)i;
+		entry[1] = (uint32_t)zip_entry_size(p_zip);
+		entry[2] = zip_entry_crc32(p_zip);
+		hash = crc32_compute((const uint8_t *)entry, sizeof(entry), &hash);
 
-	return err_code;
+		zip_entry_close(p_zip);
+	}
+
+	return hash;
 }
 
-static dfu_json_object_t *find_dfu_object(dfu_json_object_t *p_dfu_obj, int num_obj, dfu_image_type_t img_type)
+// read a file descriptor to its end, the ZIP reader needs to seek and a pipe cannot
+static int dfu_read_fd(int fd, uint8_t **pp_buf, size_t *p_size)
 {
-	dfu_json_object_t *p_obj = NULL;
-	int i;
+	size_t size = 0, buf_size = DFU_PKG_READ_SIZE;
+	uint8_t *p_buf = (uint8_t *)malloc(buf_size);
+	uint8_t *p_new;
+	int length = 0;
+
+#ifdef WIN32
+	_setmode(fd, _O_BINARY);
+#endif
 
-	for (i = 0; i < num_obj; i++)
+	while (p_buf != NULL)
 	{
-		if ((p_dfu_obj + i)->img_type == img_type)
+		if (size == buf_size)
 		{
-			p_obj = p_dfu_obj + i;
-			break;
+			buf_size *= 2;
+			p_new = (uint8_t *)realloc(p_buf, buf_size);
+
+			if (p_new == NULL)
+			{
+				free(p_buf);
+				p_buf = NULL;
+				break;
+			}
+
+			p_buf = p_new;
 		}
+
+#ifdef WIN32
+		length = _read(fd, p_buf + size, (unsigned)(buf_size - size));
+#else
+		length = (int)read(fd, p_buf + size, buf_size - size);
+#endif
+		if (length <= 0)
+			break;
+
+		size += length;
 	}
 
-	return p_obj;
+	if (p_buf == NULL || length < 0 || !size)
+	{
+		logger_error("Cannot read package from file descriptor %d!", fd);
+
+		free(p_buf);
+
+		return 1;
+	}
+
+	*pp_buf = p_buf;
+	*p_size = size;
+
+	return 0;
 }
 
-int dfu_send_package(dfu_param_t *p_dfu)
+// open a package and list its images in send order
+static int dfu_package_open(const dfu_pkg_source_t *p_src, dfu_package_t *p_pkg)
 {
 	int err_code = 0;
-	struct zip_t *zip_pkg;
-	uint8_t *buf_json = NULL;
 	size_t bufsize;
-	jsmn_parser parser;
-	int num_tokens;
-	int num_images, img_n = 0;
-	dfu_json_object_t *p_dfu_object;
-	int i, n;
+	const manifest_image_t *p_mft_img;
+	int i, t;
+
+	memset(p_pkg, 0, sizeof(*p_pkg));
 
-	zip_pkg = zip_open(p_dfu->p_pkg_file, 0, 'r');
-	if (zip_pkg == NULL)
+	if (p_src->p_file != NULL && strcmp(p_src->p_file, DFU_PKG_STDIN))
+	{
+		p_pkg->p_zip = zip_open(p_src->p_file, 0, 'r');
+	}
+	else if (p_src->p_file == NULL && p_src->p_data != NULL)
+	{
+		p_pkg->p_zip = zip_stream_open((const char *)p_src->p_data, p_src->size, 0, 'r');
+	}
+	else
+	{
+		int fd = p_src->p_file != NULL ? fileno(stdin) : p_src->fd;
+		size_t size;
+
+		if (!dfu_read_fd(fd, &p_pkg->p_zip_buf, &size))
+			p_pkg->p_zip = zip_stream_open((const char *)p_pkg->p_zip_buf, size, 0, 'r');
+	}
+
+	if (p_pkg->p_zip == NULL)
 	{
 		logger_error("Cannot open ZIP package file!");
 
@@ -424,7 +709,7 @@ int dfu_send_package(dfu_param_t *p_dfu)
 	}
 	else
 	{
-		if (zip_entry_open(zip_pkg, "manifest.json"))
+		if (zip_entry_open(p_pkg->p_zip, "manifest.json"))
 		{
 			logger_error("Cannot open package manifest file!");
 
@@ -432,7 +717,7 @@ int dfu_send_package(dfu_param_t *p_dfu)
 		}
 		else
 		{
-			if (zip_entry_read(zip_pkg, (void **)&buf_json, &bufsize))
+			if (zip_entry_read(p_pkg->p_zip, (void **)&p_pkg->buf_json, &bufsize))
 			{
 				logger_error("Cannot read package manifest file!");
 
@@ -440,181 +725,423 @@ int dfu_send_package(dfu_param_t *p_dfu)
 			}
 			else
 			{
-				zip_entry_close(zip_pkg);
+				zip_entry_close(p_pkg->p_zip);
 			}
 		}
 	}
 
 	if (!err_code)
 	{
-		jsmn_init(&parser);
+		err_code = manifest_parse(&p_pkg->manifest, (char *)p_pkg->buf_json, bufsize);
+	}
 
-		num_tokens = jsmn_parse(&parser, (char *)buf_json, bufsize, json_tokens, JSON_TOKEN_NUM_MAX);
+	// each image must be of a known type, one image per type
+	for (i = 0; !err_code && i < p_pkg->manifest.num_images; i++)
+	{
+		p_mft_img = p_pkg->manifest.p_images + i;
+		t = find_image_type(p_mft_img->p_name);
 
-		if (num_tokens < 0)
+		if (t == DFU_IMG_NIL)
 		{
-			logger_error("Cannot parse package manifest json (%d)!", num_tokens);
+			logger_error("Unknown DFU image type %s in json manifest!", p_mft_img->p_name);
 
 			err_code = 1;
 		}
-	}
+		else if (find_manifest_image(&p_pkg->manifest, (dfu_image_type_t)t) != p_mft_img)
+		{
+			logger_error("Several %s images in json manifest!", p_mft_img->p_name);
 
-	for (i = 0; i < DFU_OBJECT_NUM_MAX; i++)
-	{
-		dfu_objects[i].file_bin = NULL;
-		dfu_objects[i].file_dat = NULL;
+			err_code = 1;
+		}
 	}
 
 	if (!err_code)
 	{
-		// check that JSON starts with a manifest object
-		i = map_jsmn_token_to_pattern(NULL, dfu_mft_pattern, json_tokens, num_tokens, buf_json);
-		if (i < 0)
-		{
-			logger_error("Cannot get json manifest object!");
+		// list the images in send order: SoftDevice & bootloader, SoftDevice, bootloader, application
+		p_pkg->prefetch.p_zip = p_pkg->p_zip;
+		p_pkg->prefetch.pkg_hash = dfu_package_hash(p_pkg->p_zip);
 
-			err_code = 1;
+		for (t = 0; dfu_send_order[t] != DFU_IMG_NIL; t++)
+		{
+			p_mft_img = find_manifest_image(&p_pkg->manifest, dfu_send_order[t]);
+			if (p_mft_img != NULL)
+			{
+				p_pkg->prefetch.images[p_pkg->prefetch.num_images].p_obj = p_mft_img;
+				p_pkg->prefetch.images[p_pkg->prefetch.num_images].img_type = dfu_send_order[t];
+				p_pkg->prefetch.num_images++;
+			}
 		}
-		n = i;
+	}
 
-		if (!err_code)
+	return err_code;
+}
+
+static void dfu_package_close(dfu_package_t *p_pkg)
+{
+	manifest_free(&p_pkg->manifest);
+
+	if (p_pkg->buf_json != NULL)
+		free(p_pkg->buf_json);
+
+	if (p_pkg->p_zip != NULL)
+		zip_close(p_pkg->p_zip);
+
+	free(p_pkg->p_zip_buf);
+}
+
+// send the images of an open package, the images sent are freed if free_sent is set
+static int dfu_send_images(uart_drv_t *p_uart, dfu_prefetch_t *p_pf, int skip_installed, int free_sent, dfu_result_t *p_result)
+{
+	int err_code = 0;
+	dfu_fw_version_t installed[DFU_INSTALLED_NUM_MAX];
+	int num_installed = 0;
+	int skipping = skip_installed;
+	int num_sent = 0;
+	dfu_result_t result;
+	dfu_image_result_t *p_img_result;
+	journal_t journal;
+	int num_journaled = 0;
+	uint64_t time_us;
+	int i;
+
+	if (p_result == NULL)
+		p_result = &result;
+
+	memset(p_result, 0, sizeof(*p_result));
+	p_result->num_images = p_pf->num_images;
+
+	for (i = 0; i < p_pf->num_images; i++)
+		p_result->images[i].p_name = dfu_img_name(p_pf->images[i].img_type);
+
+	if (p_uart->p_JournalName != NULL)
+	{
+		char key[JOURNAL_KEY_MAX];
+
+		// a port name may lead to another device by the next run, only a serial number identifies the target
+		if (uart_drv_get_key(p_uart, key, sizeof(key)))
 		{
-			// check whether there are 1 or 2 DFU images
-			i = map_jsmn_token_to_pattern(NULL, dfu_img_1_pattern, json_tokens + n, num_tokens - n, buf_json);
-			if (i > 0)
+			logger_info_1("No serial number for %s, the transfer is not journaled.", key);
+		}
+		// the transfer goes on without a journal it cannot open, the later journal calls are skipped
+		else if (!journal_open(&journal, p_uart->p_JournalName, key, p_pf->pkg_hash))
+		{
+			p_uart->p_journal = &journal;
+
+			// a transfer interrupted goes on from the first image not complete, once the target confirms the images journaled
+			if (journal.resuming)
 			{
-				num_images = 1;
+				num_journaled = journal.resume_image;
+
+				logger_info_1("Resuming the transfer at image %d, firmware offset %u.", num_journaled, journal.resume_offset);
 			}
 			else
 			{
-				i = map_jsmn_token_to_pattern(NULL, dfu_img_2_pattern, json_tokens + n, num_tokens - n, buf_json);
-				if (i > 0)
-				{
-					num_images = 2;
-				}
+				journal_begin(&journal);
 			}
+		}
+	}
 
-			if (i <= 0)
-			{
-				logger_error("Cannot get json number of DFU images!");
+	if (!err_code && (skipping || num_journaled > 0))
+	{
+		err_code = dfu_serial_open(p_uart);
 
-				err_code = 1;
-			}
-		}
-		n += i;
+		if (!err_code)
+			dfu_get_installed(p_uart, installed, &num_installed);
+
+		dfu_serial_close(p_uart);
+	}
+
+	for (i = 0; !err_code && i < p_pf->num_images; i++)
+	{
+		dfu_image_t *p_img = p_pf->images + i;
 
-		while (!err_code && n < num_tokens)
+		p_img_result = p_result->images + i;
+		p_result->current = i;
+
+		if (num_sent > 0)
+			err_code = delay_connect();
+
+		if (!err_code && p_uart->p_cancel != NULL && *p_uart->p_cancel)
 		{
-			int t;
+			logger_error("DFU cancelled!");
 
-			if (img_n >= DFU_OBJECT_NUM_MAX)
-			{
-				logger_error("No data storage for json DFU image object!");
+			err_code = 1;
+		}
 
-				err_code = 1;
-				break;
-			}
+		if (!err_code)
+			err_code = dfu_prefetch_wait(p_uart, p_pf, i);
 
-			// determine the DFU image type
-			for (t = 0; dfu_pattern_tbl[t].img_type != DFU_IMG_NIL; t++)
-			{
-				i = map_jsmn_token_to_pattern(dfu_objects + img_n, dfu_pattern_tbl[t].p_pattern, json_tokens + n, num_tokens - n, buf_json);
+		if (!err_code)
+			p_img_result->size = (uint32_t)p_img->n_bin_size;
 
-				if (i > 0)
-				{
-					dfu_objects[img_n].img_type = dfu_pattern_tbl[t].img_type;
-					break;
-				}
-			}
+		if (!err_code && i < num_journaled && !is_image_installed(p_img, installed, num_installed))
+		{
+			logger_info_1("Journal does not match the %s image on the target, starting over.", p_img_result->p_name);
 
-			if (i <= 0)
-			{
-				logger_error("Cannot find json DFU image object!");
+			num_journaled = 0;
+			journal_begin(&journal);
+		}
 
-				err_code = 1;
-				break;
-			}
-			else
-			{
-				n += i;
+		if (!err_code && i < num_journaled)
+		{
+			logger_info_1("%s image already sent, skipped.", p_img_result->p_name);
 
-				img_n++;
-			}
+			p_img_result->skipped = 1;
 		}
+		// once an image is sent, the images after it depend on it
+		else if (!err_code && skipping && is_image_installed(p_img, installed, num_installed))
+		{
+			logger_info_1("%s image already installed, skipped.", p_img_result->p_name);
 
-		if (!err_code && (n != num_tokens || img_n != num_images))
+			p_img_result->skipped = 1;
+		}
+		else if (!err_code)
 		{
-			logger_error("Incoherent json object structure detected!");
+			logger_info_1("Sending %s image.", p_img_result->p_name);
 
-			err_code = 1;
+			skipping = 0;
+			num_sent++;
+
+			if (p_uart->p_journal != NULL)
+				journal.image = i;
+
+			time_us = sys_time_us();
+			err_code = dfu_send_object(p_uart, p_img, &p_img_result->plan);
+			p_img_result->time_us = sys_time_us() - time_us;
+
+			// the transfer goes on if the journal cannot be written, it is only resumed from an earlier point
+			if (!err_code && p_uart->p_journal != NULL)
+				journal_image(&journal);
 		}
+
+		p_img_result->err_code = err_code;
+
+		if (free_sent)
+			dfu_prefetch_free(p_pf, i);
+	}
+
+	if (p_uart->p_journal != NULL)
+	{
+		if (!err_code)
+			journal_done(&journal);
+
+		journal_close(&journal);
+		p_uart->p_journal = NULL;
 	}
 
+	return err_code;
+}
+
+int dfu_send_package(dfu_param_t *p_dfu)
+{
+	int err_code;
+	dfu_package_t pkg;
+	dfu_pkg_source_t src;
+
+	memset(&src, 0, sizeof(src));
+	src.p_file = p_dfu->p_pkg_file;
+
+	err_code = dfu_package_open(p_dfu->p_pkg_src != NULL ? p_dfu->p_pkg_src : &src, &pkg);
+
 	if (!err_code)
 	{
-		// send SoftDevice & bootloader image, if any
-		p_dfu_object = find_dfu_object(dfu_objects, num_images, DFU_IMG_SD_BL);
-		if (p_dfu_object != NULL)
-		{
-			logger_info_1("Sending SoftDevice+Bootloader image.");
+		// the next images are decompressed while the current one is sent
+		dfu_prefetch_start(&pkg.prefetch);
 
-			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, zip_pkg);
+		err_code = dfu_send_images(p_dfu->p_uart, &pkg.prefetch, p_dfu->skip_installed, 1, NULL);
 
-			if (!err_code && num_images > 1)
-				err_code = delay_connect();
-		}
+		dfu_prefetch_stop(&pkg.prefetch);
 	}
 
+	dfu_package_close(&pkg);
+
+	return err_code;
+}
+
+int dfu_package_load(const char *p_pkg_file, dfu_package_t **pp_pkg)
+{
+	dfu_pkg_source_t src;
+
+	memset(&src, 0, sizeof(src));
+	src.p_file = p_pkg_file;
+
+	return dfu_package_load_source(&src, pp_pkg);
+}
+
+int dfu_package_load_source(const dfu_pkg_source_t *p_src, dfu_package_t **pp_pkg)
+{
+	int err_code;
+	dfu_package_t *p_pkg;
+	int i;
+
+	p_pkg = (dfu_package_t *)malloc(sizeof(dfu_package_t));
+
+	if (p_pkg == NULL)
+	{
+		logger_error("Cannot allocate memory!");
+
+		return 1;
+	}
+
+	err_code = dfu_package_open(p_src, p_pkg);
+
 	if (!err_code)
 	{
-		// send SoftDevice image, if any
-		p_dfu_object = find_dfu_object(dfu_objects, num_images, DFU_IMG_SD);
-		if (p_dfu_object != NULL)
-		{
-			logger_info_1("Sending SoftDevice image.");
+		dfu_prefetch_start(&p_pkg->prefetch);
 
-			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, zip_pkg);
+		for (i = 0; !err_code && i < p_pkg->prefetch.num_images; i++)
+			err_code = dfu_prefetch_wait(NULL, &p_pkg->prefetch, i);
+	}
 
-			if (!err_code && num_images > 1)
-				err_code = delay_connect();
-		}
+	if (err_code)
+	{
+		dfu_package_free(p_pkg);
+		p_pkg = NULL;
 	}
 
+	*pp_pkg = p_pkg;
+
+	return err_code;
+}
+
+void dfu_package_free(dfu_package_t *p_pkg)
+{
+	if (p_pkg == NULL)
+		return;
+
+	if (p_pkg->prefetch.num_images > 0)
+		dfu_prefetch_stop(&p_pkg->prefetch);
+
+	dfu_package_close(p_pkg);
+
+	free(p_pkg);
+}
+
+int dfu_send_loaded_package(uart_drv_t *p_uart, dfu_package_t *p_pkg, int skip_installed, dfu_result_t *p_result)
+{
+	return dfu_send_images(p_uart, &p_pkg->prefetch, skip_installed, 0, p_result);
+}
+
+// compare the state of one target with the package
+static int dfu_verify_target(uart_drv_t *p_uart, const dfu_package_t *p_pkg)
+{
+	int err_code;
+	dfu_fw_version_t installed[DFU_INSTALLED_NUM_MAX];
+	int num_installed = 0;
+	uint32_t cmd_offset = 0, cmd_crc = 0;
+	int i, staged = 0;
+
+	err_code = dfu_serial_open(p_uart);
+
 	if (!err_code)
 	{
-		// send bootloader image, if any
-		p_dfu_object = find_dfu_object(dfu_objects, num_images, DFU_IMG_BL);
-		if (p_dfu_object != NULL)
-		{
-			logger_info_1("Sending Bootloader image.");
+		dfu_get_installed(p_uart, installed, &num_installed);
+
+		err_code = dfu_serial_get_init_packet(p_uart, &cmd_offset, &cmd_crc);
+	}
+
+	dfu_serial_close(p_uart);
 
-			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, zip_pkg);
+	for (i = 0; !err_code && i < p_pkg->prefetch.num_images; i++)
+	{
+		const dfu_image_t *p_img = p_pkg->prefetch.images + i;
+
+		if (!is_image_installed(p_img, installed, num_installed))
+		{
+			logger_error("%s: %s image is not installed!", p_uart->p_PortName, dfu_img_name(p_img->img_type));
 
-			if (!err_code && num_images > 1)
-				err_code = delay_connect();
+			err_code = 1;
 		}
+
+		if (cmd_offset == p_img->n_dat_size && cmd_crc == p_img->dat_crc)
+			staged = 1;
+	}
+
+	// an init packet from another package means an update has been started
+	if (!err_code && cmd_offset && !staged)
+	{
+		logger_error("%s: Another update is in progress!", p_uart->p_PortName);
+
+		err_code = 1;
 	}
 
+	return err_code;
+}
+
+int dfu_verify_loaded_package(uart_drv_t *p_uart, dfu_package_t *p_pkg)
+{
+	return dfu_verify_target(p_uart, p_pkg);
+}
+
+static void *dfu_verify_thread(void *p_context)
+{
+	dfu_verify_ctx_t *p_ctx = (dfu_verify_ctx_t *)p_context;
+	dfu_verify_t *p_verify = p_ctx->p_verify;
+	uint64_t time_us = sys_time_us();
+
+	p_verify->err_code = dfu_verify_target(p_verify->p_uart, p_ctx->p_pkg);
+	p_verify->time_us = sys_time_us() - time_us;
+
+	return NULL;
+}
+
+int dfu_verify_package(const char *p_pkg_file, dfu_verify_t *p_verify, int num_ports)
+{
+	int err_code;
+	dfu_package_t *p_pkg = NULL;
+	dfu_verify_ctx_t *p_ctx = NULL;
+	int i;
+
+	// all the images are needed by every check
+	err_code = dfu_package_load(p_pkg_file, &p_pkg);
+
 	if (!err_code)
 	{
-		// send application image, if any
-		p_dfu_object = find_dfu_object(dfu_objects, num_images, DFU_IMG_APP);
-		if (p_dfu_object != NULL)
+		p_ctx = (dfu_verify_ctx_t *)calloc(num_ports, sizeof(dfu_verify_ctx_t));
+
+		if (p_ctx == NULL)
 		{
-			logger_info_1("Sending Application image.");
+			logger_error("Cannot allocate memory!");
 
-			err_code = dfu_send_object(p_dfu->p_uart, p_dfu_object, zip_pkg);
+			err_code = 1;
 		}
 	}
 
-	for (i = 0; i < DFU_OBJECT_NUM_MAX; i++)
-		free_dfu_json_obj(dfu_objects + i);
+	if (!err_code)
+	{
+		// one checker per port, the targets are queried in parallel
+		for (i = 0; i < num_ports; i++)
+		{
+			p_ctx[i].p_pkg = p_pkg;
+			p_ctx[i].p_verify = p_verify + i;
+
+			if (p_verify[i].p_uart == NULL)
+				continue;
+
+#ifndef WIN32
+			p_ctx[i].started = !pthread_create(&p_ctx[i].thread, NULL, dfu_verify_thread, p_ctx + i);
 
-	if (buf_json != NULL)
-		free(buf_json);
+			if (!p_ctx[i].started)
+#endif
+			{
+				dfu_verify_thread(p_ctx + i);
+			}
+		}
+
+		for (i = 0; i < num_ports; i++)
+		{
+#ifndef WIN32
+			if (p_ctx[i].started)
+				pthread_join(p_ctx[i].thread, NULL);
+#endif
+			if (p_verify[i].p_uart == NULL || p_verify[i].err_code)
+				err_code = 1;
+		}
+
+		free(p_ctx);
+	}
 
-	if (zip_pkg != NULL)
-		zip_close(zip_pkg);
+	dfu_package_free(p_pkg);
 
 	return err_code;
 }
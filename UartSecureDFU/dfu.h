@@ -43,6 +43,7 @@
 #ifndef _INC_DFU
 #define _INC_DFU
 
+#include "dfu_plan.h"
 #include "uart_drv.h"
 #include "uart_slip.h"
 
@@ -52,15 +53,81 @@ extern "C" {
 #endif  /* __cplusplus */
 
 
+// maximum number of images in a package, one per image type
+#define DFU_IMAGE_NUM_MAX       4
+
+// package file name reading the package from the standard input
+#define DFU_PKG_STDIN           "-"
+
+/**
+* @brief Package source: a ZIP file, or a ZIP image in memory or read from a file descriptor.
+*/
+typedef struct
+{
+	const char *p_file;                 //!< ZIP file name, DFU_PKG_STDIN for the standard input.
+	const void *p_data;                 //!< ZIP image in memory if p_file is NULL, not copied, valid until the package is freed.
+	size_t size;                        //!< Size of the ZIP image in memory.
+	int fd;                             //!< File descriptor read to its end if p_file and p_data are NULL.
+} dfu_pkg_source_t;
+
 typedef struct
 {
 	uart_drv_t *p_uart;
 
 	char *p_pkg_file;
+	const dfu_pkg_source_t *p_pkg_src;  //!< Package source, used instead of p_pkg_file if set.
+
+	int skip_installed;                 //!< Skip the images the target already runs.
 } dfu_param_t;
 	
+typedef struct
+{
+	uart_drv_t *p_uart;                 //!< Port to check, NULL if it cannot be opened.
+
+	int err_code;                       //!< Check result, 0 if the target runs the package.
+	uint64_t time_us;                   //!< Check duration.
+} dfu_verify_t;
+
+typedef struct
+{
+	const char *p_name;                 //!< Image type name.
+	uint32_t size;                      //!< Firmware size.
+	int skipped;                        //!< Already installed, not sent.
+	int err_code;                       //!< Image result.
+	uint64_t time_us;                   //!< Time to send the image.
+	dfu_plan_t plan;                    //!< Firmware transfer, predicted and actual.
+} dfu_image_result_t;
+
+typedef struct
+{
+	int num_images;                     //!< Number of images of the package.
+	int current;                        //!< Image being sent.
+	dfu_image_result_t images[DFU_IMAGE_NUM_MAX];   //!< Images in send order.
+} dfu_result_t;
+
+// DFU package, its images decompressed in memory
+typedef struct dfu_package_s dfu_package_t;
+
 int dfu_send_package(dfu_param_t *p_dfu);
 
+// open a package and decompress all its images, to send it to several targets
+int dfu_package_load(const char *p_pkg_file, dfu_package_t **pp_pkg);
+
+// as dfu_package_load(), from a file, memory or a file descriptor
+int dfu_package_load_source(const dfu_pkg_source_t *p_src, dfu_package_t **pp_pkg);
+
+void dfu_package_free(dfu_package_t *p_pkg);
+
+// send a package loaded with dfu_package_load(), may be called from several threads,
+// the outcome of each image is kept in *p_result if not NULL
+int dfu_send_loaded_package(uart_drv_t *p_uart, dfu_package_t *p_pkg, int skip_installed, dfu_result_t *p_result);
+
+// compare the target with a package loaded with dfu_package_load(), writing nothing
+int dfu_verify_loaded_package(uart_drv_t *p_uart, dfu_package_t *p_pkg);
+
+// compare the targets on num_ports ports with a package, in parallel, writing nothing
+int dfu_verify_package(const char *p_pkg_file, dfu_verify_t *p_verify, int num_ports);
+
 #ifdef __cplusplus
 }   /* ... extern "C" */
 #endif  /* __cplusplus */
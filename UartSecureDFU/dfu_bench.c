@@ -0,0 +1,327 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+// UartDfuBench : sends a package to the simulated target at rising fault rates,
+// and reports the time to complete the update and the goodput.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dfu.h"
+#include "uart_drv.h"
+#include "uart_sim.h"
+#include "uart_slip.h"
+#include "logging.h"
+
+#define BENCH_RATES_DEF         "0,0.0001,0.0002,0.0005,0.001,0.002,0.005"
+#define BENCH_RATES_MAX         32
+#define BENCH_TRIALS_DEF        10
+#define BENCH_ATTEMPTS_DEF      20
+
+typedef struct {
+	const char *p_fault;                //!< Fault injected, "all" for every kind.
+	const char *p_sim_opts;             //!< More simulator options, if any.
+	uint32_t baud_rate;                 //!< Bit rate of the simulated link.
+	uint32_t trials;                    //!< Updates per fault rate.
+	uint32_t attempts;                  //!< Sessions per update before giving up.
+	uint32_t seed;                      //!< Seed of the first trial.
+} bench_config_t;
+
+typedef struct {
+	uint32_t ok;                        //!< Updates completed.
+	uint32_t attempts;                  //!< Sessions of the updates completed.
+	uint64_t fw_bytes;                  //!< Firmware bytes of the updates completed.
+	uint64_t tx_bytes;                  //!< Bytes written for the updates completed.
+	uint64_t time_us;                   //!< Time of the updates completed.
+	uint64_t time_max_us;               //!< Longest update completed.
+	uart_sim_faults_t faults;           //!< Faults injected in all the trials.
+} bench_stats_t;
+
+static const char *bench_faults[] = { "flip", "drop", "dup", "delay", "reset", NULL };
+
+static int bench_port_name(char *p_name, size_t size, const bench_config_t *p_cfg, double rate, uint32_t seed)
+{
+	size_t len;
+	int i;
+
+	len = (size_t)snprintf(p_name, size, "%s", UART_SIM_PREFIX);
+
+	for (i = 0; bench_faults[i] != NULL && len < size; i++)
+	{
+		if (!strcmp(p_cfg->p_fault, "all") || !strcmp(p_cfg->p_fault, bench_faults[i]))
+			len += (size_t)snprintf(p_name + len, size - len, "%s=%g,", bench_faults[i], rate);
+	}
+
+	if (len < size)
+		len += (size_t)snprintf(p_name + len, size - len, "seed=%u", seed);
+
+	if (p_cfg->p_sim_opts != NULL && len < size)
+		len += (size_t)snprintf(p_name + len, size - len, ",%s", p_cfg->p_sim_opts);
+
+	return len >= size;
+}
+
+// update one simulated target, a new session resumes each failed one
+static int bench_trial(dfu_package_t *p_pkg, const bench_config_t *p_cfg, double rate, uint32_t seed, bench_stats_t *p_stats)
+{
+	int err_code;
+	char port_name[256];
+	uart_drv_t uart_drv;
+	dfu_result_t result;
+	uart_sim_faults_t faults;
+	uint32_t attempt = 0;
+	uint64_t time_us;
+	int i;
+
+	if (bench_port_name(port_name, sizeof(port_name), p_cfg, rate, seed))
+	{
+		logger_error("Simulator options too long!");
+
+		return 1;
+	}
+
+	memset(&uart_drv, 0, sizeof(uart_drv));
+	uart_drv.p_PortName = port_name;
+	uart_drv.baud_rate = p_cfg->baud_rate;
+	uart_drv.tx_batch_size = UART_SLIP_BATCH_SIZE_DEF;
+
+	err_code = uart_slip_open(&uart_drv);
+	if (err_code)
+		return err_code;
+
+	err_code = dfu_send_loaded_package(&uart_drv, p_pkg, 0, &result);
+
+	while (err_code && ++attempt < p_cfg->attempts)
+	{
+		// the target keeps its state, the stale responses are flushed as by reopening the port
+		uart_slip_drain(&uart_drv);
+
+		err_code = dfu_send_loaded_package(&uart_drv, p_pkg, 0, &result);
+	}
+
+	time_us = uart_sim_time_us(&uart_drv);
+
+	uart_sim_get_faults(&uart_drv, &faults);
+	p_stats->faults.flips += faults.flips;
+	p_stats->faults.drops += faults.drops;
+	p_stats->faults.dups += faults.dups;
+	p_stats->faults.delays += faults.delays;
+	p_stats->faults.resets += faults.resets;
+
+	if (!err_code)
+	{
+		p_stats->ok++;
+		p_stats->attempts += attempt + 1;
+		p_stats->tx_bytes += uart_drv.stats.tx_bytes;
+		p_stats->time_us += time_us;
+		if (time_us > p_stats->time_max_us)
+			p_stats->time_max_us = time_us;
+
+		for (i = 0; i < result.num_images; i++)
+			p_stats->fw_bytes += result.images[i].size;
+	}
+
+	uart_slip_close(&uart_drv);
+
+	// a failed update is a result, not an error of the benchmark
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int err_code = 0;
+	int show_usage = 0;
+	int info_lvl = LOGGER_INFO_LVL_0;
+	const char *p_pkg_file = NULL;
+	const char *p_rates = BENCH_RATES_DEF;
+	double rates[BENCH_RATES_MAX];
+	int num_rates = 0;
+	bench_config_t cfg;
+	dfu_package_t *p_pkg = NULL;
+	int argn, r, i;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.p_fault = "all";
+	cfg.trials = BENCH_TRIALS_DEF;
+	cfg.attempts = BENCH_ATTEMPTS_DEF;
+	cfg.seed = 1;
+
+	if (argc >= 2)
+		p_pkg_file = argv[1];
+	else
+		show_usage = 1;
+
+	for (argn = 2; argn < argc && !show_usage; argn++)
+	{
+		const char *p_value = (argn + 1 < argc) ? argv[argn + 1] : NULL;
+
+		if (!strcmp(argv[argn], "-v"))
+		{
+			logger_set_info_level(++info_lvl);
+		}
+		else if (p_value == NULL)
+		{
+			show_usage = 1;
+		}
+		else if (!strcmp(argv[argn], "--fault"))
+		{
+			cfg.p_fault = p_value;
+			argn++;
+		}
+		else if (!strcmp(argv[argn], "--rates"))
+		{
+			p_rates = p_value;
+			argn++;
+		}
+		else if (!strcmp(argv[argn], "--trials"))
+		{
+			cfg.trials = (uint32_t)atoi(p_value);
+			argn++;
+		}
+		else if (!strcmp(argv[argn], "--attempts"))
+		{
+			cfg.attempts = (uint32_t)atoi(p_value);
+			argn++;
+		}
+		else if (!strcmp(argv[argn], "--seed"))
+		{
+			cfg.seed = (uint32_t)atoi(p_value);
+			argn++;
+		}
+		else if (!strcmp(argv[argn], "-b"))
+		{
+			cfg.baud_rate = (uint32_t)atoi(p_value);
+			argn++;
+		}
+		else if (!strcmp(argv[argn], "--sim"))
+		{
+			cfg.p_sim_opts = p_value;
+			argn++;
+		}
+		else
+		{
+			show_usage = 1;
+		}
+	}
+
+	if (!show_usage)
+	{
+		for (i = 0; bench_faults[i] != NULL && strcmp(cfg.p_fault, bench_faults[i]); i++)
+			;
+
+		if (bench_faults[i] == NULL && strcmp(cfg.p_fault, "all"))
+			show_usage = 1;
+
+		if (!cfg.trials || !cfg.attempts)
+			show_usage = 1;
+	}
+
+	while (!show_usage && *p_rates != '\0')
+	{
+		char *p_end;
+
+		if (num_rates >= BENCH_RATES_MAX)
+		{
+			show_usage = 1;
+
+			break;
+		}
+
+		rates[num_rates] = strtod(p_rates, &p_end);
+
+		if (p_end == p_rates || (*p_end != ',' && *p_end != '\0') || rates[num_rates] < 0.0 || rates[num_rates] > 1.0)
+			show_usage = 1;
+
+		num_rates++;
+		p_rates = (*p_end == ',') ? p_end + 1 : p_end;
+	}
+
+	if (show_usage)
+	{
+		printf("Usage: UartDfuBench package_file [--fault all|flip|drop|dup|delay|reset] [--rates r1,r2,...]\n"
+			"       [--trials n] [--attempts n] [--seed n] [-b baud_rate] [--sim options] [-v]\n");
+
+		return 1;
+	}
+
+	err_code = dfu_package_load(p_pkg_file, &p_pkg);
+
+	if (!err_code)
+	{
+		printf("%-6s %8s %9s %9s %9s %9s %11s %9s\n",
+			"fault", "rate", "ok", "attempts", "time_s", "max_s", "goodput_Bs", "tx/fw");
+
+		for (r = 0; r < num_rates && !err_code; r++)
+		{
+			bench_stats_t stats;
+			uint32_t t;
+
+			memset(&stats, 0, sizeof(stats));
+
+			for (t = 0; t < cfg.trials && !err_code; t++)
+				err_code = bench_trial(p_pkg, &cfg, rates[r], cfg.seed + t, &stats);
+
+			if (stats.ok > 0)
+			{
+				printf("%-6s %8.4f %4u/%-4u %9.2f %9.2f %9.2f %11.0f %9.3f\n",
+					cfg.p_fault, rates[r], stats.ok, cfg.trials,
+					(double)stats.attempts / stats.ok,
+					stats.time_us / 1e6 / stats.ok,
+					stats.time_max_us / 1e6,
+					stats.fw_bytes * 1e6 / stats.time_us,
+					(double)stats.tx_bytes / stats.fw_bytes);
+			}
+			else
+			{
+				printf("%-6s %8.4f %4u/%-4u %9s %9s %9s %11s %9s\n",
+					cfg.p_fault, rates[r], stats.ok, cfg.trials, "-", "-", "-", "-", "-");
+			}
+
+			logger_info_1("Faults: %u flips, %u drops, %u dups, %u delays, %u resets.",
+				stats.faults.flips, stats.faults.drops, stats.faults.dups, stats.faults.delays, stats.faults.resets);
+
+			fflush(stdout);
+		}
+
+		dfu_package_free(p_pkg);
+	}
+
+	return err_code;
+}
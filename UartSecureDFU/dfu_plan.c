@@ -0,0 +1,178 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#include <stdio.h>
+#include <string.h>
+#include "dfu_plan.h"
+#include "slip_enc.h"
+#include "crc32.h"
+#include "logging.h"
+
+#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+
+// DFU opcodes and result of the requests planned
+#define PLAN_OP_OBJECT_CREATE   0x01
+#define PLAN_OP_CRC_GET         0x03
+#define PLAN_OP_OBJECT_EXECUTE  0x04
+#define PLAN_OP_RESPONSE        0x60
+#define PLAN_RES_SUCCESS        0x01
+
+// the object type of the firmware data
+#define PLAN_OBJ_TYPE_DATA      0x02
+
+static void put_uint32_le(uint8_t *p_data, uint32_t data)
+{
+	p_data[0] = (uint8_t)data;
+	p_data[1] = (uint8_t)(data >> 8);
+	p_data[2] = (uint8_t)(data >> 16);
+	p_data[3] = (uint8_t)(data >> 24);
+}
+
+uint64_t dfu_plan_wire_us(const dfu_plan_link_t *p_link, uint64_t num_bytes)
+{
+	return p_link->baud_rate ? num_bytes * 10 * 1000000 / p_link->baud_rate : 0;
+}
+
+uint32_t dfu_plan_frame_bytes(const uint8_t *p_data, uint32_t size)
+{
+	return size + slip_escape_count(p_data, size) + 1;
+}
+
+// encoded size of a CRC response, a receipt notification being the same
+static uint32_t plan_crc_rsp_bytes(uint32_t offset, uint32_t crc)
+{
+	uint8_t rsp[11] = { PLAN_OP_RESPONSE, PLAN_OP_CRC_GET, PLAN_RES_SUCCESS };
+
+	put_uint32_le(rsp + 3, offset);
+	put_uint32_le(rsp + 7, crc);
+
+	return dfu_plan_frame_bytes(rsp, sizeof(rsp));
+}
+
+// encoded size of a response without data
+static uint32_t plan_rsp_bytes(uint8_t op)
+{
+	uint8_t rsp[3] = { PLAN_OP_RESPONSE, op, PLAN_RES_SUCCESS };
+
+	return dfu_plan_frame_bytes(rsp, sizeof(rsp));
+}
+
+void dfu_plan_add(const dfu_plan_link_t *p_link, const uint8_t *p_data, uint32_t offset, uint32_t size, uint32_t crc, dfu_plan_t *p_plan)
+{
+	uint8_t create[6] = { PLAN_OP_OBJECT_CREATE, PLAN_OBJ_TYPE_DATA };
+	const uint8_t op_crc = PLAN_OP_CRC_GET;
+	const uint8_t op_execute = PLAN_OP_OBJECT_EXECUTE;
+	uint32_t pos, end = offset + size;
+	uint32_t obj_size, frame_pos, stp, esc;
+	uint32_t frame_cnt;
+
+	for (pos = offset; pos < end; pos += obj_size)
+	{
+		obj_size = MIN(end - pos, p_link->object_size);
+
+		put_uint32_le(create + 2, obj_size);
+		p_plan->tx_bytes += dfu_plan_frame_bytes(create, sizeof(create));
+		p_plan->rx_bytes += plan_rsp_bytes(PLAN_OP_OBJECT_CREATE);
+		p_plan->num_round_trips++;
+
+		// the receipt notification counter restarts with each object
+		frame_cnt = 0;
+
+		for (frame_pos = 0; frame_pos < obj_size; frame_pos += stp)
+		{
+			stp = MIN(obj_size - frame_pos, p_link->frame_size);
+			esc = slip_escape_count(p_data + pos + frame_pos, stp);
+
+			// write opcode, data and escapes, end
+			p_plan->tx_bytes += 1 + stp + esc + 1;
+			p_plan->num_escapes += esc;
+			p_plan->num_frames++;
+
+			crc = crc32_compute(p_data + pos + frame_pos, stp, &crc);
+
+			if (p_link->prn && ++frame_cnt % p_link->prn == 0)
+			{
+				p_plan->rx_bytes += plan_crc_rsp_bytes(pos + frame_pos + stp, crc);
+				p_plan->num_round_trips++;
+			}
+		}
+
+		p_plan->tx_bytes += dfu_plan_frame_bytes(&op_crc, 1);
+		p_plan->rx_bytes += plan_crc_rsp_bytes(pos + obj_size, crc);
+		p_plan->num_round_trips++;
+
+		p_plan->tx_bytes += dfu_plan_frame_bytes(&op_execute, 1);
+		p_plan->rx_bytes += plan_rsp_bytes(PLAN_OP_OBJECT_EXECUTE);
+		p_plan->num_round_trips++;
+
+		p_plan->num_objects++;
+	}
+
+	// the requests and responses mostly take turns on the link
+	p_plan->time_us = dfu_plan_wire_us(p_link, p_plan->tx_bytes + p_plan->rx_bytes) +
+		p_plan->num_round_trips * p_link->turnaround_us;
+}
+
+int dfu_plan_log(const char *p_file, const char *p_port, const dfu_plan_link_t *p_link, const dfu_plan_t *p_plan)
+{
+	FILE *p_log;
+
+	p_log = fopen(p_file, "a");
+
+	if (p_log == NULL)
+	{
+		logger_error("Cannot open ETA log file!");
+
+		return 1;
+	}
+
+	// a new file starts with the column names
+	if (ftell(p_log) == 0)
+		fprintf(p_log, "port,objects,frames,escapes,tx_bytes,rx_bytes,round_trips,baud_rate,turnaround_us,predicted_us,actual_us,actual_bytes\n");
+
+	fprintf(p_log, "%s,%u,%u,%u,%llu,%llu,%u,%u,%llu,%llu,%llu,%llu\n", p_port,
+		p_plan->num_objects, p_plan->num_frames, p_plan->num_escapes,
+		(unsigned long long)p_plan->tx_bytes, (unsigned long long)p_plan->rx_bytes, p_plan->num_round_trips,
+		p_link->baud_rate, (unsigned long long)p_link->turnaround_us,
+		(unsigned long long)p_plan->time_us, (unsigned long long)p_plan->actual_us, (unsigned long long)p_plan->actual_bytes);
+
+	fclose(p_log);
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#pragma once
+ 
+#ifndef _INC_DFU_PLAN
+#define _INC_DFU_PLAN
+
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/**
+* @brief Link parameters the transfer time depends on.
+*/
+typedef struct
+{
+	uint32_t frame_size;                //!< Data bytes per write frame.
+	uint32_t object_size;               //!< Data object size.
+	uint16_t prn;                       //!< Packet receipt notification window, 0 for none.
+	uint32_t baud_rate;                 //!< Bit rate.
+	uint64_t turnaround_us;             //!< Measured round trip time, less the time on the wire.
+} dfu_plan_link_t;
+
+/**
+* @brief Transfer prediction, and the actual time once done.
+*/
+typedef struct
+{
+	uint32_t num_objects;               //!< Data objects.
+	uint32_t num_frames;                //!< Write frames.
+	uint32_t num_escapes;               //!< SLIP escapes in the requests.
+	uint64_t tx_bytes;                  //!< Encoded bytes sent.
+	uint64_t rx_bytes;                  //!< Encoded bytes received.
+	uint32_t num_round_trips;           //!< Responses waited for.
+	uint64_t time_us;                   //!< Predicted time.
+	uint64_t actual_us;                 //!< Actual time, 0 if not done.
+	uint64_t actual_bytes;              //!< Actual bytes sent and received.
+} dfu_plan_t;
+
+// wire time of a number of bytes, 10 bits per byte
+uint64_t dfu_plan_wire_us(const dfu_plan_link_t *p_link, uint64_t num_bytes);
+
+// SLIP encoded size of a frame
+uint32_t dfu_plan_frame_bytes(const uint8_t *p_data, uint32_t size);
+
+// add the transfer of p_data[offset..offset+size) to a plan, in objects from offset;
+// crc is the CRC-32 of the data before offset, to predict the CRC responses exactly
+void dfu_plan_add(const dfu_plan_link_t *p_link, const uint8_t *p_data, uint32_t offset, uint32_t size, uint32_t crc, dfu_plan_t *p_plan);
+
+// append a transfer done to a CSV file, to calibrate the predictions
+int dfu_plan_log(const char *p_file, const char *p_port, const dfu_plan_link_t *p_link, const dfu_plan_t *p_plan);
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_DFU_PLAN
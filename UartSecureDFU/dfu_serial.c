@@ -39,14 +39,33 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "dfu_serial.h"
 #include "crc32.h"
+#include "dfu_plan.h"
+#include "journal.h"
+#include "link_profile.h"
 #include "logging.h"
+#include "sys_time.h"
 
 // SLIP data log buffer size
 #define MAX_BUFF_SIZE           1024
 
+// link auto-tuning: number of probes, burst window steps and limits
+#define TUNE_PROBE_NUM_MAX      12
+#define TUNE_ERROR_NUM_MAX      2
+#define TUNE_WINDOW_STEP        4
+#define TUNE_WINDOW_MAX         32
+#define TUNE_FRAME_SIZE_MIN     16
+
+// stray frames skipped while waiting for a response, in resync mode
+#define STRAY_FRAMES_MAX        4
+
+// in-session retries: number of retries in a row without progress, first backoff delay
+#define RETRY_NUM_MAX           4
+#define RETRY_BACKOFF_US        100000
+
 /**
 * @brief DFU protocol operation.
 */
@@ -108,14 +127,29 @@ typedef struct
 #define MIN(a,b) (((a) < (b)) ? (a) : (b))
 
 
-static uint8_t ping_id = 0;
-static uint16_t prn = 0;
-static uint16_t mtu = 0;
-
-static uint8_t send_data[UART_SLIP_SIZE_MAX];
-static uint8_t receive_data[UART_SLIP_SIZE_MAX];
-
-static char logger_buff[MAX_BUFF_SIZE];
+/**
+* @brief DFU protocol state of a port.
+*/
+typedef struct dfu_serial_s
+{
+	uint8_t ping_id;                    //!< Last ping id.
+	uint16_t prn;                       //!< Packet receipt notification.
+	uint16_t mtu;                       //!< Target MTU.
+	uint32_t frame_size;                //!< Data bytes per write frame, 0 for the most the MTU allows.
+	uint32_t progress_size;             //!< Size of the firmware being sent, 0 for no progress report.
+	uint64_t turnaround_us;             //!< Round trip time less the time on the wire, measured on open.
+	uint64_t eta_us;                    //!< Firmware time left, predicted at the last object start.
+	uint64_t eta_time_us;               //!< Time of the last prediction.
+	uint8_t rsp_result;                 //!< Result code of the last response.
+	int err_fatal;                      //!< The last error cannot clear on a retry.
+	uint32_t fw_offset;                 //!< Firmware offset executed last.
+	uint32_t retry_cnt;                 //!< Retries since the firmware offset last moved.
+	uint32_t retry_offset;              //!< Firmware offset at the last retry.
+
+	uint8_t receive_data[UART_SLIP_SIZE_MAX];   //!< Decoded response.
+
+	char logger_buff[MAX_BUFF_SIZE];    //!< SLIP data log.
+} dfu_serial_t;
 
 static uint16_t get_uint16_le(const uint8_t *p_data)
 {
@@ -153,69 +187,100 @@ static void put_uint32_le(uint8_t *p_data, uint32_t data)
 	*(p_data + 3) = (uint8_t)(data >> 24);
 }
 
-static void uart_data_to_buff(const uint8_t *pData, uint32_t nSize)
+static void uart_data_to_buff(char *logger_buff, size_t buff_size, const slip_iov_t *pIov, uint32_t nCount)
 {
-	uint32_t n;
+	uint32_t i, n;
 	char data_buff[6];
 	int len, pos;
 
 	logger_buff[0] = '\0';
 	pos = 0;
 
-	for (n = 0; n < nSize; n++)
+	for (i = 0; i < nCount; i++)
 	{
-		if (!n)
-			len = sprintf(data_buff, "%u", *(pData + n));
-		else
-			len = sprintf(data_buff, ", %u", *(pData + n));
+		const uint8_t *pData = (pIov + i)->pData;
 
-		if ((size_t)len + 1 < sizeof(logger_buff) - pos)
+		for (n = 0; n < (pIov + i)->nSize; n++)
 		{
-			strcat(logger_buff, data_buff);
+			if (!pos)
+				len = sprintf(data_buff, "%u", *(pData + n));
+			else
+				len = sprintf(data_buff, ", %u", *(pData + n));
 
-			pos += len;
-		}
-		else
-		{
-			// not enough data buffer...
-			break;
+			if ((size_t)len + 1 < buff_size - pos)
+			{
+				strcat(logger_buff, data_buff);
+
+				pos += len;
+			}
+			else
+			{
+				// not enough data buffer...
+				return;
+			}
 		}
 	}
 }
 
-static int dfu_serial_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+static int dfu_serial_send_iov(uart_drv_t *p_uart, const slip_iov_t *pIov, uint32_t nCount, uint32_t *p_crc)
 {
 	int info_lvl = logger_get_info_level();
 
 	if (info_lvl >= LOGGER_INFO_LVL_3)
 	{
-		uart_data_to_buff(pData, nSize);
-		logger_info_3("SLIP: --> [%s]", logger_buff);
+		dfu_serial_t *p_dfu = p_uart->p_dfu;
+
+		uart_data_to_buff(p_dfu->logger_buff, sizeof(p_dfu->logger_buff), pIov, nCount);
+		logger_info_3("SLIP: --> [%s]", p_dfu->logger_buff);
 	}
 
-	return uart_slip_send(p_uart, pData, nSize);
+	// the running CRC covers the payload, not the opcode
+	if (p_crc != NULL)
+		return uart_slip_send_iov_crc(p_uart, pIov, nCount, 1, p_crc);
+	else
+		return uart_slip_send_iov(p_uart, pIov, nCount);
+}
+
+static int dfu_serial_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+{
+	slip_iov_t iov;
+
+	iov.pData = pData;
+	iov.nSize = nSize;
+
+	return dfu_serial_send_iov(p_uart, &iov, 1, NULL);
 }
 
 static int dfu_serial_get_rsp(uart_drv_t *p_uart, nrf_dfu_op_t oper, uint32_t *p_data_cnt)
 {
 	int err_code;
+	dfu_serial_t *p_dfu = p_uart->p_dfu;
+	const uint8_t *receive_data = p_dfu->receive_data;
+	uint32_t stray_cnt = 0;
 
-	err_code = uart_slip_receive(p_uart, receive_data, sizeof(receive_data), p_data_cnt);
+	p_dfu->rsp_result = NRF_DFU_RES_CODE_INVALID;
 
-	if (!err_code)
+	while (!(err_code = uart_slip_receive(p_uart, p_dfu->receive_data, sizeof(p_dfu->receive_data), p_data_cnt)))
 	{
 		int info_lvl = logger_get_info_level();
 
 		if (info_lvl >= LOGGER_INFO_LVL_3)
 		{
-			uart_data_to_buff(receive_data, *p_data_cnt);
-			logger_info_3("SLIP: <-- [%s]", logger_buff);
+			slip_iov_t iov;
+
+			iov.pData = receive_data;
+			iov.nSize = *p_data_cnt;
+
+			uart_data_to_buff(p_dfu->logger_buff, sizeof(p_dfu->logger_buff), &iov, 1);
+			logger_info_3("SLIP: <-- [%s]", p_dfu->logger_buff);
 		}
 
 		if (*p_data_cnt >= 3 &&
 			receive_data[0] == NRF_DFU_OP_RESPONSE &&
 			receive_data[1] == oper)
 		{
+			p_dfu->rsp_result = receive_data[2];
+
 			if (receive_data[2] != NRF_DFU_RES_CODE_SUCCESS)
 			{
 				uint16_t rsp_error = receive_data[2];
@@ -226,15 +291,53 @@ static int dfu_serial_get_rsp(uart_drv_t *p_uart, nrf_dfu_op_t oper, uint32_t *p
 
 				logger_error("Bad result code (0x%X)!", rsp_error);
 
+				// the target rejected the object itself, sending it again does not help
+				if (receive_data[2] == NRF_DFU_RES_CODE_INVALID_OBJECT ||
+					receive_data[2] == NRF_DFU_RES_CODE_EXT_ERROR)
+					p_dfu->err_fatal = 1;
+
 				err_code = 1;
 			}
+
+			break;
 		}
-		else
+
+		// in resync mode, line noise that decoded or the late response to an earlier request is skipped
+		if (!p_uart->slip_resync || ++stray_cnt > STRAY_FRAMES_MAX)
 		{
 			logger_error("Invalid response!");
 
 			err_code = 1;
+
+			break;
 		}
+
+		logger_info_2("Stray frame skipped.");
+	}
+
+	return err_code;
+}
+
+// send a request and get its response; in resync mode, a request the target answered
+// with no valid response, lost to line noise, is sent once more
+static int dfu_serial_request(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize, uint32_t *p_data_cnt)
+{
+	int err_code;
+	int tries = p_uart->slip_resync ? 2 : 1;
+
+	while (1)
+	{
+		err_code = dfu_serial_send(p_uart, pData, nSize);
+
+		if (!err_code)
+			err_code = dfu_serial_get_rsp(p_uart, (nrf_dfu_op_t)pData[0], p_data_cnt);
+
+		if (!err_code || --tries <= 0 ||
+			p_uart->p_dfu->rsp_result != NRF_DFU_RES_CODE_INVALID ||
+			(p_uart->p_cancel != NULL && *p_uart->p_cancel))
+			break;
+
+		logger_info_1("No valid response, sending the request again.");
 	}
 
 	return err_code;
@@ -243,26 +346,20 @@ static int dfu_serial_get_rsp(uart_drv_t *p_uart, nrf_dfu_op_t oper, uint32_t *p
 static int dfu_serial_ping(uart_drv_t *p_uart, uint8_t id)
 {
 	int err_code;
+	uint32_t data_cnt;
 	uint8_t send_data[2] = { NRF_DFU_OP_PING };
 
 	send_data[1] = id;
-	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
+	err_code = dfu_serial_request(p_uart, send_data, sizeof(send_data), &data_cnt);
 
 	if (!err_code)
 	{
-		uint32_t data_cnt;
-
-		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_PING, &data_cnt);
-
-		if (!err_code)
+		if (data_cnt != 4 ||
+			p_uart->p_dfu->receive_data[3] != id)
 		{
-			if (data_cnt != 4 ||
-				receive_data[3] != id)
-			{
-				logger_error("Bad ping id!");
+			logger_error("Bad ping id!");
 
-				err_code = 1;
-			}
+			err_code = 1;
 		}
 	}
 
@@ -272,19 +369,13 @@ static int dfu_serial_ping(uart_drv_t *p_uart, uint8_t id)
 static int dfu_serial_set_prn(uart_drv_t *p_uart, uint16_t prn)
 {
 	int err_code;
+	uint32_t data_cnt;
 	uint8_t send_data[3] = { NRF_DFU_OP_RECEIPT_NOTIF_SET };
 	
 	logger_info_2("Set Packet Receipt Notification %u", prn);
 
 	put_uint16_le(send_data + 1, prn);
-	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
-
-	if (!err_code)
-	{
-		uint32_t data_cnt;
-
-		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_RECEIPT_NOTIF_SET, &data_cnt);
-	}
+	err_code = dfu_serial_request(p_uart, send_data, sizeof(send_data), &data_cnt);
 
 	return err_code;
 }
@@ -292,30 +383,32 @@ static int dfu_serial_set_prn(uart_drv_t *p_uart, uint16_t prn)
 static int dfu_serial_get_mtu(uart_drv_t *p_uart, uint16_t *p_mtu)
 {
 	int err_code;
+	uint32_t data_cnt;
 	uint8_t send_data[1] = { NRF_DFU_OP_MTU_GET };
 
-	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
+	err_code = dfu_serial_request(p_uart, send_data, sizeof(send_data), &data_cnt);
 
 	if (!err_code)
 	{
-		uint32_t data_cnt;
+		if (data_cnt == 5)
+		{
+			uint16_t mtu = get_uint16_le(p_uart->p_dfu->receive_data + 3);
 
-		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_MTU_GET, &data_cnt);
+			*p_mtu = mtu;
 
-		if (!err_code)
-		{
-			if (data_cnt == 5)
+			// the MTU counts the frame SLIP encoded, the frames sent take the size it allows
+			if (mtu >= 5)
 			{
-				uint16_t mtu = get_uint16_le(receive_data + 3);
+				uint32_t frame_max = uart_slip_set_tx_size(p_uart, (mtu - 1) / 2);
 
-				*p_mtu = mtu;
+				logger_info_2("MTU %u, frames of up to %u bytes.", mtu, frame_max);
 			}
-			else
-			{
-				logger_error("Invalid MTU!");
+		}
+		else
+		{
+			logger_error("Invalid MTU!");
 
-				err_code = 1;
-			}
+			err_code = 1;
 		}
 	}
 
@@ -325,35 +418,29 @@ static int dfu_serial_get_mtu(uart_drv_t *p_uart, uint16_t *p_mtu)
 static int dfu_serial_select_obj(uart_drv_t *p_uart, uint8_t obj_type, nrf_dfu_response_select_t *p_select_rsp)
 {
 	int err_code;
+	uint32_t data_cnt;
 	uint8_t send_data[2] = { NRF_DFU_OP_OBJECT_SELECT };
 
 	logger_info_2("Selecting Object: type:%u", obj_type);
 
 	send_data[1] = obj_type;
-	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
+	err_code = dfu_serial_request(p_uart, send_data, sizeof(send_data), &data_cnt);
 
 	if (!err_code)
 	{
-		uint32_t data_cnt;
-
-		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_OBJECT_SELECT, &data_cnt);
-
-		if (!err_code)
+		if (data_cnt == 15)
 		{
-			if (data_cnt == 15)
-			{
-				p_select_rsp->max_size = get_uint32_le(receive_data + 3);
-				p_select_rsp->offset   = get_uint32_le(receive_data + 7);
-				p_select_rsp->crc      = get_uint32_le(receive_data + 11);
+			p_select_rsp->max_size = get_uint32_le(p_uart->p_dfu->receive_data + 3);
+			p_select_rsp->offset   = get_uint32_le(p_uart->p_dfu->receive_data + 7);
+			p_select_rsp->crc      = get_uint32_le(p_uart->p_dfu->receive_data + 11);
 
-				logger_info_2("Object selected:  max_size:%u offset:%u crc:0x%08X", p_select_rsp->max_size, p_select_rsp->offset, p_select_rsp->crc);
-			}
-			else
-			{
-				logger_error("Invalid object response!");
+			logger_info_2("Object selected:  max_size:%u offset:%u crc:0x%08X", p_select_rsp->max_size, p_select_rsp->offset, p_select_rsp->crc);
+		}
+		else
+		{
+			logger_error("Invalid object response!");
 
-				err_code = 1;
-			}
+			err_code = 1;
 		}
 	}
 
@@ -379,10 +466,68 @@ static int dfu_serial_create_obj(uart_drv_t *p_uart, uint8_t obj_type, uint32_t
 	return err_code;
 }
 
-static int dfu_serial_stream_data(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size)
+// read a packet receipt notification and check it
+static int dfu_serial_get_prn_crc(uart_drv_t *p_uart, uint32_t offset, uint32_t crc)
+{
+	int err_code;
+	uint32_t data_cnt;
+
+	err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_CRC_GET, &data_cnt);
+
+	if (!err_code)
+	{
+		if (data_cnt != 11)
+		{
+			logger_error("Invalid CRC response!");
+
+			err_code = 1;
+		}
+		else if (get_uint32_le(p_uart->p_dfu->receive_data + 3) != offset ||
+				 get_uint32_le(p_uart->p_dfu->receive_data + 7) != crc)
+		{
+			logger_error("Invalid offset or CRC notified (%u)!", offset);
+
+			err_code = 2;
+		}
+	}
+
+	return err_code;
+}
+
+// data bytes per write frame, 0 if the MTU is too small
+static uint32_t dfu_serial_frame_payload(uart_drv_t *p_uart)
+{
+	uint16_t mtu = p_uart->p_dfu->mtu;
+	uint32_t stp_max = 0;
+
+	if (mtu >= 5)
+	{
+		stp_max = MIN((mtu - 1) / 2, p_uart->p_slip->tx_size_max) - 1;
+
+		if (p_uart->p_dfu->frame_size && p_uart->p_dfu->frame_size < stp_max)
+			stp_max = p_uart->p_dfu->frame_size;
+	}
+
+	return stp_max;
+}
+
+// firmware time left, counting down from the prediction at the last object start
+static uint64_t dfu_serial_eta_us(uart_drv_t *p_uart)
+{
+	uint64_t elapsed_us = sys_time_us() - p_uart->p_dfu->eta_time_us;
+
+	return (p_uart->p_dfu->eta_us > elapsed_us) ? p_uart->p_dfu->eta_us - elapsed_us : 0;
+}
+
+// stream data at offset in the object, updating the running CRC-32 in *p_crc in the same pass
+static int dfu_serial_stream_data(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t offset, uint32_t *p_crc)
 {
 	int err_code = 0;
+	uint16_t prn = p_uart->p_dfu->prn;
+	uint32_t frame_cnt = 0;
 	uint32_t pos, stp, stp_max;
+	const uint8_t op_write = NRF_DFU_OP_OBJECT_WRITE;
+	slip_iov_t iov[2];
 
 	if (p_data == NULL || !data_size)
 	{
@@ -391,11 +536,9 @@ static int dfu_serial_stream_data(uart_drv_t *p_uart, const uint8_t *p_data, uin
 
 	if (!err_code)
 	{
-		if (mtu >= 5)
-		{
-			stp_max = (mtu - 1) / 2 - 1;
-		}
-		else
+		stp_max = dfu_serial_frame_payload(p_uart);
+
+		if (!stp_max)
 		{
 			logger_error("MTU is too small to send data!");
 
@@ -403,43 +546,69 @@ static int dfu_serial_stream_data(uart_drv_t *p_uart, const uint8_t *p_data, uin
 		}
 	}
 
+	// the opcode and the payload are encoded straight from the image
+	iov[0].pData = &op_write;
+	iov[0].nSize = 1;
+
+	// the frames of the object are written together
+	uart_slip_batch_begin(p_uart);
+
 	for (pos = 0; !err_code && pos < data_size; pos += stp)
 	{
-		send_data[0] = NRF_DFU_OP_OBJECT_WRITE;
+		if (p_uart->p_cancel != NULL && *p_uart->p_cancel)
+		{
+			logger_error("DFU cancelled!");
+
+			p_uart->p_dfu->err_fatal = 1;
+			err_code = 1;
+			break;
+		}
+
 		stp = MIN((data_size - pos), stp_max);
-		memcpy(send_data + 1, p_data + pos, stp);
-		err_code = dfu_serial_send(p_uart, send_data, stp + 1);
+		iov[1].pData = p_data + pos;
+		iov[1].nSize = stp;
+		err_code = dfu_serial_send_iov(p_uart, iov, 2, p_crc);
+
+		if (!err_code && p_uart->p_progress != NULL && p_uart->p_dfu->progress_size)
+			p_uart->p_progress(p_uart->p_progress_context, offset + pos + stp, p_uart->p_dfu->progress_size, dfu_serial_eta_us(p_uart));
+
+		// the target reports its CRC every prn frames, the next frames wait for it
+		if (!err_code && prn && ++frame_cnt % prn == 0)
+		{
+			err_code = dfu_serial_get_prn_crc(p_uart, offset + pos + stp, *p_crc);
+
+			uart_slip_batch_begin(p_uart);
+		}
 	}
 
+	if (!err_code)
+		err_code = uart_slip_flush(p_uart);
+	else
+		uart_slip_flush(p_uart);
+
 	return err_code;
 }
 
 static int dfu_serial_get_crc(uart_drv_t *p_uart, nrf_dfu_response_crc_t *p_crc_rsp)
 {
 	int err_code;
+	uint32_t data_cnt;
 	uint8_t send_data[1] = { NRF_DFU_OP_CRC_GET };
 
-	err_code = dfu_serial_send(p_uart, send_data, sizeof(send_data));
+	err_code = dfu_serial_request(p_uart, send_data, sizeof(send_data), &data_cnt);
 
 	if (!err_code)
 	{
-		uint32_t data_cnt;
-
-		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_CRC_GET, &data_cnt);
-
-		if (!err_code)
+		if (data_cnt == 11)
 		{
-			if (data_cnt == 11)
-			{
-				p_crc_rsp->offset = get_uint32_le(receive_data + 3);
-				p_crc_rsp->crc    = get_uint32_le(receive_data + 7);
-			}
-			else
-			{
-				logger_error("Invalid CRC response!");
+			p_crc_rsp->offset = get_uint32_le(p_uart->p_dfu->receive_data + 3);
+			p_crc_rsp->crc    = get_uint32_le(p_uart->p_dfu->receive_data + 7);
+		}
+		else
+		{
+			logger_error("Invalid CRC response!");
 
-				err_code = 1;
-			}
+			err_code = 1;
 		}
 	}
 
@@ -470,12 +639,10 @@ static int dfu_serial_stream_data_crc(uart_drv_t *p_uart, const uint8_t *p_data,
 
 	logger_info_2("Streaming Data: len:%u offset:%u crc:0x%08X", data_size, pos, *p_crc);
 
-	err_code = dfu_serial_stream_data(p_uart, p_data, data_size);
+	err_code = dfu_serial_stream_data(p_uart, p_data, data_size, pos, p_crc);
 
 	if (!err_code)
 	{
-		*p_crc = crc32_compute(p_data, data_size, p_crc);
-
 		err_code = dfu_serial_get_crc(p_uart, &rsp_crc);
 	}
 
@@ -498,7 +665,7 @@ static int dfu_serial_stream_data_crc(uart_drv_t *p_uart, const uint8_t *p_data,
 	return err_code;
 }
 
-static int dfu_serial_try_to_recover_ip(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size,
+static int dfu_serial_try_to_recover_ip(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t data_crc,
 										nrf_dfu_response_select_t *p_rsp_recover,
 										const nrf_dfu_response_select_t *p_rsp_select)
 {
@@ -512,7 +679,11 @@ static int dfu_serial_try_to_recover_ip(uart_drv_t *p_uart, const uint8_t *p_dat
 
 	if (pos_start > 0 && pos_start <= data_size)
 	{
-		crc_32 = crc32_compute(p_data, pos_start, NULL);
+		// the CRC of the whole init packet is known from the package
+		if (pos_start == data_size)
+			crc_32 = data_crc;
+		else
+			crc_32 = crc32_compute(p_data, pos_start, NULL);
 
 		if (p_rsp_select->crc != crc_32)
 		{
@@ -550,7 +721,7 @@ static int dfu_serial_try_to_recover_ip(uart_drv_t *p_uart, const uint8_t *p_dat
 	return err_code;
 }
 
-static int dfu_serial_try_to_recover_fw(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size,
+static int dfu_serial_try_to_recover_fw(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t data_crc,
 										nrf_dfu_response_select_t *p_rsp_recover,
 										const nrf_dfu_response_select_t *p_rsp_select)
 {
@@ -561,6 +732,7 @@ static int dfu_serial_try_to_recover_fw(uart_drv_t *p_uart, const uint8_t *p_dat
 	int obj_exec = 1;
 
 	*p_rsp_recover = *p_rsp_select;
+	p_rsp_recover->crc = 0;
 
 	pos_start = p_rsp_recover->offset;
 
@@ -573,20 +745,26 @@ static int dfu_serial_try_to_recover_fw(uart_drv_t *p_uart, const uint8_t *p_dat
 	else if (pos_start > 0)
 	{
 		max_size = p_rsp_select->max_size;
-		crc_32 = crc32_compute(p_data, pos_start, NULL);
+		// the CRC of the whole image is known from the package
+		if (pos_start == data_size)
+			crc_32 = data_crc;
+		else
+			crc_32 = crc32_compute(p_data, pos_start, NULL);
 		len_remain = pos_start % max_size;
 
 		if (p_rsp_select->crc != crc_32)
 		{
 			pos_start -= ((len_remain > 0) ? len_remain : max_size);
 			p_rsp_recover->offset = pos_start;
+			p_rsp_recover->crc = crc32_compute(p_data, pos_start, NULL);
 
 			return err_code;
 		}
 
-		if (len_remain > 0)
+		// the last object may be shorter, it may even be complete
+		if (len_remain > 0 && pos_start < data_size)
 		{
-			stp_size = max_size - len_remain;
+			stp_size = MIN(max_size - len_remain, data_size - pos_start);
 
 			err_code = dfu_serial_stream_data_crc(p_uart, p_data + pos_start, stp_size, pos_start, &crc_32);
 			if (!err_code)
@@ -598,6 +776,7 @@ static int dfu_serial_try_to_recover_fw(uart_drv_t *p_uart, const uint8_t *p_dat
 				err_code = 0;
 
 				pos_start -= len_remain;
+				crc_32 = crc32_compute(p_data, pos_start, NULL);
 
 				obj_exec = 0;
 			}
@@ -605,42 +784,353 @@ static int dfu_serial_try_to_recover_fw(uart_drv_t *p_uart, const uint8_t *p_dat
 			p_rsp_recover->offset = pos_start;
 		}
 
+		p_rsp_recover->crc = crc_32;
+
+		if (!err_code && pos_start == data_size && crc_32 != data_crc)
+		{
+			logger_error("Firmware CRC does not match the package!");
+
+			p_uart->p_dfu->err_fatal = 1;
+			err_code = 1;
+		}
+
 		if (!err_code && obj_exec)
 		{
 			err_code = dfu_serial_execute_obj(p_uart);
+
+			// an object created but still empty is refused, the objects before it are executed already
+			if (err_code && !len_remain && p_uart->p_dfu->rsp_result == NRF_DFU_RES_CODE_OPERATION_NOT_PERMITTED)
+				err_code = 0;
 		}
+
+		if (!err_code)
+			p_uart->p_dfu->fw_offset = pos_start;
 	}
 
 	return err_code;
 }
 
+// send a burst of padded pings, as long as write frames of frame_size data bytes,
+// and time the round trip of the burst
+static int dfu_serial_probe(uart_drv_t *p_uart, uint32_t frame_size, uint32_t window, uint64_t *p_time_us)
+{
+	int err_code = 0;
+	dfu_serial_t *p_dfu = p_uart->p_dfu;
+	uint8_t *send_data;
+	uint8_t first_id = p_dfu->ping_id + 1;
+	uint64_t time_us = sys_time_us();
+	uint32_t data_cnt;
+	uint32_t n;
+
+	send_data = (uint8_t *)malloc(frame_size + 1);
+	if (send_data == NULL)
+		return 1;
+
+	// the padding is escaped like image data
+	send_data[0] = NRF_DFU_OP_PING;
+	for (n = 2; n <= frame_size; n++)
+		send_data[n] = (uint8_t)(n * 0x5B);
+
+	uart_slip_batch_begin(p_uart);
+
+	for (n = 0; !err_code && n < window; n++)
+	{
+		send_data[1] = ++p_dfu->ping_id;
+		err_code = dfu_serial_send(p_uart, send_data, frame_size + 1);
+	}
+
+	for (n = 0; !err_code && n < window; n++)
+	{
+		err_code = dfu_serial_get_rsp(p_uart, NRF_DFU_OP_PING, &data_cnt);
+
+		if (!err_code && (data_cnt != 4 || p_dfu->receive_data[3] != (uint8_t)(first_id + n)))
+			err_code = 1;
+	}
+
+	if (err_code)
+		uart_slip_flush(p_uart);
+
+	*p_time_us = sys_time_us() - time_us;
+
+	free(send_data);
+
+	return err_code;
+}
+
+// find the fastest reliable frame size and receipt notification window:
+// the burst window grows additively while the probes pass, and is halved,
+// then the frame size, when one fails
+static void dfu_serial_tune(uart_drv_t *p_uart, uint32_t frame_max, link_profile_t *p_profile)
+{
+	uint32_t frame_size = frame_max;
+	uint32_t window = 1;
+	uint32_t best_window = 0;
+	uint64_t best_rate = 0;
+	uint64_t rate, time_us;
+	int n, err_num = 0;
+
+	p_profile->frame_size = TUNE_FRAME_SIZE_MIN;
+	p_profile->prn = 1;
+
+	for (n = 0; n < TUNE_PROBE_NUM_MAX && err_num < TUNE_ERROR_NUM_MAX; n++)
+	{
+		if (!dfu_serial_probe(p_uart, frame_size, window, &time_us))
+		{
+			rate = (uint64_t)frame_size * window * 1000000 / (time_us ? time_us : 1);
+
+			logger_info_2("Link probe: frame:%u window:%u %u B/s", frame_size, window, (uint32_t)rate);
+
+			if (rate > best_rate)
+			{
+				best_rate = rate;
+				best_window = window;
+				p_profile->frame_size = frame_size;
+			}
+
+			if (window >= TUNE_WINDOW_MAX)
+				break;
+
+			window += TUNE_WINDOW_STEP;
+			if (window > TUNE_WINDOW_MAX)
+				window = TUNE_WINDOW_MAX;
+		}
+		else
+		{
+			logger_info_2("Link probe: frame:%u window:%u failed", frame_size, window);
+
+			err_num++;
+
+			uart_slip_drain(p_uart);
+
+			if (window > 1)
+				window /= 2;
+			else if (frame_size / 2 >= TUNE_FRAME_SIZE_MIN)
+				frame_size /= 2;
+		}
+	}
+
+	// a link taking the largest burst needs no notifications
+	if (best_window)
+		p_profile->prn = (best_window >= TUNE_WINDOW_MAX) ? 0 : best_window;
+}
+
+// apply the link profile of the device, tuning the link the first time
+static void dfu_serial_set_profile(uart_drv_t *p_uart)
+{
+	dfu_serial_t *p_dfu = p_uart->p_dfu;
+	char key[LINK_PROFILE_KEY_MAX];
+	link_profile_t profile;
+	uint32_t frame_max;
+
+	if (p_dfu->mtu < 5)
+		return;
+
+	frame_max = MIN((p_dfu->mtu - 1) / 2, p_uart->p_slip->tx_size_max) - 1;
+
+	uart_drv_get_key(p_uart, key, sizeof(key));
+
+	if (!link_profile_load(p_uart->p_ProfileName, key, &profile) &&
+		profile.frame_size && profile.frame_size <= frame_max)
+	{
+		logger_info_2("Link profile of %s: frame:%u prn:%u", key, profile.frame_size, profile.prn);
+	}
+	else
+	{
+		dfu_serial_tune(p_uart, frame_max, &profile);
+
+		logger_info_1("Link tuned for %s: frame:%u prn:%u", key, profile.frame_size, profile.prn);
+
+		link_profile_save(p_uart->p_ProfileName, key, &profile);
+	}
+
+	p_dfu->frame_size = profile.frame_size;
+	p_dfu->prn = (uint16_t)profile.prn;
+}
+
+static uint32_t dfu_serial_baud_rate(uart_drv_t *p_uart)
+{
+	return p_uart->baud_rate ? p_uart->baud_rate : UART_DRV_BAUD_RATE_DEF;
+}
+
+// keep the MTU request round trip time, less its time on the wire
+static void dfu_serial_set_turnaround(uart_drv_t *p_uart, uint64_t rtt_us)
+{
+	dfu_plan_link_t link;
+	uint8_t req[1] = { NRF_DFU_OP_MTU_GET };
+	uint8_t rsp[5] = { NRF_DFU_OP_RESPONSE, NRF_DFU_OP_MTU_GET, NRF_DFU_RES_CODE_SUCCESS };
+	uint64_t wire_us;
+
+	put_uint16_le(rsp + 3, p_uart->p_dfu->mtu);
+
+	memset(&link, 0, sizeof(link));
+	link.baud_rate = dfu_serial_baud_rate(p_uart);
+
+	wire_us = dfu_plan_wire_us(&link, dfu_plan_frame_bytes(req, sizeof(req)) + dfu_plan_frame_bytes(rsp, sizeof(rsp)));
+
+	p_uart->p_dfu->turnaround_us = (rtt_us > wire_us) ? rtt_us - wire_us : 0;
+}
+
 int dfu_serial_open(uart_drv_t *p_uart)
 {
 	int err_code;
+	dfu_serial_t *p_dfu = p_uart->p_dfu;
+
+	if (p_dfu == NULL)
+	{
+		p_dfu = (dfu_serial_t *)calloc(1, sizeof(dfu_serial_t));
+		p_uart->p_dfu = p_dfu;
+
+		if (p_dfu == NULL)
+		{
+			logger_error("Cannot allocate DFU state!");
+
+			return 1;
+		}
+	}
 
-	ping_id++;
+	p_dfu->ping_id++;
+	p_dfu->err_fatal = 0;
+	p_dfu->fw_offset = 0;
+	p_dfu->retry_cnt = 0;
+	p_dfu->retry_offset = 0;
 
-	err_code = dfu_serial_ping(p_uart, ping_id);
+	err_code = dfu_serial_ping(p_uart, p_dfu->ping_id);
 
 	if (!err_code)
 	{
-		err_code = dfu_serial_set_prn(p_uart, prn);
+		err_code = dfu_serial_set_prn(p_uart, p_dfu->prn);
 	}
 
 	if (!err_code)
 	{
-		err_code = dfu_serial_get_mtu(p_uart, &mtu);
+		err_code = dfu_serial_get_mtu(p_uart, &p_dfu->mtu);
+
+		// the MTU request times the target turnaround for the transfer plan,
+		// from the request sent to the arrival of the response
+		if (!err_code)
+			dfu_serial_set_turnaround(p_uart, p_uart->p_slip->rx_time_us - p_uart->p_slip->tx_time_us);
+	}
+
+	if (!err_code && p_uart->p_ProfileName != NULL)
+	{
+		dfu_serial_set_profile(p_uart);
+
+		if (p_dfu->prn)
+			err_code = dfu_serial_set_prn(p_uart, p_dfu->prn);
 	}
 
 	return err_code;
 }
 
+int dfu_serial_resync(uart_drv_t *p_uart)
+{
+	int err_code;
+	dfu_serial_t *p_dfu = p_uart->p_dfu;
+	uint64_t backoff_us;
+
+	if (p_dfu == NULL || p_dfu->err_fatal || (p_uart->p_cancel != NULL && *p_uart->p_cancel))
+		return 1;
+
+	// the retries are counted since the target last made progress
+	if (p_dfu->fw_offset > p_dfu->retry_offset)
+	{
+		p_dfu->retry_cnt = 0;
+		p_dfu->retry_offset = p_dfu->fw_offset;
+	}
+
+	if (++p_dfu->retry_cnt > RETRY_NUM_MAX)
+	{
+		logger_error("No progress after %u retries!", RETRY_NUM_MAX);
+
+		return 1;
+	}
+
+	backoff_us = (uint64_t)RETRY_BACKOFF_US << (p_dfu->retry_cnt - 1);
+
+	logger_info_1("Retrying in %u ms (%u/%u)...", (unsigned)(backoff_us / 1000), p_dfu->retry_cnt, RETRY_NUM_MAX);
+
+	uart_drv_sleep(p_uart, backoff_us);
+
+	// the responses still on their way are stale, a new ping id tells the fresh one
+	uart_slip_drain(p_uart);
+
+	p_dfu->ping_id++;
+
+	err_code = dfu_serial_ping(p_uart, p_dfu->ping_id);
+
+	// the target may have reset and lost its settings
+	if (!err_code)
+	{
+		err_code = dfu_serial_set_prn(p_uart, p_dfu->prn);
+	}
+
+	// the session may have failed before the MTU was known
+	if (!err_code && !p_dfu->mtu)
+	{
+		err_code = dfu_serial_get_mtu(p_uart, &p_dfu->mtu);
+	}
+
+	return err_code;
+}
+
+uint64_t dfu_serial_keepalive(uart_drv_t *p_uart)
+{
+	uint8_t send_data[2] = { NRF_DFU_OP_PING, 0 };
+	uint32_t timeout_ms;
+	uint64_t interval_us, idle_us;
+
+	if (p_uart->p_slip == NULL || !p_uart->keepalive_percent)
+		return 0;
+
+	// the continuation timeout is the shortest one
+	timeout_ms = p_uart->target_timeout_ms ? p_uart->target_timeout_ms : DFU_CONTINUATION_TIMEOUT_MS;
+	interval_us = (uint64_t)timeout_ms * 10 * p_uart->keepalive_percent;
+
+	idle_us = sys_time_us() - p_uart->p_slip->tx_time_us;
+
+	if (idle_us >= interval_us)
+	{
+		logger_info_2("Keepalive ping, link idle for %.1f s.", idle_us / 1000000.0);
+
+		// any response is dropped, the target may be resetting
+		if (!uart_slip_send(p_uart, send_data, sizeof(send_data)))
+			uart_slip_drain(p_uart);
+
+		idle_us = MIN(sys_time_us() - p_uart->p_slip->tx_time_us, interval_us - 1);
+	}
+
+	return interval_us - idle_us;
+}
+
+void dfu_serial_abort(uart_drv_t *p_uart)
+{
+	uint8_t send_data[1] = { NRF_DFU_OP_ABORT };
+
+	if (p_uart->p_dfu == NULL)
+		return;
+
+	logger_info_1("Aborting DFU...");
+
+	// the partial frame is ended and the responses pending are dropped first
+	uart_slip_drain(p_uart);
+
+	// the target resets on abort, it may not respond
+	if (!dfu_serial_send(p_uart, send_data, sizeof(send_data)))
+		uart_slip_drain(p_uart);
+}
+
 int dfu_serial_close(uart_drv_t *p_uart)
 {
+	if (p_uart->p_dfu != NULL)
+	{
+		free(p_uart->p_dfu);
+		p_uart->p_dfu = NULL;
+	}
+
 	return 0;
 }
 
-int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size)
+int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t data_crc)
 {
 	int err_code = 0;
 	uint32_t crc_32 = 0;
@@ -663,7 +1153,7 @@ int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint3
 
 	if (!err_code)
 	{
-		err_code = dfu_serial_try_to_recover_ip(p_uart, p_data, data_size, &rsp_recover, &rsp_select);
+		err_code = dfu_serial_try_to_recover_ip(p_uart, p_data, data_size, data_crc, &rsp_recover, &rsp_select);
 
 		if (!err_code && rsp_recover.offset == data_size)
 			return err_code;
@@ -675,6 +1165,7 @@ int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint3
 		{
 			logger_error("Init packet too big!");
 
+			p_uart->p_dfu->err_fatal = 1;
 			err_code = 1;
 		}
 	}
@@ -689,6 +1180,14 @@ int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint3
 		err_code = dfu_serial_stream_data_crc(p_uart, p_data, data_size, 0, &crc_32);
 	}
 
+	if (!err_code && crc_32 != data_crc)
+	{
+		logger_error("Init packet CRC does not match the package!");
+
+		p_uart->p_dfu->err_fatal = 1;
+		err_code = 1;
+	}
+
 	if (!err_code)
 	{
 		err_code = dfu_serial_execute_obj(p_uart);
@@ -697,7 +1196,7 @@ int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint3
 	return err_code;
 }
 
-int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size)
+int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t data_crc, dfu_plan_t *p_plan)
 {
 	int err_code = 0;
 	uint32_t max_size, stp_size, pos;
@@ -705,6 +1204,11 @@ int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t
 	nrf_dfu_response_select_t rsp_select;
 	nrf_dfu_response_select_t rsp_recover;
 	uint32_t pos_start;
+	dfu_plan_link_t link;
+	dfu_plan_t plan, done;
+	uint64_t time_us, elapsed_us;
+	uint64_t wire_bytes;
+	journal_t *p_journal = p_uart->p_journal;
 
 	logger_info_1("Sending firmware file...");
 
@@ -722,7 +1226,7 @@ int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t
 
 	if (!err_code)
 	{
-		err_code = dfu_serial_try_to_recover_fw(p_uart, p_data, data_size, &rsp_recover, &rsp_select);
+		err_code = dfu_serial_try_to_recover_fw(p_uart, p_data, data_size, data_crc, &rsp_recover, &rsp_select);
 	}
 
 	if (!err_code)
@@ -730,27 +1234,199 @@ int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t
 		max_size = rsp_select.max_size;
 
 		pos_start = rsp_recover.offset;
-		crc_32 = crc32_compute(p_data, pos_start, &crc_32);
+		crc_32 = rsp_recover.crc;
+
+		// the transfer follows the target, the journal only tells whether the target is the one it recorded
+		if (p_journal != NULL && p_journal->resuming && p_journal->resume_image == p_journal->image)
+		{
+			if (p_journal->resume_offset == pos_start && p_journal->resume_crc != crc_32)
+			{
+				logger_info_1("Target CRC 0x%08X differs from 0x%08X journaled at offset %u, the journal starts over.", crc_32, p_journal->resume_crc, pos_start);
+
+				journal_begin(p_journal);
+			}
+			else if (p_journal->resume_offset > pos_start)
+			{
+				logger_info_1("Target holds %u bytes of the %u journaled, the rest is sent again.", pos_start, p_journal->resume_offset);
+			}
+		}
+
+		// plan the transfer before sending the data, the escapes are counted exactly
+		link.frame_size = dfu_serial_frame_payload(p_uart);
+		link.object_size = max_size;
+		link.prn = p_uart->p_dfu->prn;
+		link.baud_rate = dfu_serial_baud_rate(p_uart);
+		link.turnaround_us = p_uart->p_dfu->turnaround_us;
+
+		memset(&plan, 0, sizeof(plan));
+		memset(&done, 0, sizeof(done));
+
+		if (link.frame_size && link.object_size)
+			dfu_plan_add(&link, p_data, pos_start, data_size - pos_start, crc_32, &plan);
+
+		logger_info_1("Plan: %u bytes in %u objects, %u frames, %u escapes, %llu bytes on the wire, %.2f s at %u bit/s.",
+			data_size - pos_start, plan.num_objects, plan.num_frames, plan.num_escapes,
+			(unsigned long long)(plan.tx_bytes + plan.rx_bytes), plan.time_us / 1000000.0, link.baud_rate);
+
+		time_us = sys_time_us();
+		wire_bytes = p_uart->stats.tx_bytes + UART_DRV_STATS_GET(p_uart->stats.rx_bytes);
+
+		p_uart->p_dfu->eta_us = plan.time_us;
+		p_uart->p_dfu->eta_time_us = time_us;
+
+		// the data already on the target counts as sent
+		if (p_uart->p_progress != NULL)
+			p_uart->p_progress(p_uart->p_progress_context, pos_start, data_size, plan.time_us);
+
+		p_uart->p_dfu->progress_size = data_size;
 
 		for (pos = pos_start; pos < data_size; pos += stp_size)
 		{
 			stp_size = MIN((data_size - pos), max_size);
 
+			// the prediction of the objects sent scales the prediction of the others
+			if (pos > pos_start)
+			{
+				elapsed_us = sys_time_us() - time_us;
+
+				p_uart->p_dfu->eta_us = (plan.time_us > done.time_us && done.time_us) ?
+					(plan.time_us - done.time_us) * elapsed_us / done.time_us : 0;
+				p_uart->p_dfu->eta_time_us = time_us + elapsed_us;
+
+				logger_info_1("Firmware: %u/%u bytes, %.1f s left.", pos, data_size, p_uart->p_dfu->eta_us / 1000000.0);
+			}
+
 			err_code = dfu_serial_create_obj(p_uart, 0x02, stp_size);
 
 			if (!err_code)
 			{
+				if (link.frame_size)
+					dfu_plan_add(&link, p_data, pos, stp_size, crc_32, &done);
+
 				err_code = dfu_serial_stream_data_crc(p_uart, p_data + pos, stp_size, pos, &crc_32);
 			}
 
+			// the running CRC checks the image against the package before the last object
+			if (!err_code && pos + stp_size == data_size && crc_32 != data_crc)
+			{
+				logger_error("Firmware CRC does not match the package!");
+
+				p_uart->p_dfu->err_fatal = 1;
+				err_code = 1;
+			}
+
 			if (!err_code)
 			{
 				err_code = dfu_serial_execute_obj(p_uart);
 			}
 
+			if (!err_code)
+			{
+				p_uart->p_dfu->fw_offset = pos + stp_size;
+
+				if (p_journal != NULL)
+					journal_object(p_journal, pos + stp_size, crc_32);
+			}
+
 			if (err_code)
 				break;
 		}
+
+		p_uart->p_dfu->progress_size = 0;
+
+		if (!err_code)
+		{
+			plan.actual_us = sys_time_us() - time_us;
+			plan.actual_bytes = p_uart->stats.tx_bytes + UART_DRV_STATS_GET(p_uart->stats.rx_bytes) - wire_bytes;
+
+			logger_info_1("Firmware sent in %.2f s, predicted %.2f s, %llu bytes on the wire, predicted %llu.",
+				plan.actual_us / 1000000.0, plan.time_us / 1000000.0,
+				(unsigned long long)plan.actual_bytes, (unsigned long long)(plan.tx_bytes + plan.rx_bytes));
+
+			if (p_uart->p_EtaLogName != NULL)
+				dfu_plan_log(p_uart->p_EtaLogName, p_uart->p_PortName, &link, &plan);
+		}
+
+		if (p_plan != NULL)
+			*p_plan = plan;
+	}
+
+	return err_code;
+}
+
+int dfu_serial_get_fw_version(uart_drv_t *p_uart, uint8_t image, dfu_fw_version_t *p_fw)
+{
+	int err_code;
+	uint32_t data_cnt;
+	uint8_t send_data[2] = { NRF_DFU_OP_FIRMWARE_VERSION };
+
+	send_data[1] = image;
+	err_code = dfu_serial_request(p_uart, send_data, sizeof(send_data), &data_cnt);
+
+	if (!err_code)
+	{
+		if (data_cnt == 16)
+		{
+			p_fw->type    = p_uart->p_dfu->receive_data[3];
+			p_fw->version = get_uint32_le(p_uart->p_dfu->receive_data + 4);
+			p_fw->addr    = get_uint32_le(p_uart->p_dfu->receive_data + 8);
+			p_fw->len     = get_uint32_le(p_uart->p_dfu->receive_data + 12);
+
+			logger_info_2("Firmware image %u: type:%u version:%u addr:0x%08X len:%u", image, p_fw->type, p_fw->version, p_fw->addr, p_fw->len);
+		}
+		else
+		{
+			logger_error("Invalid firmware version response!");
+
+			err_code = 1;
+		}
+	}
+
+	return err_code;
+}
+
+int dfu_serial_get_hw_version(uart_drv_t *p_uart, dfu_hw_version_t *p_hw)
+{
+	int err_code;
+	uint32_t data_cnt;
+	uint8_t send_data[1] = { NRF_DFU_OP_HARDWARE_VERSION };
+
+	err_code = dfu_serial_request(p_uart, send_data, sizeof(send_data), &data_cnt);
+
+	if (!err_code)
+	{
+		if (data_cnt == 23)
+		{
+			p_hw->part          = get_uint32_le(p_uart->p_dfu->receive_data + 3);
+			p_hw->variant       = get_uint32_le(p_uart->p_dfu->receive_data + 7);
+			p_hw->rom_size      = get_uint32_le(p_uart->p_dfu->receive_data + 11);
+			p_hw->ram_size      = get_uint32_le(p_uart->p_dfu->receive_data + 15);
+			p_hw->rom_page_size = get_uint32_le(p_uart->p_dfu->receive_data + 19);
+
+			logger_info_2("Hardware: part:0x%X variant:0x%08X rom:%u ram:%u page:%u", p_hw->part, p_hw->variant, p_hw->rom_size, p_hw->ram_size, p_hw->rom_page_size);
+		}
+		else
+		{
+			logger_error("Invalid hardware version response!");
+
+			err_code = 1;
+		}
+	}
+
+	return err_code;
+}
+
+int dfu_serial_get_init_packet(uart_drv_t *p_uart, uint32_t *p_offset, uint32_t *p_crc)
+{
+	int err_code;
+	nrf_dfu_response_select_t rsp_select;
+
+	err_code = dfu_serial_select_obj(p_uart, 0x01, &rsp_select);
+
+	if (!err_code)
+	{
+		*p_offset = rsp_select.offset;
+		*p_crc = rsp_select.crc;
 	}
 
 	return err_code;
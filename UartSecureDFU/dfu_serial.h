@@ -43,6 +43,7 @@
 #ifndef _INC_DFU_SERIAL
 #define _INC_DFU_SERIAL
 
+#include "dfu_plan.h"
 #include "uart_drv.h"
 #include "uart_slip.h"
 
@@ -51,13 +52,76 @@
 extern "C" {
 #endif  /* __cplusplus */
 
+// bootloader timeouts, from testing_package_sdk15.2/secure_bootloader/pca10040_uart/config/sdk_config.h:
+// the target waits this long for the next image once one is activated, and for the next request during a DFU
+#define DFU_CONTINUATION_TIMEOUT_MS     10000   // NRF_BL_DFU_CONTINUATION_TIMEOUT_MS
+#define DFU_INACTIVITY_TIMEOUT_MS       120000  // NRF_BL_DFU_INACTIVITY_TIMEOUT_MS
+
+// default share of the target timeout the link may stay idle, in percent
+#define DFU_KEEPALIVE_PERCENT_DEF       25
+
+/**
+* @brief Firmware type reported by @ref dfu_serial_get_fw_version.
+*/
+typedef enum
+{
+	DFU_FW_TYPE_SOFTDEVICE  = 0x00,
+	DFU_FW_TYPE_APPLICATION = 0x01,
+	DFU_FW_TYPE_BOOTLOADER  = 0x02,
+	DFU_FW_TYPE_UNKNOWN     = 0xFF
+} dfu_fw_type_t;
+
+/**
+* @brief Installed firmware image details.
+*/
+typedef struct
+{
+	uint8_t type;                       //!< Firmware type, see @ref dfu_fw_type_t.
+	uint32_t version;                   //!< Firmware version.
+	uint32_t addr;                      //!< Start address.
+	uint32_t len;                       //!< Image length.
+} dfu_fw_version_t;
+
+/**
+* @brief Hardware details.
+*/
+typedef struct
+{
+	uint32_t part;                      //!< Part, e.g. 0x52832.
+	uint32_t variant;                   //!< Part variant.
+	uint32_t rom_size;                  //!< Flash size.
+	uint32_t ram_size;                  //!< RAM size.
+	uint32_t rom_page_size;             //!< Flash page size.
+} dfu_hw_version_t;
+
 int dfu_serial_open(uart_drv_t *p_uart);
 
 int dfu_serial_close(uart_drv_t *p_uart);
 
-int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size);
+// after an error, back off and resynchronize with the target before the transfer is resumed;
+// fails if the error cannot clear, or after several retries in a row without progress
+int dfu_serial_resync(uart_drv_t *p_uart);
+
+// ping the target if the link has been idle too long, returns the time until the next ping is due,
+// 0 if there is no keepalive; the DFU session may be closed
+uint64_t dfu_serial_keepalive(uart_drv_t *p_uart);
+
+// stop the transfer in progress, the target resets instead of waiting for its inactivity timeout
+void dfu_serial_abort(uart_drv_t *p_uart);
+
+// data_crc is the CRC-32 of the whole data, as stored in the package
+int dfu_serial_send_init_packet(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t data_crc);
+
+// the transfer prediction, and the actual time once done, are kept in *p_plan if not NULL
+int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size, uint32_t data_crc, dfu_plan_t *p_plan);
+
+// read the details of an installed image, numbered from 0
+int dfu_serial_get_fw_version(uart_drv_t *p_uart, uint8_t image, dfu_fw_version_t *p_fw);
+
+int dfu_serial_get_hw_version(uart_drv_t *p_uart, dfu_hw_version_t *p_hw);
 
-int dfu_serial_send_firmware(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t data_size);
+// read the size and CRC of the init packet the target holds, without changing it
+int dfu_serial_get_init_packet(uart_drv_t *p_uart, uint32_t *p_offset, uint32_t *p_crc);
 
 #ifdef __cplusplus
 }   /* ... extern "C" */
@@ -0,0 +1,344 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+#include "fleet.h"
+#include "dfu.h"
+#include "uart_slip.h"
+#include "logging.h"
+#include "sys_time.h"
+
+// maximum length of a batch file line
+#define FLEET_LINE_MAX          512
+
+/**
+* @brief Package shared by the ports it is sent to.
+*/
+typedef struct fleet_pkg_s
+{
+	char *p_file;                       //!< Package file.
+	dfu_package_t *p_pkg;               //!< Package, images loaded, NULL if it cannot be loaded.
+	int refcnt;                         //!< Ports still using the package.
+	struct fleet_pkg_s *p_next;
+} fleet_pkg_t;
+
+/**
+* @brief Update of one port.
+*/
+typedef struct
+{
+	uart_drv_t uart;                    //!< Device port.
+	char *p_port;                       //!< Port name.
+	fleet_pkg_t *p_entry;               //!< Package to send.
+	int skip_installed;                 //!< Skip the images the target already runs.
+	int err_code;                       //!< Update result.
+	uint64_t time_us;                   //!< Update duration.
+#ifndef WIN32
+	pthread_t thread;
+	int started;                        //!< Session thread started.
+#endif
+} fleet_port_t;
+
+#ifndef WIN32
+static pthread_mutex_t fleet_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// get the entry of a package, adding it to the list, in batch file order, if it is not there yet
+static fleet_pkg_t *fleet_pkg_get(fleet_pkg_t **pp_pkgs, const char *p_file)
+{
+	fleet_pkg_t *p_entry;
+
+	for (; *pp_pkgs != NULL; pp_pkgs = &(*pp_pkgs)->p_next)
+	{
+		if (!strcmp((*pp_pkgs)->p_file, p_file))
+			break;
+	}
+
+	p_entry = *pp_pkgs;
+
+	if (p_entry == NULL)
+	{
+		p_entry = (fleet_pkg_t *)calloc(1, sizeof(fleet_pkg_t));
+
+		if (p_entry != NULL)
+		{
+			p_entry->p_file = (char *)malloc(strlen(p_file) + 1);
+
+			if (p_entry->p_file == NULL)
+			{
+				free(p_entry);
+
+				return NULL;
+			}
+
+			strcpy(p_entry->p_file, p_file);
+
+			*pp_pkgs = p_entry;
+		}
+	}
+
+	if (p_entry != NULL)
+		p_entry->refcnt++;
+
+	return p_entry;
+}
+
+// a port is done with its package, the images are freed with the last port
+static void fleet_pkg_release(fleet_pkg_t *p_entry)
+{
+	int refcnt;
+
+#ifndef WIN32
+	pthread_mutex_lock(&fleet_lock);
+#endif
+	refcnt = --p_entry->refcnt;
+#ifndef WIN32
+	pthread_mutex_unlock(&fleet_lock);
+#endif
+
+	if (!refcnt && p_entry->p_pkg != NULL)
+	{
+		dfu_package_free(p_entry->p_pkg);
+		p_entry->p_pkg = NULL;
+
+		logger_info_2("%s released.", p_entry->p_file);
+	}
+}
+
+// read the ports and their packages, the ports read are kept even on error
+static int fleet_parse(const char *p_batch_file, const char *p_pkg_file, fleet_port_t **pp_ports, int *p_num_ports, fleet_pkg_t **pp_pkgs)
+{
+	FILE *p_file;
+	char line[FLEET_LINE_MAX];
+	fleet_port_t *p_ports = NULL, *p_new;
+	int num_ports = 0, max_ports = 0;
+	int line_n = 0;
+	int err_code = 0;
+	char *p_port, *p_pkg, *p_end;
+
+	p_file = fopen(p_batch_file, "r");
+	if (p_file == NULL)
+	{
+		logger_error("Cannot open batch file %s!", p_batch_file);
+
+		return 1;
+	}
+
+	while (!err_code && fgets(line, sizeof(line), p_file) != NULL)
+	{
+		line_n++;
+
+		p_end = strchr(line, '#');
+		if (p_end != NULL)
+			*p_end = '\0';
+
+		p_port = strtok(line, " \t\r\n");
+		if (p_port == NULL)
+			continue;
+
+		p_pkg = strtok(NULL, " \t\r\n");
+		if (p_pkg == NULL)
+			p_pkg = (char *)p_pkg_file;
+
+		if (strtok(NULL, " \t\r\n") != NULL)
+		{
+			logger_error("%s:%d: a port and a package expected!", p_batch_file, line_n);
+
+			err_code = 1;
+			break;
+		}
+
+		if (num_ports >= max_ports)
+		{
+			max_ports = max_ports ? max_ports * 2 : 16;
+			p_new = (fleet_port_t *)realloc(p_ports, max_ports * sizeof(fleet_port_t));
+
+			if (p_new == NULL)
+			{
+				logger_error("Cannot allocate memory!");
+
+				err_code = 1;
+				break;
+			}
+
+			p_ports = p_new;
+		}
+
+		p_new = p_ports + num_ports;
+		memset(p_new, 0, sizeof(*p_new));
+
+		p_new->p_port = (char *)malloc(strlen(p_port) + 1);
+		if (p_new->p_port != NULL)
+		{
+			strcpy(p_new->p_port, p_port);
+			p_new->p_entry = fleet_pkg_get(pp_pkgs, p_pkg);
+		}
+
+		if (p_new->p_port == NULL || p_new->p_entry == NULL)
+		{
+			logger_error("Cannot allocate memory!");
+
+			free(p_new->p_port);
+
+			err_code = 1;
+			break;
+		}
+
+		num_ports++;
+	}
+
+	fclose(p_file);
+
+	*pp_ports = p_ports;
+	*p_num_ports = num_ports;
+
+	if (!err_code && !num_ports)
+	{
+		logger_error("No port in batch file %s!", p_batch_file);
+
+		err_code = 1;
+	}
+
+	return err_code;
+}
+
+static void *fleet_port_thread(void *p_context)
+{
+	fleet_port_t *p_port = (fleet_port_t *)p_context;
+	uint64_t time_us = sys_time_us();
+	int err_code = 1;
+
+	if (p_port->p_entry->p_pkg != NULL)
+		err_code = uart_slip_open(&p_port->uart);
+
+	if (!err_code)
+	{
+		err_code = dfu_send_loaded_package(&p_port->uart, p_port->p_entry->p_pkg, p_port->skip_installed, NULL);
+
+		uart_slip_close(&p_port->uart);
+	}
+
+	fleet_pkg_release(p_port->p_entry);
+
+	p_port->err_code = err_code;
+	p_port->time_us = sys_time_us() - time_us;
+
+	return NULL;
+}
+
+int fleet_run(const char *p_batch_file, const char *p_pkg_file, const uart_drv_t *p_uart_cfg, int skip_installed)
+{
+	int err_code;
+	fleet_port_t *p_ports = NULL;
+	fleet_pkg_t *p_pkgs = NULL, *p_entry;
+	int num_ports = 0, num_failed = 0;
+	int i;
+
+	err_code = fleet_parse(p_batch_file, p_pkg_file, &p_ports, &num_ports, &p_pkgs);
+
+	// each distinct package is decompressed once, a package that cannot be loaded fails its ports only
+	for (p_entry = p_pkgs; !err_code && p_entry != NULL; p_entry = p_entry->p_next)
+	{
+		logger_info_1("Loading %s (%d ports).", p_entry->p_file, p_entry->refcnt);
+
+		if (dfu_package_load(p_entry->p_file, &p_entry->p_pkg))
+			p_entry->p_pkg = NULL;
+	}
+
+	for (i = 0; !err_code && i < num_ports; i++)
+	{
+		fleet_port_t *p_port = p_ports + i;
+
+		p_port->uart = *p_uart_cfg;
+		p_port->uart.p_PortName = p_port->p_port;
+		// a session record is kept for a single port only
+		p_port->uart.p_RecordName = NULL;
+		p_port->skip_installed = skip_installed;
+
+		logger_info_1("Updating %s with %s.", p_port->p_port, p_port->p_entry->p_file);
+
+#ifndef WIN32
+		p_port->started = !pthread_create(&p_port->thread, NULL, fleet_port_thread, p_port);
+
+		if (!p_port->started)
+#endif
+		{
+			fleet_port_thread(p_port);
+		}
+	}
+
+	for (i = 0; !err_code && i < num_ports; i++)
+	{
+#ifndef WIN32
+		if (p_ports[i].started)
+			pthread_join(p_ports[i].thread, NULL);
+#endif
+		printf("%s %s: %s (%.1f s)\n", p_ports[i].p_port, p_ports[i].p_entry->p_file,
+			p_ports[i].err_code ? "FAIL" : "PASS", p_ports[i].time_us / 1000000.0);
+
+		if (p_ports[i].err_code)
+			num_failed++;
+	}
+
+	if (!err_code)
+		logger_info_1("%d devices updated, %d failed.", num_ports, num_failed);
+
+	for (i = 0; i < num_ports; i++)
+		free(p_ports[i].p_port);
+
+	free(p_ports);
+
+	while (p_pkgs != NULL)
+	{
+		p_entry = p_pkgs;
+		p_pkgs = p_entry->p_next;
+
+		// left loaded if no port could use it
+		dfu_package_free(p_entry->p_pkg);
+		free(p_entry->p_file);
+		free(p_entry);
+	}
+
+	return err_code || num_failed > 0;
+}
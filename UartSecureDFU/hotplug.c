@@ -0,0 +1,377 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hotplug.h"
+#include "logging.h"
+
+// maximum size of a netlink event
+#define HOTPLUG_MSG_SIZE        8192
+
+// maximum length of an event file line
+#define HOTPLUG_LINE_MAX        256
+
+#ifdef __linux__
+// netlink group of the events sent by udev, once the device node is ready
+#define UDEV_MONITOR_GROUP      2
+
+#define UDEV_MONITOR_MAGIC      0xfeedcafe
+
+/**
+* @brief Leading fields of the header of the udev netlink events.
+*/
+typedef struct
+{
+	char prefix[8];                     //!< "libudev".
+	uint32_t magic;                     //!< UDEV_MONITOR_MAGIC, network byte order.
+	uint32_t header_size;               //!< Header size.
+	uint32_t properties_off;            //!< Offset of the properties from the header.
+	uint32_t properties_len;            //!< Size of the properties.
+} udev_monitor_header_t;
+#endif
+
+static void copy_str(char *p_dst, size_t size, const char *p_src)
+{
+	strncpy(p_dst, p_src, size - 1);
+	p_dst[size - 1] = '\0';
+}
+
+#ifdef __linux__
+// fill an event from the KEY=value properties of a udev event, returns 0 for a TTY event
+static int hotplug_parse_props(const char *p_props, size_t len, hotplug_event_t *p_event)
+{
+	const char *p_prop = p_props;
+	const char *p_end = p_props + len;
+	int is_tty = 0, has_action = 0;
+
+	memset(p_event, 0, sizeof(*p_event));
+
+	while (p_prop < p_end)
+	{
+		size_t prop_len = strnlen(p_prop, p_end - p_prop);
+
+		if (p_prop + prop_len >= p_end)
+			break;
+
+		if (!strcmp(p_prop, "ACTION=add"))
+		{
+			p_event->action = HOTPLUG_ADD;
+			has_action = 1;
+		}
+		else if (!strcmp(p_prop, "ACTION=remove"))
+		{
+			p_event->action = HOTPLUG_REMOVE;
+			has_action = 1;
+		}
+		else if (!strcmp(p_prop, "SUBSYSTEM=tty"))
+			is_tty = 1;
+		else if (!strncmp(p_prop, "DEVNAME=", 8))
+			copy_str(p_event->dev_name, sizeof(p_event->dev_name), p_prop + 8);
+		else if (!strncmp(p_prop, "ID_VENDOR_ID=", 13))
+			p_event->vid = (uint16_t)strtoul(p_prop + 13, NULL, 16);
+		else if (!strncmp(p_prop, "ID_MODEL_ID=", 12))
+			p_event->pid = (uint16_t)strtoul(p_prop + 12, NULL, 16);
+		else if (!strncmp(p_prop, "ID_SERIAL_SHORT=", 16))
+			copy_str(p_event->serial, sizeof(p_event->serial), p_prop + 16);
+
+		p_prop += prop_len + 1;
+	}
+
+	return !(is_tty && has_action && p_event->dev_name[0]);
+}
+
+static int hotplug_netlink_next(hotplug_t *p_hotplug, hotplug_event_t *p_event)
+{
+	static char buf[HOTPLUG_MSG_SIZE];
+	char cred_buf[CMSG_SPACE(sizeof(struct ucred))];
+	const udev_monitor_header_t *p_hdr = (const udev_monitor_header_t *)buf;
+	struct sockaddr_nl addr;
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *p_cmsg;
+	const struct ucred *p_cred;
+	ssize_t len;
+
+	for (;;)
+	{
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf);
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cred_buf;
+		msg.msg_controllen = sizeof(cred_buf);
+
+		len = recvmsg(p_hotplug->sock, &msg, 0);
+
+		if (len < 0)
+		{
+			// a signal stops the wait for devices
+			if (errno == EINTR)
+				return 1;
+
+			logger_error("Cannot read hotplug events!");
+
+			return 1;
+		}
+
+		// only root may announce devices, as udev does
+		p_cmsg = CMSG_FIRSTHDR(&msg);
+		if (p_cmsg == NULL || p_cmsg->cmsg_level != SOL_SOCKET || p_cmsg->cmsg_type != SCM_CREDENTIALS)
+			continue;
+
+		p_cred = (const struct ucred *)CMSG_DATA(p_cmsg);
+		if (p_cred->uid != 0 || addr.nl_groups != UDEV_MONITOR_GROUP)
+			continue;
+
+		if ((size_t)len < sizeof(*p_hdr) || memcmp(p_hdr->prefix, "libudev", 8) ||
+			ntohl(p_hdr->magic) != UDEV_MONITOR_MAGIC)
+			continue;
+
+		if (p_hdr->properties_off > (size_t)len || p_hdr->properties_len > (size_t)len - p_hdr->properties_off)
+			continue;
+
+		if (!hotplug_parse_props(buf + p_hdr->properties_off, p_hdr->properties_len, p_event))
+			return 0;
+	}
+}
+#endif
+
+// read the next event of the event file
+static int hotplug_file_next(hotplug_t *p_hotplug, hotplug_event_t *p_event)
+{
+	char line[HOTPLUG_LINE_MAX];
+	char action[16];
+	unsigned int vid, pid;
+	int n;
+
+	while (fgets(line, sizeof(line), p_hotplug->p_file) != NULL)
+	{
+		memset(p_event, 0, sizeof(*p_event));
+		p_event->serial[0] = '\0';
+
+		n = sscanf(line, "%15s %63s %x:%x %63s", action, p_event->dev_name, &vid, &pid, p_event->serial);
+
+		if (n <= 0 || action[0] == '#')
+			continue;
+
+		if (!strcmp(action, "add") && n >= 4)
+		{
+			p_event->action = HOTPLUG_ADD;
+			p_event->vid = (uint16_t)vid;
+			p_event->pid = (uint16_t)pid;
+
+			return 0;
+		}
+		else if (!strcmp(action, "remove") && n >= 2)
+		{
+			p_event->action = HOTPLUG_REMOVE;
+
+			return 0;
+		}
+
+		logger_error("Invalid hotplug event: %s", line);
+	}
+
+	return 1;
+}
+
+int hotplug_open(hotplug_t *p_hotplug, const char *p_event_file)
+{
+	p_hotplug->sock = -1;
+	p_hotplug->p_file = NULL;
+
+	if (p_event_file != NULL)
+	{
+		p_hotplug->p_file = fopen(p_event_file, "r");
+
+		if (p_hotplug->p_file == NULL)
+		{
+			logger_error("Cannot open hotplug event file!");
+
+			return 1;
+		}
+
+		return 0;
+	}
+
+#ifdef __linux__
+	{
+		struct sockaddr_nl addr;
+		int on = 1;
+
+		p_hotplug->sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+
+		if (p_hotplug->sock < 0)
+		{
+			logger_error("Cannot open hotplug netlink socket!");
+
+			return 1;
+		}
+
+		memset(&addr, 0, sizeof(addr));
+		addr.nl_family = AF_NETLINK;
+		addr.nl_groups = UDEV_MONITOR_GROUP;
+
+		if (bind(p_hotplug->sock, (struct sockaddr *)&addr, sizeof(addr)) ||
+			setsockopt(p_hotplug->sock, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)))
+		{
+			logger_error("Cannot listen to hotplug events!");
+
+			close(p_hotplug->sock);
+			p_hotplug->sock = -1;
+
+			return 1;
+		}
+
+		return 0;
+	}
+#else
+	logger_error("Hotplug events are not supported, an event file is needed!");
+
+	return 1;
+#endif
+}
+
+void hotplug_close(hotplug_t *p_hotplug)
+{
+	if (p_hotplug->p_file != NULL)
+	{
+		fclose(p_hotplug->p_file);
+		p_hotplug->p_file = NULL;
+	}
+
+#ifdef __linux__
+	if (p_hotplug->sock >= 0)
+	{
+		close(p_hotplug->sock);
+		p_hotplug->sock = -1;
+	}
+#endif
+}
+
+int hotplug_next(hotplug_t *p_hotplug, hotplug_event_t *p_event)
+{
+	if (p_hotplug->p_file != NULL)
+		return hotplug_file_next(p_hotplug, p_event);
+
+#ifdef __linux__
+	if (p_hotplug->sock >= 0)
+		return hotplug_netlink_next(p_hotplug, p_event);
+#endif
+
+	return 1;
+}
+
+// parse a hexadecimal ID or '*', the end of the field is returned in *pp_end
+static int parse_id(const char *p_str, uint16_t *p_id, const char **pp_end)
+{
+	char *p_end;
+	unsigned long id;
+
+	if (*p_str == '*')
+	{
+		*p_id = 0;
+		*pp_end = p_str + 1;
+
+		return 0;
+	}
+
+	id = strtoul(p_str, &p_end, 16);
+
+	if (p_end == p_str || id == 0 || id > 0xFFFF)
+		return 1;
+
+	*p_id = (uint16_t)id;
+	*pp_end = p_end;
+
+	return 0;
+}
+
+int hotplug_parse_match(const char *p_str, hotplug_match_t *p_match)
+{
+	const char *p_end;
+
+	memset(p_match, 0, sizeof(*p_match));
+
+	if (parse_id(p_str, &p_match->vid, &p_end) || *p_end != ':' ||
+		parse_id(p_end + 1, &p_match->pid, &p_end) || (*p_end != ':' && *p_end != '\0'))
+	{
+		logger_error("Invalid device match: %s", p_str);
+
+		return 1;
+	}
+
+	if (*p_end == ':' && strcmp(p_end + 1, "*"))
+		copy_str(p_match->serial, sizeof(p_match->serial), p_end + 1);
+
+	return 0;
+}
+
+int hotplug_is_match(const hotplug_event_t *p_event, const hotplug_match_t *p_match, int num_match)
+{
+	int i;
+
+	// only USB devices are handled, not the virtual terminals
+	if (!p_event->vid)
+		return 0;
+
+	for (i = 0; i < num_match; i++, p_match++)
+	{
+		if ((!p_match->vid || p_match->vid == p_event->vid) &&
+			(!p_match->pid || p_match->pid == p_event->pid) &&
+			(!p_match->serial[0] || !strcmp(p_match->serial, p_event->serial)))
+			return 1;
+	}
+
+	return 0;
+}
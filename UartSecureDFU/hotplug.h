@@ -0,0 +1,119 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#pragma once
+ 
+#ifndef _INC_HOTPLUG
+#define _INC_HOTPLUG
+
+#include <stdio.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/*
+ * Hotplug events come from the udev netlink socket, or for testing from an
+ * event file (or FIFO) standing in for the hardware, one event per line:
+ *
+ *   add <device> <vid>:<pid> [<serial>]
+ *   remove <device>
+ *
+ * vid and pid are hexadecimal. Lines starting with '#' are comments.
+ */
+
+// maximum length of a device node name
+#define HOTPLUG_NAME_MAX        64
+
+// maximum length of a USB serial number
+#define HOTPLUG_SERIAL_MAX      64
+
+typedef enum
+{
+	HOTPLUG_ADD,
+	HOTPLUG_REMOVE
+} hotplug_action_t;
+
+typedef struct
+{
+	hotplug_action_t action;            //!< Device added or removed.
+	char dev_name[HOTPLUG_NAME_MAX];    //!< TTY device node.
+	uint16_t vid;                       //!< USB vendor ID, 0 if unknown.
+	uint16_t pid;                       //!< USB product ID, 0 if unknown.
+	char serial[HOTPLUG_SERIAL_MAX];    //!< USB serial number, empty if unknown.
+} hotplug_event_t;
+
+/**
+* @brief Devices to handle, a field set to 0 or empty matches any value.
+*/
+typedef struct
+{
+	uint16_t vid;                       //!< USB vendor ID.
+	uint16_t pid;                       //!< USB product ID.
+	char serial[HOTPLUG_SERIAL_MAX];    //!< USB serial number.
+} hotplug_match_t;
+
+typedef struct
+{
+	int sock;                           //!< Netlink socket, -1 if not used.
+	FILE *p_file;                       //!< Event file, NULL if not used.
+} hotplug_t;
+
+// listen to the TTY events of the system, or read them from p_event_file if not NULL
+int hotplug_open(hotplug_t *p_hotplug, const char *p_event_file);
+
+void hotplug_close(hotplug_t *p_hotplug);
+
+// wait for the next TTY event, returns 1 at the end of the event file or on error
+int hotplug_next(hotplug_t *p_hotplug, hotplug_event_t *p_event);
+
+// parse a match of the form <vid>:<pid>[:<serial>], '*' matching any value
+int hotplug_parse_match(const char *p_str, hotplug_match_t *p_match);
+
+// check whether a device added is matched by one of num_match matches
+int hotplug_is_match(const hotplug_event_t *p_event, const hotplug_match_t *p_match, int num_match);
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_HOTPLUG
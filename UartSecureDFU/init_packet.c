@@ -0,0 +1,239 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <string.h>
+#include "init_packet.h"
+
+// protobuf wire types
+#define PB_WT_VARINT            0
+#define PB_WT_64BIT             1
+#define PB_WT_LEN               2
+#define PB_WT_32BIT             5
+
+typedef struct
+{
+	const uint8_t *p_data;
+	uint32_t size;
+	uint32_t pos;
+} pb_reader_t;
+
+static int pb_read_varint(pb_reader_t *p_rd, uint32_t *p_value)
+{
+	uint32_t value = 0;
+	int shift = 0;
+
+	while (p_rd->pos < p_rd->size && shift < 64)
+	{
+		uint8_t byte = p_rd->p_data[p_rd->pos++];
+
+		if (shift < 32)
+			value |= (uint32_t)(byte & 0x7F) << shift;
+		shift += 7;
+
+		if (!(byte & 0x80))
+		{
+			*p_value = value;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// read the next field, a length delimited field is returned as a sub-reader
+static int pb_read_field(pb_reader_t *p_rd, uint32_t *p_field, uint32_t *p_value, pb_reader_t *p_sub)
+{
+	uint32_t key, len;
+
+	if (pb_read_varint(p_rd, &key))
+		return 1;
+
+	*p_field = key >> 3;
+
+	switch (key & 0x07)
+	{
+	case PB_WT_VARINT:
+		return pb_read_varint(p_rd, p_value);
+
+	case PB_WT_LEN:
+		if (pb_read_varint(p_rd, &len) || len > p_rd->size - p_rd->pos)
+			return 1;
+
+		p_sub->p_data = p_rd->p_data + p_rd->pos;
+		p_sub->size = len;
+		p_sub->pos = 0;
+		p_rd->pos += len;
+		return 0;
+
+	case PB_WT_64BIT:
+		len = 8;
+		break;
+
+	case PB_WT_32BIT:
+		len = 4;
+		break;
+
+	default:
+		return 1;
+	}
+
+	if (len > p_rd->size - p_rd->pos)
+		return 1;
+
+	p_rd->pos += len;
+
+	return 0;
+}
+
+static int parse_hash(pb_reader_t *p_rd, init_packet_t *p_init)
+{
+	uint32_t field, value;
+	pb_reader_t sub;
+
+	while (p_rd->pos < p_rd->size)
+	{
+		if (pb_read_field(p_rd, &field, &value, &sub))
+			return 1;
+
+		if (field == 1)
+		{
+			p_init->hash_type = value;
+		}
+		else if (field == 2)
+		{
+			p_init->hash_size = (sub.size < sizeof(p_init->hash)) ? sub.size : sizeof(p_init->hash);
+			memcpy(p_init->hash, sub.p_data, p_init->hash_size);
+		}
+	}
+
+	return 0;
+}
+
+static int parse_init(pb_reader_t *p_rd, init_packet_t *p_init)
+{
+	uint32_t field, value = 0;
+	pb_reader_t sub;
+
+	while (p_rd->pos < p_rd->size)
+	{
+		if (pb_read_field(p_rd, &field, &value, &sub))
+			return 1;
+
+		switch (field)
+		{
+		case 1: p_init->fw_version = value; break;
+		case 2: p_init->hw_version = value; break;
+		case 4: p_init->type = value; break;
+		case 5: p_init->sd_size = value; break;
+		case 6: p_init->bl_size = value; break;
+		case 7: p_init->app_size = value; break;
+		case 8:
+			if (parse_hash(&sub, p_init))
+				return 1;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return 0;
+}
+
+// Command: op_code = 1, init = 2
+static int parse_command(pb_reader_t *p_rd, init_packet_t *p_init)
+{
+	uint32_t field, value;
+	pb_reader_t sub;
+	int found = 0;
+
+	while (p_rd->pos < p_rd->size)
+	{
+		if (pb_read_field(p_rd, &field, &value, &sub))
+			return 1;
+
+		if (field == 2)
+		{
+			if (parse_init(&sub, p_init))
+				return 1;
+
+			found = 1;
+		}
+	}
+
+	return !found;
+}
+
+int init_packet_parse(const uint8_t *p_data, uint32_t data_size, init_packet_t *p_init)
+{
+	pb_reader_t rd, sub, sub2;
+	uint32_t field, value;
+	int err_code = 1;
+
+	memset(p_init, 0, sizeof(*p_init));
+
+	rd.p_data = p_data;
+	rd.size = data_size;
+	rd.pos = 0;
+
+	// Packet: command = 1, signed_command = 2 (SignedCommand: command = 1)
+	while (rd.pos < rd.size)
+	{
+		if (pb_read_field(&rd, &field, &value, &sub))
+			return 1;
+
+		if (field == 1)
+		{
+			err_code = parse_command(&sub, p_init);
+		}
+		else if (field == 2)
+		{
+			while (sub.pos < sub.size)
+			{
+				if (pb_read_field(&sub, &field, &value, &sub2))
+					return 1;
+
+				if (field == 1)
+					err_code = parse_command(&sub2, p_init);
+			}
+		}
+	}
+
+	return err_code;
+}
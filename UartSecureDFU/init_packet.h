@@ -0,0 +1,91 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#pragma once
+ 
+#ifndef _INC_INIT_PACKET
+#define _INC_INIT_PACKET
+
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+
+#define INIT_PACKET_HASH_SIZE_MAX   32
+
+/**
+* @brief Firmware type of an init packet (dfu-cc.proto FwType).
+*/
+typedef enum
+{
+	INIT_PACKET_FW_APPLICATION = 0,
+	INIT_PACKET_FW_SOFTDEVICE = 1,
+	INIT_PACKET_FW_BOOTLOADER = 2,
+	INIT_PACKET_FW_SOFTDEVICE_BOOTLOADER = 3
+} init_packet_fw_type_t;
+
+/**
+* @brief Fields of an init command (dfu-cc.proto InitCommand) used by the host.
+*/
+typedef struct
+{
+	uint32_t fw_version;                //!< Firmware version.
+	uint32_t hw_version;                //!< Hardware version.
+	uint32_t type;                      //!< Firmware type.
+	uint32_t sd_size;                   //!< SoftDevice size.
+	uint32_t bl_size;                   //!< Bootloader size.
+	uint32_t app_size;                  //!< Application size.
+	uint32_t hash_type;                 //!< Firmware hash type.
+	uint8_t hash[INIT_PACKET_HASH_SIZE_MAX];    //!< Firmware hash.
+	uint32_t hash_size;                 //!< Firmware hash size.
+} init_packet_t;
+
+// parse a signed or unsigned init packet (DAT file)
+int init_packet_parse(const uint8_t *p_data, uint32_t data_size, init_packet_t *p_init);
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_INIT_PACKET
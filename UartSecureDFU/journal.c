@@ -0,0 +1,239 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "journal.h"
+#include "crc32.h"
+#include "logging.h"
+
+// maximum length of a journal line
+#define JOURNAL_LINE_MAX        160
+
+// check the CRC of a record, and strip it, returns 0 if the record is whole
+static int journal_check(char *p_line)
+{
+	char *p_crc;
+	unsigned crc;
+
+	p_crc = strrchr(p_line, '*');
+	if (p_crc == NULL || p_crc == p_line || *(p_crc - 1) != ' ')
+		return 1;
+
+	if (sscanf(p_crc + 1, "%8x", &crc) != 1)
+		return 1;
+
+	if (crc32_compute((const uint8_t *)p_line, (uint32_t)(p_crc - 1 - p_line), NULL) != crc)
+		return 1;
+
+	*(p_crc - 1) = '\0';
+
+	return 0;
+}
+
+// replay the records of the key and package
+static void journal_load(journal_t *p_journal)
+{
+	char line[JOURNAL_LINE_MAX];
+	char key[JOURNAL_KEY_MAX];
+	char record[16];
+	unsigned pkg_hash;
+	int image, n;
+	unsigned offset, crc;
+
+	rewind(p_journal->p_file);
+
+	while (fgets(line, sizeof(line), p_journal->p_file) != NULL)
+	{
+		if (journal_check(line))
+			continue;
+
+		if (sscanf(line, "%63s %8x %15s%n", key, &pkg_hash, record, &n) != 3)
+			continue;
+
+		if (strcmp(key, p_journal->key) || pkg_hash != p_journal->pkg_hash)
+			continue;
+
+		if (!strcmp(record, "begin"))
+		{
+			p_journal->resuming = 1;
+			p_journal->resume_image = 0;
+			p_journal->resume_offset = 0;
+			p_journal->resume_crc = 0;
+		}
+		else if (!strcmp(record, "object"))
+		{
+			if (sscanf(line + n, "%d %u %x", &image, &offset, &crc) == 3 &&
+				image == p_journal->resume_image)
+			{
+				p_journal->resume_offset = offset;
+				p_journal->resume_crc = crc;
+			}
+		}
+		else if (!strcmp(record, "image"))
+		{
+			if (sscanf(line + n, "%d", &image) == 1 &&
+				image == p_journal->resume_image)
+			{
+				p_journal->resume_image = image + 1;
+				p_journal->resume_offset = 0;
+				p_journal->resume_crc = 0;
+			}
+		}
+		else if (!strcmp(record, "done"))
+		{
+			p_journal->resuming = 0;
+		}
+	}
+}
+
+// append a record, it is on the disk on return
+static int journal_write(journal_t *p_journal, const char *p_record)
+{
+	int err_code = 0;
+	char line[JOURNAL_LINE_MAX];
+	int len;
+
+	len = snprintf(line, sizeof(line), "%s %08X %s", p_journal->key, p_journal->pkg_hash, p_record);
+	if (len < 0 || len >= (int)sizeof(line) - 12)
+		return 1;
+
+	len += snprintf(line + len, sizeof(line) - len, " *%08X\n", crc32_compute((const uint8_t *)line, (uint32_t)len, NULL));
+
+	// one write per record, records from concurrent sessions do not interleave
+	if (fwrite(line, 1, len, p_journal->p_file) != (size_t)len || fflush(p_journal->p_file))
+		err_code = 1;
+
+#ifdef WIN32
+	if (!err_code && _commit(_fileno(p_journal->p_file)))
+		err_code = 1;
+#else
+	if (!err_code && fsync(fileno(p_journal->p_file)))
+		err_code = 1;
+#endif
+
+	if (err_code)
+		logger_error("Cannot write transfer journal!");
+
+	return err_code;
+}
+
+int journal_open(journal_t *p_journal, const char *p_file, const char *p_key, uint32_t pkg_hash)
+{
+	int ch;
+
+	memset(p_journal, 0, sizeof(journal_t));
+
+	strncpy(p_journal->key, p_key, sizeof(p_journal->key) - 1);
+	p_journal->pkg_hash = pkg_hash;
+
+	p_journal->p_file = fopen(p_file, "a+b");
+	if (p_journal->p_file == NULL)
+	{
+		logger_error("Cannot open transfer journal!");
+
+		return 1;
+	}
+
+	// a record fits in the buffer and goes out in one write
+	setvbuf(p_journal->p_file, NULL, _IOFBF, JOURNAL_LINE_MAX);
+
+	journal_load(p_journal);
+
+	// a record torn by a crash is terminated, the next record starts on its own line
+	if (fseek(p_journal->p_file, -1, SEEK_END) == 0)
+	{
+		ch = fgetc(p_journal->p_file);
+
+		fseek(p_journal->p_file, 0, SEEK_END);
+
+		if (ch != '\n' && ch != EOF)
+			fputc('\n', p_journal->p_file);
+	}
+
+	return 0;
+}
+
+void journal_close(journal_t *p_journal)
+{
+	if (p_journal->p_file != NULL)
+	{
+		fclose(p_journal->p_file);
+		p_journal->p_file = NULL;
+	}
+}
+
+int journal_begin(journal_t *p_journal)
+{
+	p_journal->resuming = 0;
+	p_journal->resume_image = 0;
+	p_journal->resume_offset = 0;
+	p_journal->resume_crc = 0;
+
+	return journal_write(p_journal, "begin");
+}
+
+int journal_object(journal_t *p_journal, uint32_t offset, uint32_t crc)
+{
+	char record[48];
+
+	snprintf(record, sizeof(record), "object %d %u %08X", p_journal->image, offset, crc);
+
+	return journal_write(p_journal, record);
+}
+
+int journal_image(journal_t *p_journal)
+{
+	char record[24];
+
+	snprintf(record, sizeof(record), "image %d", p_journal->image);
+
+	return journal_write(p_journal, record);
+}
+
+int journal_done(journal_t *p_journal)
+{
+	return journal_write(p_journal, "done");
+}
@@ -0,0 +1,111 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#pragma once
+ 
+#ifndef _INC_JOURNAL
+#define _INC_JOURNAL
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/*
+ * Transfer journal, one record per line, appended and synced to disk as the
+ * transfer goes:
+ *
+ *   <key> <package> begin *<crc>
+ *   <key> <package> object <image> <offset> <fw_crc> *<crc>
+ *   <key> <package> image <image> *<crc>
+ *   <key> <package> done *<crc>
+ *
+ * key is the USB serial number of the device, a port without one is not
+ * journaled; package identifies the package content. object is written once a
+ * firmware object is executed, image once an image is complete. crc is the
+ * CRC-32 of the record, a record torn by a crash is ignored. The journal
+ * grows by one line per object sent, it may be deleted when no transfer is
+ * in progress.
+ */
+
+// maximum length of a journal key
+#define JOURNAL_KEY_MAX         64
+
+/**
+* @brief Journal of the transfers of a package to a device.
+*/
+typedef struct journal_s
+{
+	FILE *p_file;                       //!< Journal file, opened for appending.
+	char key[JOURNAL_KEY_MAX];          //!< Device key.
+	uint32_t pkg_hash;                  //!< Package identity.
+	int image;                          //!< Image being sent.
+
+	int resuming;                       //!< The last transfer did not complete.
+	int resume_image;                   //!< First image not complete.
+	uint32_t resume_offset;             //!< Firmware offset executed last in that image.
+	uint32_t resume_crc;                //!< Firmware CRC-32 at that offset.
+} journal_t;
+
+// open the journal and find where the last transfer of the package to the device stopped
+int journal_open(journal_t *p_journal, const char *p_file, const char *p_key, uint32_t pkg_hash);
+
+void journal_close(journal_t *p_journal);
+
+// a new transfer of the package starts
+int journal_begin(journal_t *p_journal);
+
+// a firmware object of the current image is executed, the image is complete up to offset
+int journal_object(journal_t *p_journal, uint32_t offset, uint32_t crc);
+
+// the current image is complete
+int journal_image(journal_t *p_journal);
+
+// the package is complete
+int journal_done(journal_t *p_journal);
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_JOURNAL
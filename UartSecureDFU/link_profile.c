@@ -0,0 +1,222 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
+#include "link_profile.h"
+#include "logging.h"
+
+// maximum length of a profile file line
+#define LINK_PROFILE_LINE_MAX   128
+
+// parse a profile line, returns 0 if it holds a profile
+static int link_profile_parse(const char *p_line, char *p_key, link_profile_t *p_profile)
+{
+	unsigned frame_size, prn;
+
+	if (p_line[0] == '#')
+		return 1;
+
+	if (sscanf(p_line, "%63s %u %u", p_key, &frame_size, &prn) != 3)
+		return 1;
+
+	p_profile->frame_size = frame_size;
+	p_profile->prn = prn;
+
+	return 0;
+}
+
+#ifndef WIN32
+// lock the profile file, the lock is taken again if the file was replaced while waiting for it
+static int link_profile_lock(const char *p_file)
+{
+	struct stat st_fd, st_path;
+	int fd;
+
+	for (;;)
+	{
+		fd = open(p_file, O_RDONLY | O_CREAT, 0644);
+		if (fd < 0)
+			return -1;
+
+		if (flock(fd, LOCK_EX))
+		{
+			close(fd);
+
+			return -1;
+		}
+
+		if (!fstat(fd, &st_fd) && !stat(p_file, &st_path) &&
+			st_fd.st_dev == st_path.st_dev && st_fd.st_ino == st_path.st_ino)
+			return fd;
+
+		close(fd);
+	}
+}
+#endif
+
+int link_profile_load(const char *p_file, const char *p_key, link_profile_t *p_profile)
+{
+	int err_code = 1;
+	FILE *p_in;
+	char line[LINK_PROFILE_LINE_MAX];
+	char key[LINK_PROFILE_KEY_MAX];
+	link_profile_t profile;
+
+	p_in = fopen(p_file, "r");
+	if (p_in == NULL)
+		return 1;
+
+	while (fgets(line, sizeof(line), p_in) != NULL)
+	{
+		if (!link_profile_parse(line, key, &profile) && !strcmp(key, p_key))
+		{
+			*p_profile = profile;
+
+			err_code = 0;
+		}
+	}
+
+	fclose(p_in);
+
+	return err_code;
+}
+
+int link_profile_save(const char *p_file, const char *p_key, const link_profile_t *p_profile)
+{
+	int err_code = 0;
+	FILE *p_in, *p_out = NULL;
+	char tmp_file[FILENAME_MAX];
+	char line[LINK_PROFILE_LINE_MAX];
+	char key[LINK_PROFILE_KEY_MAX];
+	link_profile_t profile;
+#ifndef WIN32
+	struct stat st;
+	int lock_fd, tmp_fd;
+#endif
+
+	// the file is rewritten aside and renamed, the other profiles are kept
+#ifdef WIN32
+	snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", p_file);
+
+	p_out = fopen(tmp_file, "w");
+#else
+	// the processes saving a profile take turns, each one rewrites the file from the last version
+	lock_fd = link_profile_lock(p_file);
+	if (lock_fd < 0)
+	{
+		logger_error("Cannot lock link profile file!");
+
+		return 1;
+	}
+
+	snprintf(tmp_file, sizeof(tmp_file), "%s.XXXXXX", p_file);
+
+	tmp_fd = mkstemp(tmp_file);
+	if (tmp_fd >= 0)
+	{
+		// the file keeps its permissions rather than those of a temporary file
+		if (!fstat(lock_fd, &st))
+			fchmod(tmp_fd, st.st_mode & 0777);
+
+		p_out = fdopen(tmp_fd, "w");
+		if (p_out == NULL)
+		{
+			close(tmp_fd);
+			remove(tmp_file);
+		}
+	}
+#endif
+	if (p_out == NULL)
+	{
+		logger_error("Cannot create link profile file!");
+#ifndef WIN32
+		close(lock_fd);
+#endif
+
+		return 1;
+	}
+
+	fprintf(p_out, "# UartSecureDFU link profiles: <key> <frame_size> <prn>\n");
+
+	p_in = fopen(p_file, "r");
+	if (p_in != NULL)
+	{
+		while (fgets(line, sizeof(line), p_in) != NULL)
+		{
+			if (!link_profile_parse(line, key, &profile) && strcmp(key, p_key))
+				fprintf(p_out, "%s %u %u\n", key, profile.frame_size, profile.prn);
+		}
+
+		fclose(p_in);
+	}
+
+	fprintf(p_out, "%s %u %u\n", p_key, p_profile->frame_size, p_profile->prn);
+
+	if (fclose(p_out))
+		err_code = 1;
+
+#ifdef WIN32
+	remove(p_file);
+#endif
+	if (!err_code && rename(tmp_file, p_file))
+		err_code = 1;
+
+	if (err_code)
+	{
+		logger_error("Cannot write link profile file!");
+
+		remove(tmp_file);
+	}
+
+#ifndef WIN32
+	// the lock goes with the file replaced
+	close(lock_fd);
+#endif
+
+	return err_code;
+}
@@ -50,7 +50,7 @@ void logger_error(const char* format, ...)
     va_start(argptr, format);
     vfprintf(stderr, format, argptr);
     va_end(argptr);
-	putchar('\n');
+	fputc('\n', stderr);
 }
 
 void logger_info(const char* format, va_list arg_list)
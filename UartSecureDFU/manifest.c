@@ -0,0 +1,236 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "manifest.h"
+#include "jsmn.h"
+#include "logging.h"
+
+/**
+* @brief Bump allocator, freed in one call.
+*/
+typedef struct
+{
+	char *p_base;                       //!< Allocation.
+	size_t size;                        //!< Allocation size.
+	size_t used;                        //!< Bytes handed out.
+} manifest_arena_t;
+
+static void *manifest_arena_alloc(manifest_arena_t *p_arena, size_t size)
+{
+	void *p_data;
+
+	// keep the blocks aligned for any member type
+	size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+	if (size > p_arena->size - p_arena->used)
+		return NULL;
+
+	p_data = p_arena->p_base + p_arena->used;
+	p_arena->used += size;
+
+	return p_data;
+}
+
+// index of the token following the value at i and all its children
+static int manifest_skip(const jsmntok_t *p_tokens, int num_tokens, int i)
+{
+	int pending = 1;
+
+	while (pending > 0 && i < num_tokens)
+	{
+		pending += p_tokens[i].size - 1;
+		i++;
+	}
+
+	return i;
+}
+
+// index of the value of a key in the object at obj, -1 if missing
+static int manifest_find(const jsmntok_t *p_tokens, int num_tokens, int obj, const char *p_json, const char *p_key)
+{
+	int i = obj + 1;
+	int k;
+
+	for (k = 0; k < p_tokens[obj].size && i + 1 < num_tokens; k++)
+	{
+		if (p_tokens[i].type == JSMN_STRING && !strcmp(p_json + p_tokens[i].start, p_key))
+			return i + 1;
+
+		i = manifest_skip(p_tokens, num_tokens, i + 1);
+	}
+
+	return -1;
+}
+
+// the string value of a key in the object at obj, NULL if missing
+static const char *manifest_find_str(const jsmntok_t *p_tokens, int num_tokens, int obj, const char *p_json, const char *p_key)
+{
+	int i = manifest_find(p_tokens, num_tokens, obj, p_json, p_key);
+
+	if (i < 0 || p_tokens[i].type != JSMN_STRING)
+		return NULL;
+
+	return p_json + p_tokens[i].start;
+}
+
+int manifest_parse(manifest_t *p_mft, char *p_json, size_t len)
+{
+	int err_code = 0;
+	jsmn_parser parser;
+	jsmntok_t *p_tokens = NULL;
+	manifest_arena_t arena;
+	int num_tokens;
+	int mft, i, k;
+
+	memset(p_mft, 0, sizeof(*p_mft));
+
+	// count the tokens first, the arena holds them and the images exactly
+	jsmn_init(&parser);
+
+	num_tokens = jsmn_parse(&parser, p_json, len, NULL, 0);
+
+	if (num_tokens <= 0)
+	{
+		logger_error("Cannot parse package manifest json (%d)!", num_tokens);
+
+		return 1;
+	}
+
+	// an image takes 2 tokens at least, its key and its object
+	arena.size = (size_t)num_tokens * sizeof(jsmntok_t) + (size_t)(num_tokens / 2) * sizeof(manifest_image_t) + 2 * sizeof(void *);
+	arena.used = 0;
+	arena.p_base = (char *)malloc(arena.size);
+
+	if (arena.p_base == NULL)
+	{
+		logger_error("Cannot allocate package manifest!");
+
+		return 1;
+	}
+
+	p_mft->p_arena = arena.p_base;
+	p_tokens = (jsmntok_t *)manifest_arena_alloc(&arena, (size_t)num_tokens * sizeof(jsmntok_t));
+	p_mft->p_images = (manifest_image_t *)manifest_arena_alloc(&arena, (size_t)(num_tokens / 2) * sizeof(manifest_image_t));
+
+	jsmn_init(&parser);
+
+	i = jsmn_parse(&parser, p_json, len, p_tokens, num_tokens);
+
+	if (i != num_tokens)
+	{
+		logger_error("Cannot parse package manifest json (%d)!", i);
+
+		err_code = 1;
+	}
+
+	if (!err_code)
+	{
+		// the strings end where their closing quote is
+		for (i = 0; i < num_tokens; i++)
+		{
+			if (p_tokens[i].type == JSMN_STRING)
+				p_json[p_tokens[i].end] = '\0';
+		}
+
+		mft = p_tokens[0].type == JSMN_OBJECT ? manifest_find(p_tokens, num_tokens, 0, p_json, "manifest") : -1;
+
+		if (mft < 0 || p_tokens[mft].type != JSMN_OBJECT)
+		{
+			logger_error("Cannot get json manifest object!");
+
+			err_code = 1;
+		}
+	}
+
+	if (!err_code)
+	{
+		i = mft + 1;
+
+		for (k = 0; !err_code && k < p_tokens[mft].size && i + 1 < num_tokens; k++)
+		{
+			int obj = i + 1;
+
+			// an image is an object with the files, the other values are metadata
+			if (p_tokens[obj].type == JSMN_OBJECT)
+			{
+				manifest_image_t *p_img = p_mft->p_images + p_mft->num_images;
+
+				p_img->p_name = p_json + p_tokens[i].start;
+				p_img->p_bin_file = manifest_find_str(p_tokens, num_tokens, obj, p_json, "bin_file");
+				p_img->p_dat_file = manifest_find_str(p_tokens, num_tokens, obj, p_json, "dat_file");
+
+				if (p_img->p_bin_file == NULL || p_img->p_dat_file == NULL)
+				{
+					logger_error("No BIN or DAT file for %s image in json manifest!", p_img->p_name);
+
+					err_code = 1;
+				}
+				else
+				{
+					p_mft->num_images++;
+				}
+			}
+
+			i = manifest_skip(p_tokens, num_tokens, obj);
+		}
+
+		if (!err_code && !p_mft->num_images)
+		{
+			logger_error("No DFU image in json manifest!");
+
+			err_code = 1;
+		}
+	}
+
+	if (err_code)
+		manifest_free(p_mft);
+
+	return err_code;
+}
+
+void manifest_free(manifest_t *p_mft)
+{
+	free(p_mft->p_arena);
+
+	p_mft->p_arena = NULL;
+	p_mft->p_images = NULL;
+	p_mft->num_images = 0;
+}
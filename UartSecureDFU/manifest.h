@@ -0,0 +1,93 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#pragma once
+ 
+#ifndef _INC_MANIFEST
+#define _INC_MANIFEST
+
+#include <stddef.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/*
+ * DFU package manifest:
+ *
+ *   { "manifest": { "<image>": { "bin_file": "...", "dat_file": "...", ... }, ... }, ... }
+ *
+ * The keys may come in any order, the other keys and their values are
+ * skipped. The strings are views into the manifest buffer, terminated in
+ * place, and the parsed data is backed by one allocation.
+ */
+
+/**
+* @brief Image of a package manifest.
+*/
+typedef struct
+{
+	const char *p_name;                 //!< Image key, "application", "bootloader", etc.
+	const char *p_bin_file;             //!< BIN file name.
+	const char *p_dat_file;             //!< DAT file name.
+} manifest_image_t;
+
+/**
+* @brief Parsed package manifest.
+*/
+typedef struct
+{
+	manifest_image_t *p_images;         //!< Images, in manifest order.
+	int num_images;                     //!< Number of images.
+	void *p_arena;                      //!< Allocation backing the parsed data.
+} manifest_t;
+
+// parse the manifest in p_json, its strings are terminated in place and must outlive the manifest
+int manifest_parse(manifest_t *p_mft, char *p_json, size_t len);
+
+// free the parsed data at once
+void manifest_free(manifest_t *p_mft);
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_MANIFEST
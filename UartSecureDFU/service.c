@@ -0,0 +1,828 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "service.h"
+#include "logging.h"
+
+#ifdef WIN32
+
+int service_run(const char *p_sock_path, const char *p_pkg_file, const uart_drv_t *p_uart_cfg, int max_jobs)
+{
+	logger_error("Service mode is not supported!");
+
+	return 1;
+}
+
+#else
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "dfu.h"
+#include "jsmn.h"
+#include "sys_time.h"
+#include "uart_slip.h"
+
+// maximum length of a request
+#define SERVICE_LINE_MAX        (PATH_MAX + 256)
+
+// maximum number of JSON tokens of a request
+#define SERVICE_TOKEN_NUM_MAX   16
+
+// maximum length of an event
+#define SERVICE_EVENT_MAX       256
+
+// maximum length of a port name
+#define SERVICE_PORT_NAME_MAX   128
+
+// number of packages kept decompressed
+#define SERVICE_CACHE_MAX       4
+
+// firmware bytes between two progress events
+#define SERVICE_PROGRESS_STEP   4096
+
+typedef struct
+{
+	int fd;                             //!< Client socket.
+	int refcnt;                         //!< Reader and pending jobs, under the service lock.
+	pthread_mutex_t write_lock;         //!< Keeps the events whole.
+} service_conn_t;
+
+typedef struct service_pkg_s
+{
+	char path[PATH_MAX];                //!< Package file.
+	time_t mtime;                       //!< Package file time when loaded.
+	off_t size;                         //!< Package file size when loaded.
+	dfu_package_t *p_pkg;               //!< Package, images loaded.
+	int refcnt;                         //!< Jobs using the package.
+	int stale;                          //!< Package file changed, dropped once unused.
+	uint64_t last_use;                  //!< Time of the last job, to drop the oldest package.
+	struct service_pkg_s *p_next;
+} service_pkg_t;
+
+typedef struct service_port_s
+{
+	char name[SERVICE_PORT_NAME_MAX];   //!< Port name.
+	uart_drv_t uart;                    //!< Port, kept open between the jobs.
+	int open;                           //!< Port is open.
+	int busy;                           //!< A job runs on the port.
+	struct service_port_s *p_next;
+} service_port_t;
+
+typedef enum
+{
+	SERVICE_OP_FLASH,
+	SERVICE_OP_VERIFY
+} service_op_t;
+
+typedef struct service_job_s
+{
+	uint32_t id;                        //!< Job number, in events.
+	service_op_t op;                    //!< Operation.
+	char port[SERVICE_PORT_NAME_MAX];   //!< Port name.
+	char package[PATH_MAX];             //!< Package file.
+	int skip_installed;                 //!< Skip the images the target already runs.
+	service_conn_t *p_conn;             //!< Client, to send the events to.
+	service_port_t *p_port;             //!< Port, once the job is started.
+	uint32_t progress_offset;           //!< Firmware offset of the last progress event.
+	struct service_job_s *p_next;
+} service_job_t;
+
+typedef struct
+{
+	const uart_drv_t *p_uart_cfg;       //!< Port settings.
+	const char *p_pkg_file;             //!< Default package.
+	pthread_mutex_t lock;
+	pthread_cond_t cond;                //!< Job queued or port released.
+	service_job_t *p_jobs;              //!< Jobs queued, oldest first.
+	service_pkg_t *p_pkgs;              //!< Packages loaded.
+	int num_pkgs;                       //!< Number of packages loaded.
+	service_port_t *p_ports;            //!< Ports used.
+	uint32_t job_id;                    //!< Last job number.
+	int stopping;                       //!< No more jobs are started.
+} service_t;
+
+static service_t m_service =
+{
+	NULL, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+
+// send an event to a client, a client gone is ignored
+static void service_send(service_conn_t *p_conn, const char *format, ...)
+{
+	char buf[SERVICE_EVENT_MAX];
+	va_list argptr;
+	int len, pos;
+	ssize_t n;
+
+	va_start(argptr, format);
+	len = vsnprintf(buf, sizeof(buf) - 1, format, argptr);
+	va_end(argptr);
+
+	if (len < 0)
+		return;
+
+	if (len > (int)sizeof(buf) - 2)
+		len = sizeof(buf) - 2;
+	buf[len++] = '\n';
+
+	pthread_mutex_lock(&p_conn->write_lock);
+
+	for (pos = 0; pos < len; pos += n)
+	{
+		n = send(p_conn->fd, buf + pos, len - pos, MSG_NOSIGNAL);
+
+		if (n < 0 && errno == EINTR)
+			n = 0;
+		else if (n <= 0)
+			break;
+	}
+
+	pthread_mutex_unlock(&p_conn->write_lock);
+}
+
+static void service_conn_release(service_conn_t *p_conn)
+{
+	int refcnt;
+
+	pthread_mutex_lock(&m_service.lock);
+	refcnt = --p_conn->refcnt;
+	pthread_mutex_unlock(&m_service.lock);
+
+	if (!refcnt)
+	{
+		close(p_conn->fd);
+		pthread_mutex_destroy(&p_conn->write_lock);
+		free(p_conn);
+	}
+}
+
+static void service_pkg_remove(service_pkg_t *p_entry)
+{
+	service_pkg_t **pp_entry;
+
+	for (pp_entry = &m_service.p_pkgs; *pp_entry != NULL; pp_entry = &(*pp_entry)->p_next)
+	{
+		if (*pp_entry == p_entry)
+		{
+			*pp_entry = p_entry->p_next;
+			m_service.num_pkgs--;
+
+			dfu_package_free(p_entry->p_pkg);
+			free(p_entry);
+
+			break;
+		}
+	}
+}
+
+// find a package loaded from the current file, under the service lock
+static service_pkg_t *service_pkg_find(const char *p_path, const struct stat *p_st)
+{
+	service_pkg_t *p_entry;
+
+	for (p_entry = m_service.p_pkgs; p_entry != NULL; p_entry = p_entry->p_next)
+	{
+		if (p_entry->stale || strcmp(p_entry->path, p_path))
+			continue;
+
+		if (p_entry->mtime == p_st->st_mtime && p_entry->size == p_st->st_size)
+			return p_entry;
+
+		// the package file has been replaced
+		p_entry->stale = 1;
+
+		if (!p_entry->refcnt)
+			service_pkg_remove(p_entry);
+
+		break;
+	}
+
+	return NULL;
+}
+
+// get a package, loading it if it is not kept already
+static service_pkg_t *service_pkg_get(const char *p_file)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	service_pkg_t *p_entry, *p_new, *p_old;
+	dfu_package_t *p_pkg;
+
+	if (realpath(p_file, path) == NULL || stat(path, &st))
+	{
+		logger_error("Cannot open ZIP package file!");
+
+		return NULL;
+	}
+
+	pthread_mutex_lock(&m_service.lock);
+
+	p_entry = service_pkg_find(path, &st);
+	if (p_entry != NULL)
+	{
+		p_entry->refcnt++;
+		p_entry->last_use = sys_time_us();
+	}
+
+	pthread_mutex_unlock(&m_service.lock);
+
+	if (p_entry != NULL)
+		return p_entry;
+
+	// decompressed without the lock, the other jobs go on meanwhile
+	if (dfu_package_load(path, &p_pkg))
+		return NULL;
+
+	p_new = (service_pkg_t *)calloc(1, sizeof(service_pkg_t));
+
+	if (p_new == NULL)
+	{
+		logger_error("Cannot allocate memory!");
+
+		dfu_package_free(p_pkg);
+
+		return NULL;
+	}
+
+	strcpy(p_new->path, path);
+	p_new->mtime = st.st_mtime;
+	p_new->size = st.st_size;
+	p_new->p_pkg = p_pkg;
+
+	pthread_mutex_lock(&m_service.lock);
+
+	// another job may have loaded it meanwhile
+	p_entry = service_pkg_find(path, &st);
+
+	if (p_entry == NULL)
+	{
+		// drop the package unused for the longest time
+		if (m_service.num_pkgs >= SERVICE_CACHE_MAX)
+		{
+			p_old = NULL;
+
+			for (p_entry = m_service.p_pkgs; p_entry != NULL; p_entry = p_entry->p_next)
+			{
+				if (!p_entry->refcnt && (p_old == NULL || p_entry->last_use < p_old->last_use))
+					p_old = p_entry;
+			}
+
+			if (p_old != NULL)
+				service_pkg_remove(p_old);
+		}
+
+		p_new->p_next = m_service.p_pkgs;
+		m_service.p_pkgs = p_new;
+		m_service.num_pkgs++;
+
+		p_entry = p_new;
+		p_new = NULL;
+	}
+
+	p_entry->refcnt++;
+	p_entry->last_use = sys_time_us();
+
+	pthread_mutex_unlock(&m_service.lock);
+
+	if (p_new != NULL)
+	{
+		dfu_package_free(p_new->p_pkg);
+		free(p_new);
+	}
+
+	return p_entry;
+}
+
+static void service_pkg_release(service_pkg_t *p_entry)
+{
+	pthread_mutex_lock(&m_service.lock);
+
+	if (!--p_entry->refcnt && p_entry->stale)
+		service_pkg_remove(p_entry);
+
+	pthread_mutex_unlock(&m_service.lock);
+}
+
+// get the state of a port, under the service lock
+static service_port_t *service_port_get(const char *p_name)
+{
+	service_port_t *p_port;
+
+	for (p_port = m_service.p_ports; p_port != NULL; p_port = p_port->p_next)
+	{
+		if (!strcmp(p_port->name, p_name))
+			return p_port;
+	}
+
+	p_port = (service_port_t *)calloc(1, sizeof(service_port_t));
+
+	if (p_port != NULL)
+	{
+		strcpy(p_port->name, p_name);
+
+		p_port->p_next = m_service.p_ports;
+		m_service.p_ports = p_port;
+	}
+
+	return p_port;
+}
+
+// take the oldest job whose port is free, under the service lock
+static service_job_t *service_job_take(void)
+{
+	service_job_t **pp_job;
+	service_job_t *p_job;
+	service_port_t *p_port;
+
+	if (m_service.stopping)
+		return NULL;
+
+	for (pp_job = &m_service.p_jobs; *pp_job != NULL; pp_job = &(*pp_job)->p_next)
+	{
+		p_job = *pp_job;
+		p_port = service_port_get(p_job->port);
+
+		if (p_port == NULL || p_port->busy)
+			continue;
+
+		*pp_job = p_job->p_next;
+
+		p_port->busy = 1;
+		p_job->p_port = p_port;
+
+		return p_job;
+	}
+
+	return NULL;
+}
+
+static void service_progress(void *p_context, uint32_t offset, uint32_t size, uint64_t eta_us)
+{
+	service_job_t *p_job = (service_job_t *)p_context;
+
+	// the progress comes frame by frame, a few events are enough
+	if (offset > p_job->progress_offset && offset < size && offset - p_job->progress_offset < SERVICE_PROGRESS_STEP)
+		return;
+
+	p_job->progress_offset = offset;
+
+	service_send(p_job->p_conn, "{\"job\":%u,\"event\":\"progress\",\"offset\":%u,\"size\":%u,\"eta_ms\":%llu}",
+		p_job->id, offset, size, (unsigned long long)(eta_us / 1000));
+}
+
+static int service_job_exec(service_job_t *p_job, service_pkg_t *p_entry)
+{
+	service_port_t *p_port = p_job->p_port;
+	int err_code = 0;
+
+	if (!p_port->open)
+	{
+		p_port->uart = *m_service.p_uart_cfg;
+		p_port->uart.p_PortName = p_port->name;
+		p_port->uart.p_RecordName = NULL;
+
+		err_code = uart_slip_open(&p_port->uart);
+		p_port->open = !err_code;
+	}
+
+	if (!err_code)
+	{
+		p_port->uart.p_progress = service_progress;
+		p_port->uart.p_progress_context = p_job;
+
+		if (p_job->op == SERVICE_OP_FLASH)
+			err_code = dfu_send_loaded_package(&p_port->uart, p_entry->p_pkg, p_job->skip_installed, NULL);
+		else
+			err_code = dfu_verify_loaded_package(&p_port->uart, p_entry->p_pkg);
+
+		p_port->uart.p_progress = NULL;
+		p_port->uart.p_progress_context = NULL;
+	}
+
+	// opened again by the next job, the device may have been replaced
+	if (err_code && p_port->open)
+	{
+		uart_slip_close(&p_port->uart);
+		p_port->open = 0;
+	}
+
+	return err_code;
+}
+
+static void service_job_run(service_job_t *p_job)
+{
+	uint64_t time_us = sys_time_us();
+	service_pkg_t *p_entry;
+	int reopened, err_code = 1;
+
+	service_send(p_job->p_conn, "{\"job\":%u,\"event\":\"started\"}", p_job->id);
+
+	p_entry = service_pkg_get(p_job->package);
+
+	if (p_entry != NULL)
+	{
+		reopened = !p_job->p_port->open;
+
+		err_code = service_job_exec(p_job, p_entry);
+
+		// a port kept open may have gone away with the previous device, try once more
+		if (err_code && !reopened)
+			err_code = service_job_exec(p_job, p_entry);
+
+		service_pkg_release(p_entry);
+	}
+
+	service_send(p_job->p_conn, "{\"job\":%u,\"event\":\"done\",\"result\":\"%s\",\"time_ms\":%.1f}",
+		p_job->id, err_code ? "FAIL" : "PASS", (sys_time_us() - time_us) / 1000.0);
+}
+
+// wait for the jobs running to abort, and close the ports kept open
+static void service_stop(void)
+{
+	service_port_t *p_port;
+	int busy;
+
+	pthread_mutex_lock(&m_service.lock);
+
+	m_service.stopping = 1;
+
+	do
+	{
+		busy = 0;
+
+		for (p_port = m_service.p_ports; p_port != NULL; p_port = p_port->p_next)
+			busy |= p_port->busy;
+
+		if (busy)
+			pthread_cond_wait(&m_service.cond, &m_service.lock);
+	} while (busy);
+
+	for (p_port = m_service.p_ports; p_port != NULL; p_port = p_port->p_next)
+	{
+		if (p_port->open)
+		{
+			uart_slip_close(&p_port->uart);
+			p_port->open = 0;
+		}
+	}
+
+	pthread_mutex_unlock(&m_service.lock);
+}
+
+static void *service_worker_thread(void *p_context)
+{
+	service_job_t *p_job;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&m_service.lock);
+
+		while ((p_job = service_job_take()) == NULL)
+			pthread_cond_wait(&m_service.cond, &m_service.lock);
+
+		pthread_mutex_unlock(&m_service.lock);
+
+		service_job_run(p_job);
+
+		pthread_mutex_lock(&m_service.lock);
+		p_job->p_port->busy = 0;
+		pthread_cond_broadcast(&m_service.cond);
+		pthread_mutex_unlock(&m_service.lock);
+
+		service_conn_release(p_job->p_conn);
+		free(p_job);
+	}
+
+	return NULL;
+}
+
+static int json_token_is(const char *p_json, const jsmntok_t *p_tok, const char *p_str)
+{
+	int len = p_tok->end - p_tok->start;
+
+	return (int)strlen(p_str) == len && !strncmp(p_json + p_tok->start, p_str, len);
+}
+
+static int json_token_copy(const char *p_json, const jsmntok_t *p_tok, char *p_dst, size_t size)
+{
+	size_t len = p_tok->end - p_tok->start;
+
+	if (p_tok->type != JSMN_STRING || len >= size)
+		return 1;
+
+	memcpy(p_dst, p_json + p_tok->start, len);
+	p_dst[len] = '\0';
+
+	return 0;
+}
+
+// parse a job request, returns an error message or NULL
+static const char *service_parse_job(const char *p_line, service_job_t *p_job)
+{
+	jsmn_parser parser;
+	jsmntok_t tokens[SERVICE_TOKEN_NUM_MAX];
+	const jsmntok_t *p_key, *p_val;
+	int num_tokens, has_op = 0;
+	int i;
+
+	jsmn_init(&parser);
+
+	num_tokens = jsmn_parse(&parser, p_line, strlen(p_line), tokens, SERVICE_TOKEN_NUM_MAX);
+
+	if (num_tokens < 1 || tokens[0].type != JSMN_OBJECT || num_tokens != tokens[0].size * 2 + 1)
+		return "Invalid request";
+
+	snprintf(p_job->package, sizeof(p_job->package), "%s", m_service.p_pkg_file);
+
+	for (i = 1; i < num_tokens; i += 2)
+	{
+		p_key = tokens + i;
+		p_val = tokens + i + 1;
+
+		if (p_key->type != JSMN_STRING)
+			return "Invalid request";
+
+		if (json_token_is(p_line, p_key, "op"))
+		{
+			if (json_token_is(p_line, p_val, "flash"))
+				p_job->op = SERVICE_OP_FLASH;
+			else if (json_token_is(p_line, p_val, "verify"))
+				p_job->op = SERVICE_OP_VERIFY;
+			else
+				return "Unknown operation";
+
+			has_op = 1;
+		}
+		else if (json_token_is(p_line, p_key, "port"))
+		{
+			if (json_token_copy(p_line, p_val, p_job->port, sizeof(p_job->port)))
+				return "Invalid port";
+		}
+		else if (json_token_is(p_line, p_key, "package"))
+		{
+			if (json_token_copy(p_line, p_val, p_job->package, sizeof(p_job->package)))
+				return "Invalid package";
+		}
+		else if (json_token_is(p_line, p_key, "skip_installed"))
+		{
+			if (p_val->type != JSMN_PRIMITIVE)
+				return "Invalid skip_installed";
+
+			p_job->skip_installed = json_token_is(p_line, p_val, "true");
+		}
+		else
+		{
+			return "Unknown request field";
+		}
+	}
+
+	if (!has_op || !p_job->port[0])
+		return "Missing op or port";
+
+	return NULL;
+}
+
+static void service_request(service_conn_t *p_conn, const char *p_line)
+{
+	service_job_t *p_job;
+	service_job_t **pp_job;
+	const char *p_error;
+
+	p_job = (service_job_t *)calloc(1, sizeof(service_job_t));
+
+	if (p_job == NULL)
+	{
+		service_send(p_conn, "{\"event\":\"error\",\"message\":\"Out of memory\"}");
+
+		return;
+	}
+
+	p_error = service_parse_job(p_line, p_job);
+
+	if (p_error != NULL)
+	{
+		service_send(p_conn, "{\"event\":\"error\",\"message\":\"%s\"}", p_error);
+
+		free(p_job);
+
+		return;
+	}
+
+	p_job->p_conn = p_conn;
+
+	pthread_mutex_lock(&m_service.lock);
+	p_job->id = ++m_service.job_id;
+	p_conn->refcnt++;
+	pthread_mutex_unlock(&m_service.lock);
+
+	// sent before the job may start, a slow client holds no lock
+	service_send(p_conn, "{\"job\":%u,\"event\":\"queued\"}", p_job->id);
+
+	pthread_mutex_lock(&m_service.lock);
+
+	for (pp_job = &m_service.p_jobs; *pp_job != NULL; pp_job = &(*pp_job)->p_next)
+		;
+	*pp_job = p_job;
+
+	pthread_cond_broadcast(&m_service.cond);
+	pthread_mutex_unlock(&m_service.lock);
+}
+
+// read the requests of a client until it disconnects
+static void *service_conn_thread(void *p_context)
+{
+	service_conn_t *p_conn = (service_conn_t *)p_context;
+	char line[SERVICE_LINE_MAX];
+	FILE *p_in;
+	int fd;
+	size_t len;
+
+	fd = dup(p_conn->fd);
+	p_in = (fd >= 0) ? fdopen(fd, "r") : NULL;
+
+	if (p_in == NULL)
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+	else
+	{
+		while (fgets(line, sizeof(line), p_in) != NULL)
+		{
+			len = strlen(line);
+
+			while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+				line[--len] = '\0';
+
+			if (len > 0)
+				service_request(p_conn, line);
+		}
+
+		fclose(p_in);
+	}
+
+	service_conn_release(p_conn);
+
+	return NULL;
+}
+
+int service_run(const char *p_sock_path, const char *p_pkg_file, const uart_drv_t *p_uart_cfg, int max_jobs)
+{
+	struct sockaddr_un addr;
+	service_pkg_t *p_entry;
+	service_conn_t *p_conn;
+	pthread_t thread;
+	int err_code = 0;
+	int sock, fd;
+	int i;
+
+	m_service.p_uart_cfg = p_uart_cfg;
+	m_service.p_pkg_file = p_pkg_file;
+
+	if (strlen(p_sock_path) >= sizeof(addr.sun_path))
+	{
+		logger_error("Invalid service socket path!");
+
+		return 1;
+	}
+
+	// the default package is kept from the start
+	p_entry = service_pkg_get(p_pkg_file);
+	if (p_entry == NULL)
+		return 1;
+
+	service_pkg_release(p_entry);
+
+	sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, p_sock_path);
+
+	unlink(p_sock_path);
+
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, sizeof(addr)) || listen(sock, SOMAXCONN))
+	{
+		logger_error("Cannot listen on the service socket!");
+
+		if (sock >= 0)
+			close(sock);
+
+		return 1;
+	}
+
+	for (i = 0; i < max_jobs; i++)
+	{
+		if (pthread_create(&thread, NULL, service_worker_thread, NULL))
+			break;
+
+		pthread_detach(thread);
+	}
+
+	if (!i)
+	{
+		logger_error("Cannot start the service workers!");
+
+		close(sock);
+
+		return 1;
+	}
+
+	logger_info_1("Serving on %s, %d jobs at once.", p_sock_path, i);
+
+	for (;;)
+	{
+		fd = accept(sock, NULL, NULL);
+
+		if (fd < 0)
+		{
+			// stopped by a signal, the jobs running are cancelled with it
+			if (errno == EINTR && p_uart_cfg->p_cancel != NULL && *p_uart_cfg->p_cancel)
+				break;
+
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			logger_error("Cannot accept service clients!");
+
+			err_code = 1;
+			break;
+		}
+
+		p_conn = (service_conn_t *)calloc(1, sizeof(service_conn_t));
+
+		if (p_conn == NULL)
+		{
+			close(fd);
+
+			continue;
+		}
+
+		p_conn->fd = fd;
+		p_conn->refcnt = 1;
+		pthread_mutex_init(&p_conn->write_lock, NULL);
+
+		if (pthread_create(&thread, NULL, service_conn_thread, p_conn))
+		{
+			service_conn_release(p_conn);
+
+			continue;
+		}
+
+		pthread_detach(thread);
+	}
+
+	close(sock);
+	unlink(p_sock_path);
+
+	service_stop();
+
+	return err_code;
+}
+
+#endif
@@ -40,45 +40,125 @@
 
 #include <stdbool.h>
 #include "slip_enc.h"
+#include "crc32.h"
 
-#define	SLIP_END				0300
-#define	SLIP_ESC				0333
-#define	SLIP_ESC_END			0334
-#define	SLIP_ESC_ESC			0335
-
-void encode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcData, uint32_t nSrcSize)
+// SLIP-escape data, returns the end of the encoded data
+static uint8_t *escape_slip(uint8_t *pDestData, const uint8_t *pSrcData, uint32_t nSrcSize)
 {
-	uint32_t n, nDestSize;
+	uint32_t n;
+
+	for (n = 0; n < nSrcSize; n++)
+	{
+		uint8_t nSrcByte = *(pSrcData + n);
 
-	nDestSize = 0;
+		if (nSrcByte == SLIP_END)
+		{
+			*pDestData++ = SLIP_ESC;
+			*pDestData++ = SLIP_ESC_END;
+		}
+		else if (nSrcByte == SLIP_ESC)
+		{
+			*pDestData++ = SLIP_ESC;
+			*pDestData++ = SLIP_ESC_ESC;
+		}
+		else
+		{
+			*pDestData++ = nSrcByte;
+		}
+	}
+
+	return pDestData;
+}
+
+// SLIP-escape data and update the CRC-32 register, returns the end of the encoded data
+static uint8_t *escape_slip_crc(uint8_t *pDestData, const uint8_t *pSrcData, uint32_t nSrcSize, uint32_t *pCrcReg)
+{
+	uint32_t crc = *pCrcReg;
+	uint32_t n;
 
 	for (n = 0; n < nSrcSize; n++)
 	{
 		uint8_t nSrcByte = *(pSrcData + n);
 
+		crc = CRC32_UPDATE(crc, nSrcByte);
+
 		if (nSrcByte == SLIP_END)
 		{
 			*pDestData++ = SLIP_ESC;
 			*pDestData++ = SLIP_ESC_END;
-			nDestSize += 2;
 		}
 		else if (nSrcByte == SLIP_ESC)
 		{
 			*pDestData++ = SLIP_ESC;
 			*pDestData++ = SLIP_ESC_ESC;
-			nDestSize += 2;
 		}
 		else
 		{
 			*pDestData++ = nSrcByte;
-			nDestSize++;
 		}
 	}
 
-	*pDestData = SLIP_END;
-	nDestSize++;
+	*pCrcReg = crc;
 
-	*pDestSize = nDestSize;
+	return pDestData;
+}
+
+void encode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcData, uint32_t nSrcSize)
+{
+	slip_iov_t iov;
+
+	iov.pData = pSrcData;
+	iov.nSize = nSrcSize;
+
+	encode_slip_iov(pDestData, pDestSize, &iov, 1);
+}
+
+void encode_slip_iov(uint8_t *pDestData, uint32_t *pDestSize, const slip_iov_t *pSrcIov, uint32_t nCount)
+{
+	uint8_t *pDestEnd = pDestData;
+	uint32_t n;
+
+	for (n = 0; n < nCount; n++)
+		pDestEnd = escape_slip(pDestEnd, (pSrcIov + n)->pData, (pSrcIov + n)->nSize);
+
+	*pDestEnd++ = SLIP_END;
+
+	*pDestSize = (uint32_t)(pDestEnd - pDestData);
+}
+
+void encode_slip_iov_crc(uint8_t *pDestData, uint32_t *pDestSize, const slip_iov_t *pSrcIov, uint32_t nCount,
+						 uint32_t nCrcStart, uint32_t *pCrc)
+{
+	uint8_t *pDestEnd = pDestData;
+	uint32_t crc = ~(*pCrc);
+	uint32_t n;
+
+	for (n = 0; n < nCount; n++)
+	{
+		if (n >= nCrcStart)
+			pDestEnd = escape_slip_crc(pDestEnd, (pSrcIov + n)->pData, (pSrcIov + n)->nSize, &crc);
+		else
+			pDestEnd = escape_slip(pDestEnd, (pSrcIov + n)->pData, (pSrcIov + n)->nSize);
+	}
+
+	*pDestEnd++ = SLIP_END;
+
+	*pDestSize = (uint32_t)(pDestEnd - pDestData);
+	*pCrc = ~crc;
+}
+
+uint32_t slip_escape_count(const uint8_t *pSrcData, uint32_t nSrcSize)
+{
+	uint32_t nCount = 0;
+	uint32_t n;
+
+	for (n = 0; n < nSrcSize; n++)
+	{
+		if (pSrcData[n] == SLIP_END || pSrcData[n] == SLIP_ESC)
+			nCount++;
+	}
+
+	return nCount;
 }
 
 int decode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcData, uint32_t nSrcSize)
@@ -146,3 +226,47 @@ int decode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcData
 
 	return err_code;
 }
+
+int decode_slip_frame(uint8_t *pDestData, uint32_t nDestMax, uint32_t *pDestSize, const uint8_t *pSrcData, uint32_t nSrcSize)
+{
+	uint32_t n, nDestSize = 0;
+	bool is_escaped = false;
+
+	*pDestSize = 0;
+
+	for (n = 0; n < nSrcSize; n++)
+	{
+		uint8_t nSrcByte = pSrcData[n];
+
+		if (is_escaped)
+		{
+			if (nSrcByte == SLIP_ESC_END)
+				nSrcByte = SLIP_END;
+			else if (nSrcByte == SLIP_ESC_ESC)
+				nSrcByte = SLIP_ESC;
+			else
+				return 1;
+
+			is_escaped = false;
+		}
+		else if (nSrcByte == SLIP_END)
+		{
+			*pDestSize = nDestSize;
+
+			return 0;
+		}
+		else if (nSrcByte == SLIP_ESC)
+		{
+			is_escaped = true;
+
+			continue;
+		}
+
+		if (nDestSize >= nDestMax)
+			return 1;
+
+		pDestData[nDestSize++] = nSrcByte;
+	}
+
+	return 1;
+}
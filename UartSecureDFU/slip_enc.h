@@ -51,10 +51,39 @@ extern "C" {
 #endif  /* __cplusplus */
 
 
+#define	SLIP_END				0300
+#define	SLIP_ESC				0333
+#define	SLIP_ESC_END			0334
+#define	SLIP_ESC_ESC			0335
+
+/**
+* @brief Gather element for SLIP encoding.
+*/
+typedef struct {
+	const uint8_t *pData;               //!< Element data.
+	uint32_t nSize;                     //!< Element size.
+} slip_iov_t;
+
+
 void encode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcData, uint32_t nSrcSize);
 
+// encode the concatenation of nCount gather elements as one SLIP frame
+void encode_slip_iov(uint8_t *pDestData, uint32_t *pDestSize, const slip_iov_t *pSrcIov, uint32_t nCount);
+
+// encode as encode_slip_iov() and, in the same pass, update the running CRC-32 in *pCrc
+// (crc32_compute() format) over the elements from nCrcStart on
+void encode_slip_iov_crc(uint8_t *pDestData, uint32_t *pDestSize, const slip_iov_t *pSrcIov, uint32_t nCount,
+						 uint32_t nCrcStart, uint32_t *pCrc);
+
+// number of bytes SLIP escapes in the data, each taking one more byte on the link
+uint32_t slip_escape_count(const uint8_t *pSrcData, uint32_t nSrcSize);
+
 int  decode_slip(uint8_t *pDestData, uint32_t *pDestSize, const uint8_t *pSrcData, uint32_t nSrcSize);
 
+// decode one frame ending with SLIP_END into at most nDestMax bytes; returns 1 for a malformed frame:
+// an escape not followed by SLIP_ESC_END or SLIP_ESC_ESC, no SLIP_END, or too large
+int  decode_slip_frame(uint8_t *pDestData, uint32_t nDestMax, uint32_t *pDestSize, const uint8_t *pSrcData, uint32_t nSrcSize);
+
 
 #ifdef __cplusplus
 }   /* ... extern "C" */
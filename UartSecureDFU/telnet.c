@@ -0,0 +1,182 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <stddef.h>
+#include "telnet.h"
+
+enum {
+	TELNET_STATE_DATA = 0,
+	TELNET_STATE_IAC,
+	TELNET_STATE_OPT,
+	TELNET_STATE_SB,
+	TELNET_STATE_SB_IAC
+};
+
+void telnet_rx_init(telnet_rx_t *p_rx, telnet_cmd_handler_t handler, void *p_context)
+{
+	p_rx->state = TELNET_STATE_DATA;
+	p_rx->cmd = 0;
+	p_rx->sb_len = 0;
+	p_rx->handler = handler;
+	p_rx->p_context = p_context;
+}
+
+uint32_t telnet_rx_decode(telnet_rx_t *p_rx, uint8_t *pData, uint32_t nSize)
+{
+	uint32_t n, nDataSize = 0;
+
+	for (n = 0; n < nSize; n++)
+	{
+		uint8_t nByte = *(pData + n);
+
+		switch (p_rx->state)
+		{
+		case TELNET_STATE_DATA:
+			if (nByte == TELNET_IAC)
+				p_rx->state = TELNET_STATE_IAC;
+			else
+				*(pData + nDataSize++) = nByte;
+			break;
+
+		case TELNET_STATE_IAC:
+			if (nByte == TELNET_IAC)
+			{
+				// escaped 0xFF data byte
+				*(pData + nDataSize++) = nByte;
+
+				p_rx->state = TELNET_STATE_DATA;
+			}
+			else if (nByte == TELNET_SB)
+			{
+				p_rx->sb_len = 0;
+				p_rx->state = TELNET_STATE_SB;
+			}
+			else if (nByte >= TELNET_WILL)
+			{
+				p_rx->cmd = nByte;
+				p_rx->state = TELNET_STATE_OPT;
+			}
+			else
+			{
+				// other commands carry no data for us
+				p_rx->state = TELNET_STATE_DATA;
+			}
+			break;
+
+		case TELNET_STATE_OPT:
+			if (p_rx->handler != NULL)
+				p_rx->handler(p_rx->p_context, p_rx->cmd, nByte, NULL, 0);
+
+			p_rx->state = TELNET_STATE_DATA;
+			break;
+
+		case TELNET_STATE_SB:
+			if (nByte == TELNET_IAC)
+				p_rx->state = TELNET_STATE_SB_IAC;
+			else if (p_rx->sb_len < sizeof(p_rx->sb))
+				p_rx->sb[p_rx->sb_len++] = nByte;
+			break;
+
+		case TELNET_STATE_SB_IAC:
+			if (nByte == TELNET_SE)
+			{
+				if (p_rx->handler != NULL && p_rx->sb_len > 0)
+					p_rx->handler(p_rx->p_context, TELNET_SB, p_rx->sb[0], p_rx->sb + 1, p_rx->sb_len - 1);
+
+				p_rx->state = TELNET_STATE_DATA;
+			}
+			else
+			{
+				if (p_rx->sb_len < sizeof(p_rx->sb))
+					p_rx->sb[p_rx->sb_len++] = nByte;
+
+				p_rx->state = TELNET_STATE_SB;
+			}
+			break;
+
+		default:
+			p_rx->state = TELNET_STATE_DATA;
+			break;
+		}
+	}
+
+	return nDataSize;
+}
+
+uint32_t telnet_tx_encode(uint8_t *pDest, const uint8_t *pSrc, uint32_t nSize)
+{
+	uint32_t n, nDestSize = 0;
+
+	for (n = 0; n < nSize; n++)
+	{
+		if (*(pSrc + n) == TELNET_IAC)
+			*(pDest + nDestSize++) = TELNET_IAC;
+
+		*(pDest + nDestSize++) = *(pSrc + n);
+	}
+
+	return nDestSize;
+}
+
+uint32_t telnet_tx_option(uint8_t *pDest, uint8_t cmd, uint8_t opt)
+{
+	*(pDest + 0) = TELNET_IAC;
+	*(pDest + 1) = cmd;
+	*(pDest + 2) = opt;
+
+	return 3;
+}
+
+uint32_t telnet_tx_com_port(uint8_t *pDest, uint8_t cmd, const uint8_t *p_value, uint32_t len)
+{
+	uint32_t nDestSize = 0;
+
+	*(pDest + nDestSize++) = TELNET_IAC;
+	*(pDest + nDestSize++) = TELNET_SB;
+	*(pDest + nDestSize++) = TELNET_OPT_COM_PORT;
+	*(pDest + nDestSize++) = cmd;
+
+	nDestSize += telnet_tx_encode(pDest + nDestSize, p_value, len);
+
+	*(pDest + nDestSize++) = TELNET_IAC;
+	*(pDest + nDestSize++) = TELNET_SE;
+
+	return nDestSize;
+}
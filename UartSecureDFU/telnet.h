@@ -0,0 +1,118 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#pragma once
+ 
+#ifndef _INC_TELNET
+#define _INC_TELNET
+
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+
+#define TELNET_IAC                  255
+#define TELNET_DONT                 254
+#define TELNET_DO                   253
+#define TELNET_WONT                 252
+#define TELNET_WILL                 251
+#define TELNET_SB                   250
+#define TELNET_SE                   240
+
+#define TELNET_OPT_BINARY           0
+#define TELNET_OPT_SGA              3
+#define TELNET_OPT_COM_PORT         44
+
+// RFC2217 COM port commands, the server replies with the command + RFC2217_SERVER_OFFSET
+#define RFC2217_SET_BAUDRATE        1
+#define RFC2217_SET_DATASIZE        2
+#define RFC2217_SET_PARITY          3
+#define RFC2217_SET_STOPSIZE        4
+#define RFC2217_SET_CONTROL         5
+#define RFC2217_SERVER_OFFSET       100
+
+#define RFC2217_PARITY_NONE         1
+#define RFC2217_STOPSIZE_1          1
+#define RFC2217_CONTROL_HW_FLOW     3
+
+// maximum size of a received subnegotiation
+#define TELNET_SB_SIZE_MAX          16
+
+/**
+* @brief Telnet command handler.
+*
+* Called with cmd set to TELNET_WILL, TELNET_WONT, TELNET_DO or TELNET_DONT for option
+* negotiation and to TELNET_SB for a subnegotiation, whose data follows the option byte.
+*/
+typedef void (*telnet_cmd_handler_t)(void *p_context, uint8_t cmd, uint8_t opt, const uint8_t *p_sb, uint32_t sb_len);
+
+typedef struct {
+	uint8_t state;                      //!< Decoder state.
+	uint8_t cmd;                        //!< Pending command.
+	uint8_t sb[TELNET_SB_SIZE_MAX];     //!< Subnegotiation data.
+	uint32_t sb_len;                    //!< Subnegotiation data size.
+	telnet_cmd_handler_t handler;       //!< Command handler.
+	void *p_context;                    //!< Command handler context.
+} telnet_rx_t;
+
+
+void telnet_rx_init(telnet_rx_t *p_rx, telnet_cmd_handler_t handler, void *p_context);
+
+// strip telnet commands in place, returns the number of data bytes left
+uint32_t telnet_rx_decode(telnet_rx_t *p_rx, uint8_t *pData, uint32_t nSize);
+
+// escape IAC bytes, pDest must hold 2 * nSize bytes
+uint32_t telnet_tx_encode(uint8_t *pDest, const uint8_t *pSrc, uint32_t nSize);
+
+// build an option negotiation command, pDest must hold 3 bytes
+uint32_t telnet_tx_option(uint8_t *pDest, uint8_t cmd, uint8_t opt);
+
+// build a COM port subnegotiation, pDest must hold 6 + 2 * len bytes
+uint32_t telnet_tx_com_port(uint8_t *pDest, uint8_t cmd, const uint8_t *p_value, uint32_t len);
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_TELNET
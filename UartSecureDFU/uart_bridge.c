@@ -0,0 +1,302 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+// UartTcpBridge : serves a local serial port over TCP, raw or with RFC2217 COM port control.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "uart_drv.h"
+#include "telnet.h"
+#include "logging.h"
+
+typedef struct {
+	uart_drv_t *p_uart;                 //!< Bridged serial port.
+	int fd;                             //!< Client socket.
+	uint64_t opt_sent;                  //!< Telnet options already answered.
+} bridge_t;
+
+static int bridge_write(int fd, const uint8_t *pData, uint32_t nSize)
+{
+	while (nSize > 0)
+	{
+		ssize_t length = send(fd, pData, nSize, MSG_NOSIGNAL);
+
+		if (length < 0 && errno == EINTR)
+			continue;
+
+		if (length <= 0)
+			return 1;
+
+		pData += length;
+		nSize -= length;
+	}
+
+	return 0;
+}
+
+// handle the client's telnet option negotiation and COM port settings
+static void bridge_rfc2217_handler(void *p_context, uint8_t cmd, uint8_t opt, const uint8_t *p_sb, uint32_t sb_len)
+{
+	bridge_t *p_bridge = (bridge_t *)p_context;
+	uint8_t reply[6 + 2 * 4];
+	int supported = (opt == TELNET_OPT_BINARY || opt == TELNET_OPT_COM_PORT || opt == TELNET_OPT_SGA);
+
+	if (cmd == TELNET_SB)
+	{
+		if (opt == TELNET_OPT_COM_PORT && sb_len >= 1)
+		{
+			if (p_sb[0] == RFC2217_SET_BAUDRATE && sb_len == 5)
+			{
+				uint32_t baud_rate = ((uint32_t)p_sb[1] << 24) | ((uint32_t)p_sb[2] << 16) |
+					((uint32_t)p_sb[3] << 8) | p_sb[4];
+
+				// a zero bit rate queries the current setting
+				if (baud_rate && uart_drv_set_baud(p_bridge->p_uart, baud_rate))
+					baud_rate = 0;
+				else if (!baud_rate)
+					baud_rate = p_bridge->p_uart->baud_rate ? p_bridge->p_uart->baud_rate : UART_DRV_BAUD_RATE_DEF;
+
+				logger_info_1("Bit rate set to %u.", baud_rate);
+
+				reply[0] = (uint8_t)(baud_rate >> 24);
+				reply[1] = (uint8_t)(baud_rate >> 16);
+				reply[2] = (uint8_t)(baud_rate >> 8);
+				reply[3] = (uint8_t)(baud_rate >> 0);
+				bridge_write(p_bridge->fd, reply + 4, telnet_tx_com_port(reply + 4, p_sb[0] + RFC2217_SERVER_OFFSET, reply, 4));
+			}
+			else if (sb_len >= 2)
+			{
+				// the port is fixed to 8N1 with RTS/CTS flow control, confirm as requested
+				bridge_write(p_bridge->fd, reply, telnet_tx_com_port(reply, p_sb[0] + RFC2217_SERVER_OFFSET, p_sb + 1, 1));
+			}
+		}
+	}
+	else if ((cmd == TELNET_DO || cmd == TELNET_WILL) && opt < 64 && !(p_bridge->opt_sent & ((uint64_t)1 << opt)))
+	{
+		if (cmd == TELNET_DO)
+			telnet_tx_option(reply, supported ? TELNET_WILL : TELNET_WONT, opt);
+		else
+			telnet_tx_option(reply, supported ? TELNET_DO : TELNET_DONT, opt);
+
+		p_bridge->opt_sent |= ((uint64_t)1 << opt);
+
+		bridge_write(p_bridge->fd, reply, 3);
+	}
+}
+
+static int bridge_serve(bridge_t *p_bridge, int rfc2217)
+{
+	int err_code = 0;
+	telnet_rx_t telnet;
+	uint8_t data[512];
+	uint8_t buff[2 * sizeof(data)];
+	uint32_t length;
+
+	telnet_rx_init(&telnet, bridge_rfc2217_handler, p_bridge);
+	p_bridge->opt_sent = 0;
+
+	while (!err_code)
+	{
+		fd_set fds;
+		int nfds = (p_bridge->fd > p_bridge->p_uart->tty_fd) ? p_bridge->fd : p_bridge->p_uart->tty_fd;
+
+		FD_ZERO(&fds);
+		FD_SET(p_bridge->fd, &fds);
+		FD_SET(p_bridge->p_uart->tty_fd, &fds);
+
+		if (select(nfds + 1, &fds, NULL, NULL, NULL) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			err_code = 1;
+			break;
+		}
+
+		if (FD_ISSET(p_bridge->fd, &fds))
+		{
+			ssize_t n = recv(p_bridge->fd, data, sizeof(data), 0);
+
+			if (n <= 0)
+			{
+				logger_info_1("Client disconnected.");
+				break;
+			}
+
+			length = n;
+			if (rfc2217)
+				length = telnet_rx_decode(&telnet, data, length);
+
+			if (length > 0)
+				err_code = uart_drv_send(p_bridge->p_uart, data, length);
+		}
+
+		if (!err_code && FD_ISSET(p_bridge->p_uart->tty_fd, &fds))
+		{
+			err_code = uart_drv_receive(p_bridge->p_uart, data, sizeof(data), &length);
+
+			if (!err_code && length > 0)
+			{
+				if (rfc2217)
+					err_code = bridge_write(p_bridge->fd, buff, telnet_tx_encode(buff, data, length));
+				else
+					err_code = bridge_write(p_bridge->fd, data, length);
+			}
+		}
+	}
+
+	return err_code;
+}
+
+int main(int argc, char *argv[])
+{
+	int err_code = 0;
+	int show_usage = 0;
+	int rfc2217 = 0;
+	int tcp_port = 0;
+	int listen_fd = -1;
+	int argn;
+	int on = 1;
+	int info_lvl = LOGGER_INFO_LVL_0;
+	struct sockaddr_in addr;
+	uart_drv_t uart_drv;
+	bridge_t bridge;
+
+	memset(&uart_drv, 0, sizeof(uart_drv));
+
+	if (argc >= 3)
+	{
+		tcp_port = atoi(argv[1]);
+		uart_drv.p_PortName = argv[2];
+	}
+
+	if (tcp_port <= 0 || tcp_port > 65535)
+	{
+		show_usage = 1;
+		err_code = 1;
+	}
+
+	for (argn = 3; argn < argc && !err_code; argn++)
+	{
+		if (!strcmp(argv[argn], "--rfc2217"))
+		{
+			rfc2217 = 1;
+		}
+		else if (!strcmp(argv[argn], "-v"))
+		{
+			logger_set_info_level(++info_lvl);
+		}
+		else
+		{
+			show_usage = 1;
+			err_code = 1;
+		}
+	}
+
+	if (show_usage)
+	{
+		printf("Usage: UartTcpBridge tcp_port serial_port [--rfc2217] [-v]\n");
+	}
+
+	if (!err_code)
+	{
+		listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons((uint16_t)tcp_port);
+
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+		if (listen_fd < 0 ||
+			bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+			listen(listen_fd, 1))
+		{
+			logger_error("Cannot listen on TCP port!");
+
+			err_code = 1;
+		}
+	}
+
+	// serve one client at a time, the serial port is opened per connection
+	while (!err_code)
+	{
+		bridge.fd = accept(listen_fd, NULL, NULL);
+
+		if (bridge.fd < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			err_code = 1;
+			break;
+		}
+
+		logger_info_1("Client connected.");
+
+		setsockopt(bridge.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+		uart_drv.baud_rate = 0;
+		bridge.p_uart = &uart_drv;
+
+		if (!uart_drv_open(&uart_drv))
+		{
+			bridge_serve(&bridge, rfc2217);
+
+			uart_drv_close(&uart_drv);
+		}
+
+		close(bridge.fd);
+	}
+
+	if (listen_fd >= 0)
+		close(listen_fd);
+
+	return err_code;
+}
@@ -0,0 +1,252 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <string.h>
+#include "uart_drv.h"
+#include "uart_replay.h"
+#include "sys_time.h"
+#include "logging.h"
+
+// transport backends, selected by port name prefix
+static const uart_drv_ops_t *uart_drv_backends[] =
+{
+	&uart_replay_ops,
+	&uart_sim_ops,
+#ifndef WIN32
+	&uart_tcp_ops,
+	&uart_rfc2217_ops,
+#endif
+	&uart_tty_ops,                      // default, must be last
+	NULL
+};
+
+static const uart_drv_ops_t *uart_drv_find_backend(const char *p_name)
+{
+	const uart_drv_ops_t *p_ops = NULL;
+	int i;
+
+	for (i = 0; uart_drv_backends[i] != NULL; i++)
+	{
+		const char *p_prefix = uart_drv_backends[i]->p_prefix;
+
+		if (p_prefix == NULL || !strncmp(p_name, p_prefix, strlen(p_prefix)))
+		{
+			p_ops = uart_drv_backends[i];
+			break;
+		}
+	}
+
+	return p_ops;
+}
+
+// select the backend of the port, and the port address it handles
+static const uart_drv_ops_t *uart_drv_select(uart_drv_t *p_uart)
+{
+	const uart_drv_ops_t *p_ops = uart_drv_find_backend(p_uart->p_PortName);
+
+	p_uart->p_ops = p_ops;
+	p_uart->p_addr = p_uart->p_PortName;
+	if (p_ops->p_prefix != NULL)
+		p_uart->p_addr += strlen(p_ops->p_prefix);
+
+	return p_ops;
+}
+
+int uart_drv_open(uart_drv_t *p_uart)
+{
+	int err_code;
+	const uart_drv_ops_t *p_ops = uart_drv_select(p_uart);
+
+	p_uart->p_priv = NULL;
+	p_uart->p_rec_file = NULL;
+	memset(&p_uart->stats, 0, sizeof(p_uart->stats));
+
+	err_code = p_ops->open(p_uart);
+
+	if (!err_code && p_uart->p_RecordName != NULL && p_ops != &uart_replay_ops)
+	{
+		err_code = uart_rec_start(p_uart);
+
+		if (err_code)
+			p_ops->close(p_uart);
+	}
+
+	return err_code;
+}
+
+int uart_drv_close(uart_drv_t *p_uart)
+{
+	int err_code;
+
+	err_code = p_uart->p_ops->close(p_uart);
+
+	if (uart_rec_stop(p_uart))
+		err_code = 1;
+
+	return err_code;
+}
+
+int uart_drv_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+{
+	int err_code;
+
+	err_code = p_uart->p_ops->send(p_uart, pData, nSize);
+
+	p_uart->stats.tx_calls++;
+
+	if (!err_code)
+	{
+		p_uart->stats.tx_bytes += nSize;
+
+		uart_rec_event(p_uart, 'T', pData, nSize);
+	}
+
+	return err_code;
+}
+
+int uart_drv_send_v(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount)
+{
+	int err_code = 0;
+	uint32_t n;
+
+	if (nCount > UART_DRV_IOV_MAX)
+	{
+		logger_error("Too many UART write elements!");
+
+		err_code = 1;
+	}
+	else if (p_uart->p_ops->send_v != NULL)
+	{
+		err_code = p_uart->p_ops->send_v(p_uart, pIov, nCount);
+
+		p_uart->stats.tx_calls++;
+
+		for (n = 0; !err_code && n < nCount; n++)
+		{
+			p_uart->stats.tx_bytes += (pIov + n)->nSize;
+
+			uart_rec_event(p_uart, 'T', (pIov + n)->pData, (pIov + n)->nSize);
+		}
+	}
+	else
+	{
+		for (n = 0; !err_code && n < nCount; n++)
+			err_code = uart_drv_send(p_uart, (pIov + n)->pData, (pIov + n)->nSize);
+	}
+
+	return err_code;
+}
+
+int uart_drv_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
+{
+	int err_code;
+
+	err_code = p_uart->p_ops->receive(p_uart, pData, nSize, pSize);
+
+	UART_DRV_STATS_ADD(p_uart->stats.rx_calls, 1);
+
+	if (!err_code)
+	{
+		UART_DRV_STATS_ADD(p_uart->stats.rx_bytes, *pSize);
+
+		uart_rec_event(p_uart, 'R', pData, *pSize);
+	}
+	else
+		uart_rec_event(p_uart, 'E', NULL, 0);
+
+	return err_code;
+}
+
+int uart_drv_get_serial(uart_drv_t *p_uart, char *p_serial, size_t nSize)
+{
+	if (p_uart->p_ops->get_serial == NULL)
+		return 1;
+
+	return p_uart->p_ops->get_serial(p_uart, p_serial, nSize);
+}
+
+int uart_drv_get_key(uart_drv_t *p_uart, char *p_key, size_t nSize)
+{
+	int err_code;
+
+	// the port may not be open yet
+	uart_drv_select(p_uart);
+
+	err_code = uart_drv_get_serial(p_uart, p_key, nSize);
+
+	if (err_code)
+	{
+		strncpy(p_key, p_uart->p_PortName, nSize - 1);
+		p_key[nSize - 1] = '\0';
+	}
+	// keys are single words
+	p_key[strcspn(p_key, " \t")] = '\0';
+
+	return err_code;
+}
+
+void uart_drv_sleep(uart_drv_t *p_uart, uint64_t time_us)
+{
+	if (p_uart->p_ops->sleep != NULL)
+		p_uart->p_ops->sleep(p_uart, time_us);
+	else
+		sys_sleep_us(time_us);
+}
+
+int uart_drv_set_baud(uart_drv_t *p_uart, uint32_t baud_rate)
+{
+	int err_code = 0;
+
+	if (p_uart->p_ops->set_baud == NULL)
+	{
+		logger_error("Port does not support setting the bit rate!");
+
+		err_code = 1;
+	}
+	else
+	{
+		err_code = p_uart->p_ops->set_baud(p_uart, baud_rate);
+
+		if (!err_code)
+			p_uart->baud_rate = baud_rate;
+	}
+
+	return err_code;
+}
@@ -44,6 +44,7 @@
 #define _INC_UART_DRV
 
 #include <stdint.h>
+#include <stdio.h>
 #ifdef WIN32
 #include <windows.h>
 #endif
@@ -53,15 +54,104 @@ extern "C" {
 #endif  /* __cplusplus */
 
 
+// default bit rate of the serial link
+#define UART_DRV_BAUD_RATE_DEF      115200
+
+// maximum number of gather elements sent at once
+#define UART_DRV_IOV_MAX            64
+
+typedef struct uart_drv_s uart_drv_t;
+
+// the RX counters are updated by the RX thread and the protocol at once, and read during the transfer
+#ifdef WIN32
+#define UART_DRV_STATS_ADD(counter, n)  ((counter) += (n))
+#define UART_DRV_STATS_GET(counter)     (counter)
+#else
+#define UART_DRV_STATS_ADD(counter, n)  __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+#define UART_DRV_STATS_GET(counter)     __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+#endif
+
+/**
+* @brief Port I/O counters.
+*/
+typedef struct {
+	uint32_t tx_calls;                  //!< Backend write calls.
+	uint32_t rx_calls;                  //!< Backend read calls.
+	uint32_t tx_frames;                 //!< SLIP frames sent.
+	uint64_t tx_bytes;                  //!< Bytes written.
+	uint64_t rx_bytes;                  //!< Bytes read.
+	uint32_t rx_dropped;                //!< Malformed SLIP frames dropped, in resync mode.
+	uint64_t rx_discarded;              //!< Bytes of the frames dropped and of the data skipped to resync.
+} uart_drv_stats_t;
+
+/**
+* @brief Gather element for sending.
+*/
 typedef struct {
+	const uint8_t *pData;               //!< Element data.
+	uint32_t nSize;                     //!< Element size.
+} uart_drv_iov_t;
+
+/**
+* @brief Transport backend operations.
+*/
+typedef struct {
+	const char *p_prefix;               //!< Port name prefix selecting the backend, NULL for the default backend.
+
+	int (*open)(uart_drv_t *p_uart);
+	int (*close)(uart_drv_t *p_uart);
+	int (*send)(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
+	int (*send_v)(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount);     //!< Optional, one write for all elements.
+	int (*receive)(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize);
+	int (*set_baud)(uart_drv_t *p_uart, uint32_t baud_rate);
+	int (*get_serial)(uart_drv_t *p_uart, char *p_serial, size_t nSize);   //!< Optional, serial number of the USB device.
+	void (*sleep)(uart_drv_t *p_uart, uint64_t time_us);   //!< Optional, wait on the clock of the link rather than the system clock.
+} uart_drv_ops_t;
+
+struct uart_drv_s {
 	const char *p_PortName;
+	const char *p_RecordName;           //!< Session record file name, if any.
+	const char *p_ProfileName;          //!< Link profile file name, the link is auto-tuned if set.
+	const char *p_EtaLogName;           //!< Predicted and actual transfer times are appended to it, if set.
+	const char *p_JournalName;          //!< Transfer journal file name, interrupted transfers are resumed if set.
+	int replay_realtime;                //!< Replay at recorded speed instead of as fast as possible.
+	uint32_t baud_rate;                 //!< Bit rate, 0 for the default.
+	uint32_t tx_batch_size;             //!< SLIP TX batch budget in bytes, 0 for one write per frame.
+	uint32_t frame_size_cap;            //!< Host cap of the frames sent, in decoded bytes, 0 for the default.
+	uint32_t target_timeout_ms;         //!< Shortest bootloader timeout, 0 for the SDK default.
+	uint32_t keepalive_percent;         //!< The target is pinged once the link is idle for this share of its timeout, 0 for never.
+	int rx_thread;                      //!< Frames are received by a thread of their own, on a TTY port.
+	int slip_resync;                    //!< Malformed frames and line noise are dropped, the decoder resyncs on the next SLIP_END.
+	void (*p_progress)(void *p_context, uint32_t offset, uint32_t size, uint64_t eta_us);  //!< Optional, called as each firmware frame is sent.
+	void *p_progress_context;           //!< Progress callback context.
+	volatile int *p_cancel;             //!< Optional, the transfer stops once it is set.
+
+	const uart_drv_ops_t *p_ops;        //!< Backend selected by the port name.
+	const char *p_addr;                 //!< Port name without the backend prefix.
+	void *p_priv;                       //!< Backend private data.
 
 #ifdef WIN32
 	HANDLE portHandle;
 #else
 	int tty_fd;
 #endif
-} uart_drv_t;
+
+	FILE *p_rec_file;                   //!< Session record file.
+	uint64_t rec_time_us;               //!< Time of the last recorded event.
+
+	struct uart_slip_s *p_slip;         //!< SLIP layer state.
+	struct dfu_serial_s *p_dfu;         //!< DFU protocol state.
+	struct journal_s *p_journal;        //!< Transfer journal, while a package is sent.
+	uart_drv_stats_t stats;             //!< I/O counters.
+};
+
+extern const uart_drv_ops_t uart_tty_ops;
+extern const uart_drv_ops_t uart_replay_ops;
+extern const uart_drv_ops_t uart_sim_ops;
+#ifndef WIN32
+extern const uart_drv_ops_t uart_tcp_ops;
+extern const uart_drv_ops_t uart_rfc2217_ops;
+#endif
 
 
 int uart_drv_open(uart_drv_t *p_uart);
@@ -70,8 +160,28 @@ int uart_drv_close(uart_drv_t *p_uart);
 
 int uart_drv_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
 
+// send up to UART_DRV_IOV_MAX elements, each is recorded as a separate write
+int uart_drv_send_v(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount);
+
 int uart_drv_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize);
 
+int uart_drv_set_baud(uart_drv_t *p_uart, uint32_t baud_rate);
+
+// get the serial number of the USB device behind the port, if known
+int uart_drv_get_serial(uart_drv_t *p_uart, char *p_serial, size_t nSize);
+
+// get the key of the device in the profile and journal files: its serial number, or else the port name;
+// returns 0 if the key is the serial number, identifying the device itself
+int uart_drv_get_key(uart_drv_t *p_uart, char *p_key, size_t nSize);
+
+// wait, on the virtual clock of a simulated or replayed link
+void uart_drv_sleep(uart_drv_t *p_uart, uint64_t time_us);
+
+#ifndef WIN32
+// restore the settings of the TTY ports open, async-signal-safe for a handler ending the process
+void uart_tty_restore_all(void);
+#endif
+
 
 #ifdef __cplusplus
 }   /* ... extern "C" */
@@ -40,29 +40,107 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <termios.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "uart_drv.h"
 #include "logging.h"
 
-int uart_drv_open(uart_drv_t *p_uart)
+// maximum number of TTY ports whose settings a signal handler restores
+#define UART_TTY_OPEN_MAX           64
+
+// TTY settings found when the port was opened, they are restored on close
+typedef struct
+{
+	int state;                          //!< Slot free, claimed or holding an open port.
+	int fd;                             //!< Port file descriptor.
+	struct termios saved;               //!< Settings before the port was opened.
+} uart_tty_t;
+
+enum
+{
+	UART_TTY_FREE,
+	UART_TTY_CLAIMED,
+	UART_TTY_OPEN
+};
+
+// the settings are kept out of the heap, where a signal handler may read them at any time
+static uart_tty_t tty_open[UART_TTY_OPEN_MAX];
+
+static int uart_tty_open(uart_drv_t *p_uart);
+static int uart_tty_close(uart_drv_t *p_uart);
+static int uart_tty_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
+static int uart_tty_send_v(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount);
+static int uart_tty_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize);
+static int uart_tty_set_baud(uart_drv_t *p_uart, uint32_t baud_rate);
+static int uart_tty_get_serial(uart_drv_t *p_uart, char *p_serial, size_t nSize);
+
+const uart_drv_ops_t uart_tty_ops =
+{
+	NULL,
+	uart_tty_open,
+	uart_tty_close,
+	uart_tty_send,
+	uart_tty_send_v,
+	uart_tty_receive,
+	uart_tty_set_baud,
+	uart_tty_get_serial,
+	NULL
+};
+
+// map a bit rate to a termios speed
+static speed_t uart_tty_speed(uint32_t baud_rate)
+{
+	switch (baud_rate)
+	{
+	case 9600:    return B9600;
+	case 19200:   return B19200;
+	case 38400:   return B38400;
+	case 57600:   return B57600;
+	case 115200:  return B115200;
+	case 230400:  return B230400;
+#ifdef B460800
+	case 460800:  return B460800;
+#endif
+#ifdef B921600
+	case 921600:  return B921600;
+#endif
+#ifdef B1000000
+	case 1000000: return B1000000;
+#endif
+	default:      return B0;
+	}
+}
+
+static int uart_tty_open(uart_drv_t *p_uart)
 {
 	int err_code = 0;
 	int fd = -1;
-	const char *tty_name = p_uart->p_PortName;
-	char tty_path[20];
+	const char *tty_name = p_uart->p_addr;
+	char tty_path[PATH_MAX];
+	speed_t speed;
 	struct termios options;
 
-	strcpy(tty_path, "/dev/");
-	if (strlen(tty_name) <= 14)
-		strcat(tty_path, tty_name);
-	else
+	// accept both absolute paths and names relative to /dev
+	if (snprintf(tty_path, sizeof(tty_path), "%s%s", (tty_name[0] == '/') ? "" : "/dev/", tty_name) >= (int)sizeof(tty_path))
 	{
 		logger_error("Invalid TTY port!");
 
 		err_code = 1;
 	}
 
+	speed = uart_tty_speed(p_uart->baud_rate ? p_uart->baud_rate : UART_DRV_BAUD_RATE_DEF);
+	if (speed == B0)
+	{
+		logger_error("Unsupported TTY bit rate!");
+
+		err_code = 1;
+	}
+
 	if (!err_code)
 	{
 		fd = open(tty_path, O_RDWR | O_NOCTTY);
@@ -75,14 +153,41 @@ int uart_drv_open(uart_drv_t *p_uart)
 		}
 	}
 
+	if (!err_code)
+	{
+		uart_tty_t *p_tty = NULL;
+		int expected;
+		int n;
+
+		for (n = 0; p_tty == NULL && n < UART_TTY_OPEN_MAX; n++)
+		{
+			expected = UART_TTY_FREE;
+
+			if (__atomic_compare_exchange_n(&tty_open[n].state, &expected, UART_TTY_CLAIMED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+				p_tty = tty_open + n;
+		}
+
+		if (p_tty != NULL && !tcgetattr(fd, &p_tty->saved))
+		{
+			p_tty->fd = fd;
+			__atomic_store_n(&p_tty->state, UART_TTY_OPEN, __ATOMIC_RELEASE);
+
+			p_uart->p_priv = p_tty;
+		}
+		else if (p_tty != NULL)
+		{
+			__atomic_store_n(&p_tty->state, UART_TTY_FREE, __ATOMIC_RELEASE);
+		}
+	}
+
 	if (!err_code)
 	{
 		// clear all flags
 		memset(&options, 0, sizeof(options));
 
-		// 115200bps
-		cfsetispeed(&options, B115200);
-		cfsetospeed(&options, B115200);
+		// 115200bps by default
+		cfsetispeed(&options, speed);
+		cfsetospeed(&options, speed);
 		// 8N1
 		options.c_cflag &= ~PARENB;
 		options.c_cflag &= ~CSTOPB;
@@ -127,7 +232,7 @@ int uart_drv_open(uart_drv_t *p_uart)
 	if (err_code && fd >= 0)
 	{
 		p_uart->tty_fd = fd;
-		uart_drv_close(p_uart);
+		uart_tty_close(p_uart);
 
 		fd = -1;
 	}
@@ -137,13 +242,22 @@ int uart_drv_open(uart_drv_t *p_uart)
 	return err_code;
 }
 
-int uart_drv_close(uart_drv_t *p_uart)
+static int uart_tty_close(uart_drv_t *p_uart)
 {
 	int err_code = 0;
 	int fd = p_uart->tty_fd;
+	uart_tty_t *p_tty = (uart_tty_t *)p_uart->p_priv;
 
 	if (fd >= 0)
 	{
+		// the port is left as it was found, for the next user
+		if (p_tty != NULL)
+		{
+			__atomic_store_n(&p_tty->state, UART_TTY_CLAIMED, __ATOMIC_RELEASE);
+
+			tcsetattr(fd, TCSANOW, &p_tty->saved);
+		}
+
 		if (close(fd))
 		{
 			logger_error("Cannot close TTY port!");
@@ -153,25 +267,76 @@ int uart_drv_close(uart_drv_t *p_uart)
 	}
 	else
 		err_code = 1;
+
+	if (p_tty != NULL)
+		__atomic_store_n(&p_tty->state, UART_TTY_FREE, __ATOMIC_RELEASE);
+
+	p_uart->p_priv = NULL;
 	
 	return err_code;
 }
 
-int uart_drv_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+// wait for the data written to go out, a signal does not stop the wait
+static int uart_tty_drain(int fd)
+{
+	int err_code;
+
+	do
+	{
+		err_code = tcdrain(fd);
+	} while (err_code && errno == EINTR);
+
+	return err_code;
+}
+
+void uart_tty_restore_all(void)
+{
+	int n;
+
+	// tcsetattr() is async-signal-safe, a port being closed is restored by its close
+	for (n = 0; n < UART_TTY_OPEN_MAX; n++)
+	{
+		if (__atomic_load_n(&tty_open[n].state, __ATOMIC_ACQUIRE) == UART_TTY_OPEN)
+			tcsetattr(tty_open[n].fd, TCSANOW, &tty_open[n].saved);
+	}
+}
+
+// a write interrupted by the signal cancelling the transfer ends it, the signal is not a port error
+static int uart_tty_is_cancelled(uart_drv_t *p_uart)
+{
+	return errno == EINTR && p_uart->p_cancel != NULL && *p_uart->p_cancel;
+}
+
+static int uart_tty_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
 {
 	int err_code = 0;
-	int32_t length;
+	ssize_t length;
 
-	length = write(p_uart->tty_fd, pData, nSize);
-	if (length != nSize)
+	while (nSize > 0)
 	{
-		logger_error("Cannot write TTY port!");
+		length = write(p_uart->tty_fd, pData, nSize);
 
-		err_code = 1;
+		if (length < 0 && uart_tty_is_cancelled(p_uart))
+			return 1;
+
+		if (length < 0 && errno == EINTR)
+			continue;
+
+		if (length < 0)
+		{
+			logger_error("Cannot write TTY port!");
+
+			err_code = 1;
+			break;
+		}
+
+		pData += length;
+		nSize -= (uint32_t)length;
 	}
-	else
+
+	if (!err_code)
 	{
-		if (tcdrain(p_uart->tty_fd))
+		if (uart_tty_drain(p_uart->tty_fd))
 		{
 			logger_error("Cannot drain TTY TX buffer!");
 
@@ -182,12 +347,76 @@ int uart_drv_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
 	return err_code;
 }
 
-int uart_drv_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
+static int uart_tty_send_v(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount)
+{
+	int err_code = 0;
+	struct iovec iov[UART_DRV_IOV_MAX];
+	struct iovec *p_iov = iov;
+	uint32_t n;
+
+	for (n = 0; n < nCount; n++)
+	{
+		iov[n].iov_base = (void *)(pIov + n)->pData;
+		iov[n].iov_len = (pIov + n)->nSize;
+	}
+
+	while (nCount > 0)
+	{
+		ssize_t length = writev(p_uart->tty_fd, p_iov, nCount);
+
+		if (length < 0 && uart_tty_is_cancelled(p_uart))
+			return 1;
+
+		if (length < 0 && errno == EINTR)
+			continue;
+
+		if (length < 0)
+		{
+			logger_error("Cannot write TTY port!");
+
+			err_code = 1;
+			break;
+		}
+
+		// skip the elements written, then continue a partial one
+		while (nCount > 0 && (size_t)length >= p_iov->iov_len)
+		{
+			length -= p_iov->iov_len;
+			p_iov++;
+			nCount--;
+		}
+
+		if (nCount > 0)
+		{
+			p_iov->iov_base = (uint8_t *)p_iov->iov_base + length;
+			p_iov->iov_len -= length;
+		}
+	}
+
+	if (!err_code)
+	{
+		if (uart_tty_drain(p_uart->tty_fd))
+		{
+			logger_error("Cannot drain TTY TX buffer!");
+
+			err_code = 1;
+		}
+	}
+
+	return err_code;
+}
+
+static int uart_tty_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
 {
 	int err_code = 0;
 	int32_t length;
 	
 	length = read(p_uart->tty_fd, pData, nSize);
+
+	// a signal ends the wait for data, as the read timeout does
+	if (length < 0 && errno == EINTR)
+		length = 0;
+
 	if (length < 0)
 	{
 		logger_error("Cannot read TTY port!");
@@ -199,3 +428,93 @@ int uart_drv_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_
 	
 	return err_code;
 }
+
+static int uart_tty_set_baud(uart_drv_t *p_uart, uint32_t baud_rate)
+{
+	int err_code = 0;
+	speed_t speed = uart_tty_speed(baud_rate);
+	struct termios options;
+
+	if (speed == B0)
+	{
+		logger_error("Unsupported TTY bit rate!");
+
+		err_code = 1;
+	}
+	else if (tcgetattr(p_uart->tty_fd, &options))
+	{
+		logger_error("Cannot get TTY options!");
+
+		err_code = 1;
+	}
+	else
+	{
+		cfsetispeed(&options, speed);
+		cfsetospeed(&options, speed);
+
+		if (tcsetattr(p_uart->tty_fd, TCSADRAIN, &options))
+		{
+			logger_error("Cannot set TTY options!");
+
+			err_code = 1;
+		}
+	}
+
+	return err_code;
+}
+
+// the serial number is an attribute of the USB device, a few levels above the TTY device in sysfs
+static int uart_tty_get_serial(uart_drv_t *p_uart, char *p_serial, size_t nSize)
+{
+	int err_code = 1;
+	char tty_path[PATH_MAX];
+	char sys_path[PATH_MAX + 16];
+	char dev_path[PATH_MAX];
+	const char *p_name;
+	char *p_sep;
+	FILE *p_file;
+	int level;
+
+	// /dev/serial/by-id/... links resolve to the TTY device
+	if (p_uart->p_addr[0] == '/')
+	{
+		if (realpath(p_uart->p_addr, tty_path) == NULL)
+			return 1;
+	}
+	else
+	{
+		snprintf(tty_path, sizeof(tty_path), "/dev/%s", p_uart->p_addr);
+	}
+
+	p_name = strrchr(tty_path, '/') + 1;
+
+	snprintf(sys_path, sizeof(sys_path), "/sys/class/tty/%s/device", p_name);
+	if (realpath(sys_path, dev_path) == NULL)
+		return 1;
+
+	for (level = 0; err_code && level < 4; level++)
+	{
+		snprintf(sys_path, sizeof(sys_path), "%s/serial", dev_path);
+
+		p_file = fopen(sys_path, "r");
+		if (p_file != NULL)
+		{
+			if (fgets(p_serial, (int)nSize, p_file) != NULL)
+			{
+				p_serial[strcspn(p_serial, "\r\n")] = '\0';
+
+				err_code = p_serial[0] ? 0 : 1;
+			}
+
+			fclose(p_file);
+		}
+
+		p_sep = strrchr(dev_path, '/');
+		if (p_sep == NULL || p_sep == dev_path)
+			break;
+
+		*p_sep = '\0';
+	}
+
+	return err_code;
+}
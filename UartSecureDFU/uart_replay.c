@@ -0,0 +1,356 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uart_replay.h"
+#include "sys_time.h"
+#include "logging.h"
+
+#define REC_FILE_HEADER         "# UartSecureDFU session record v1"
+
+typedef struct {
+	FILE *p_file;                       //!< Session record file.
+	uint64_t time_us;                   //!< Time of the last replayed event.
+	uint8_t *p_data;                    //!< Data of the last replayed event.
+	uint32_t size;                      //!< Size of the last replayed event.
+	uint32_t pos;                       //!< Position in the last replayed event data.
+	uint32_t event;                     //!< Number of replayed events.
+} uart_replay_t;
+
+static int uart_replay_open(uart_drv_t *p_uart);
+static int uart_replay_close(uart_drv_t *p_uart);
+static int uart_replay_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
+static int uart_replay_send_v(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount);
+static int uart_replay_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize);
+static void uart_replay_sleep(uart_drv_t *p_uart, uint64_t time_us);
+
+const uart_drv_ops_t uart_replay_ops =
+{
+	UART_REPLAY_PREFIX,
+	uart_replay_open,
+	uart_replay_close,
+	uart_replay_send,
+	uart_replay_send_v,
+	uart_replay_receive,
+	NULL,
+	NULL,
+	uart_replay_sleep
+};
+
+int uart_rec_start(uart_drv_t *p_uart)
+{
+	int err_code = 0;
+
+	p_uart->p_rec_file = fopen(p_uart->p_RecordName, "w");
+
+	if (p_uart->p_rec_file == NULL)
+	{
+		logger_error("Cannot create session record file!");
+
+		err_code = 1;
+	}
+	else
+	{
+		fprintf(p_uart->p_rec_file, "%s\n", REC_FILE_HEADER);
+
+		p_uart->rec_time_us = sys_time_us();
+	}
+
+	return err_code;
+}
+
+int uart_rec_stop(uart_drv_t *p_uart)
+{
+	int err_code = 0;
+
+	if (p_uart->p_rec_file != NULL)
+	{
+		if (fclose(p_uart->p_rec_file))
+		{
+			logger_error("Cannot write session record file!");
+
+			err_code = 1;
+		}
+
+		p_uart->p_rec_file = NULL;
+	}
+
+	return err_code;
+}
+
+void uart_rec_event(uart_drv_t *p_uart, char dir, const uint8_t *pData, uint32_t nSize)
+{
+	uint64_t time_us = sys_time_us();
+	uint32_t n;
+
+	if (p_uart->p_rec_file == NULL)
+		return;
+
+	fprintf(p_uart->p_rec_file, "%c %lu %u ", dir, (unsigned long)(time_us - p_uart->rec_time_us), nSize);
+
+	for (n = 0; n < nSize; n++)
+		fprintf(p_uart->p_rec_file, "%02x", *(pData + n));
+
+	fputc('\n', p_uart->p_rec_file);
+
+	p_uart->rec_time_us = time_us;
+}
+
+// read the next recorded event into the replay data buffer
+static int uart_replay_next(uart_replay_t *p_rpl, char *p_dir, int realtime)
+{
+	int err_code = 0;
+	unsigned long delta_us;
+	unsigned int size, byte;
+	uint32_t n;
+
+	if (fscanf(p_rpl->p_file, " %c %lu %u", p_dir, &delta_us, &size) != 3)
+	{
+		logger_error("Replay ended at event %u!", p_rpl->event);
+
+		return 1;
+	}
+
+	if (size > 0)
+	{
+		uint8_t *p_data = (uint8_t *)realloc(p_rpl->p_data, size);
+
+		if (p_data == NULL)
+		{
+			logger_error("Cannot allocate replay buffer!");
+
+			return 1;
+		}
+
+		p_rpl->p_data = p_data;
+	}
+
+	for (n = 0; n < size; n++)
+	{
+		if (fscanf(p_rpl->p_file, "%2x", &byte) != 1)
+		{
+			logger_error("Corrupted replay event %u!", p_rpl->event);
+
+			err_code = 1;
+			break;
+		}
+
+		*(p_rpl->p_data + n) = (uint8_t)byte;
+	}
+
+	p_rpl->size = size;
+	p_rpl->pos = 0;
+	p_rpl->event++;
+
+	if (!err_code && realtime)
+	{
+		uint64_t time_us = sys_time_us();
+
+		// keep the recorded inter-arrival timing
+		p_rpl->time_us += delta_us;
+
+		if (p_rpl->time_us > time_us)
+			sys_sleep_us(p_rpl->time_us - time_us);
+	}
+
+	return err_code;
+}
+
+static int uart_replay_open(uart_drv_t *p_uart)
+{
+	int err_code = 0;
+	uart_replay_t *p_rpl;
+	char header[64];
+
+	p_rpl = (uart_replay_t *)calloc(1, sizeof(uart_replay_t));
+
+	if (p_rpl == NULL)
+	{
+		logger_error("Cannot allocate replay state!");
+
+		return 1;
+	}
+
+	p_uart->p_priv = p_rpl;
+
+	p_rpl->p_file = fopen(p_uart->p_addr, "r");
+
+	if (p_rpl->p_file == NULL)
+	{
+		logger_error("Cannot open session record file!");
+
+		err_code = 1;
+	}
+	else if (fgets(header, sizeof(header), p_rpl->p_file) == NULL ||
+		strncmp(header, REC_FILE_HEADER, strlen(REC_FILE_HEADER)))
+	{
+		logger_error("Invalid session record file!");
+
+		err_code = 1;
+	}
+
+	if (err_code)
+		uart_replay_close(p_uart);
+	else
+		p_rpl->time_us = sys_time_us();
+
+	return err_code;
+}
+
+static int uart_replay_close(uart_drv_t *p_uart)
+{
+	int err_code = 0;
+	uart_replay_t *p_rpl = (uart_replay_t *)p_uart->p_priv;
+
+	if (p_rpl != NULL && p_rpl->p_file != NULL)
+		fclose(p_rpl->p_file);
+	else
+		err_code = 1;
+
+	if (p_rpl != NULL)
+	{
+		if (p_rpl->p_data != NULL)
+			free(p_rpl->p_data);
+
+		free(p_rpl);
+
+		p_uart->p_priv = NULL;
+	}
+
+	return err_code;
+}
+
+static int uart_replay_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+{
+	int err_code;
+	uart_replay_t *p_rpl = (uart_replay_t *)p_uart->p_priv;
+	char dir;
+
+	if (p_rpl->pos < p_rpl->size)
+	{
+		logger_error("Replay diverged at event %u (unread data)!", p_rpl->event);
+
+		return 1;
+	}
+
+	err_code = uart_replay_next(p_rpl, &dir, p_uart->replay_realtime);
+
+	if (!err_code)
+	{
+		if (dir != 'T' || p_rpl->size != nSize || memcmp(p_rpl->p_data, pData, nSize))
+		{
+			logger_error("Replay diverged at event %u!", p_rpl->event);
+
+			err_code = 1;
+		}
+
+		// sent data is not returned by receive
+		p_rpl->pos = p_rpl->size;
+	}
+
+	return err_code;
+}
+
+// frames are recorded one by one, whatever the batching
+static int uart_replay_send_v(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount)
+{
+	int err_code = 0;
+	uint32_t n;
+
+	for (n = 0; !err_code && n < nCount; n++)
+		err_code = uart_replay_send(p_uart, (pIov + n)->pData, (pIov + n)->nSize);
+
+	return err_code;
+}
+
+static int uart_replay_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
+{
+	int err_code = 0;
+	uart_replay_t *p_rpl = (uart_replay_t *)p_uart->p_priv;
+	uint32_t length;
+
+	if (p_rpl->pos >= p_rpl->size)
+	{
+		char dir;
+
+		err_code = uart_replay_next(p_rpl, &dir, p_uart->replay_realtime);
+
+		if (!err_code)
+		{
+			if (dir == 'E')
+			{
+				logger_error("Cannot read replay port!");
+
+				err_code = 1;
+			}
+			else if (dir != 'R')
+			{
+				logger_error("Replay diverged at event %u!", p_rpl->event);
+
+				err_code = 1;
+			}
+		}
+	}
+
+	if (!err_code)
+	{
+		length = p_rpl->size - p_rpl->pos;
+		if (length > nSize)
+			length = nSize;
+
+		if (length > 0)
+			memcpy(pData, p_rpl->p_data + p_rpl->pos, length);
+
+		p_rpl->pos += length;
+
+		*pSize = length;
+	}
+
+	return err_code;
+}
+
+static void uart_replay_sleep(uart_drv_t *p_uart, uint64_t time_us)
+{
+	// the recorded timing is kept by the reads, the wait is already in it
+	(void)p_uart;
+	(void)time_us;
+}
@@ -0,0 +1,1059 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uart_drv.h"
+#include "uart_sim.h"
+#include "slip_enc.h"
+#include "crc32.h"
+#include "init_packet.h"
+#include "logging.h"
+
+// read timeout, the same as the TTY backend
+#define UART_SIM_READ_TIMEOUT_US    500000
+
+// target limits, as the nRF5 SDK serial DFU bootloader
+#define UART_SIM_MTU_DEF            131
+#define UART_SIM_CMD_SIZE_MAX       512
+#define UART_SIM_DATA_SIZE_MAX      4096
+#define UART_SIM_FW_SIZE_MAX        (1024 * 1024)
+
+// decoded request and response buffers
+#define UART_SIM_REQ_SIZE_MAX       1024
+#define UART_SIM_RSP_SIZE_MAX       32
+
+// responses the target may hold before its TX is overrun
+#define UART_SIM_QUEUE_LEN          64
+
+// DFU opcodes and result codes used by the target
+#define SIM_OP_CREATE               0x01
+#define SIM_OP_RECEIPT_NOTIF_SET    0x02
+#define SIM_OP_CRC_GET              0x03
+#define SIM_OP_EXECUTE              0x04
+#define SIM_OP_SELECT               0x06
+#define SIM_OP_MTU_GET              0x07
+#define SIM_OP_WRITE                0x08
+#define SIM_OP_PING                 0x09
+#define SIM_OP_HARDWARE_VERSION     0x0A
+#define SIM_OP_FIRMWARE_VERSION     0x0B
+#define SIM_OP_ABORT                0x0C
+#define SIM_OP_RESPONSE             0x60
+
+#define SIM_RES_SUCCESS             0x01
+#define SIM_RES_OP_NOT_SUPPORTED    0x02
+#define SIM_RES_INVALID_PARAMETER   0x03
+#define SIM_RES_NO_RESOURCES        0x04
+#define SIM_RES_NOT_PERMITTED       0x08
+#define SIM_RES_UNSUPPORTED_TYPE    0x07
+
+#define SIM_OBJ_COMMAND             0x01
+#define SIM_OBJ_DATA                0x02
+
+// firmware types reported by FIRMWARE_VERSION
+#define SIM_FW_SOFTDEVICE           0x00
+#define SIM_FW_APPLICATION          0x01
+#define SIM_FW_BOOTLOADER           0x02
+#define SIM_FW_NUM                  3
+#define SIM_FW_NONE                 0xFF
+
+// flash addresses of the images installed, as on an nRF52832 with S132
+#define SIM_ADDR_SOFTDEVICE         0x00001000
+#define SIM_ADDR_APPLICATION        0x00026000
+#define SIM_ADDR_BOOTLOADER         0x00078000
+
+// SoftDevice information structure, its version is reported
+#define SIM_SD_INFO_MAGIC_OFFSET    0x2004
+#define SIM_SD_INFO_VERSION_OFFSET  0x2014
+#define SIM_SD_INFO_MAGIC           0x51B1E5DB
+
+/**
+* @brief Response frame on its way to the host.
+*/
+typedef struct {
+	uint8_t data[UART_SIM_RSP_SIZE_MAX * 2 + 1];    //!< Encoded frame.
+	uint32_t size;                      //!< Encoded frame size.
+	uint32_t pos;                       //!< Bytes already read by the host.
+	uint64_t ready_us;                  //!< Virtual time the last byte is received.
+} uart_sim_rsp_t;
+
+/**
+* @brief Firmware image installed on the target.
+*/
+typedef struct {
+	int present;                        //!< Image installed.
+	uint32_t version;                   //!< Firmware version.
+	uint32_t addr;                      //!< Start address.
+	uint32_t len;                       //!< Image length.
+} uart_sim_fw_t;
+
+typedef struct {
+	double flip;                        //!< Bit flip rate per frame.
+	double drop;                        //!< Lost frame rate.
+	double dup;                         //!< Duplicated frame rate.
+	double delay;                       //!< Delayed response rate.
+	double reset;                       //!< Target reset rate per write frame.
+	uint32_t delay_us;                  //!< Delay of a delayed response.
+	uint32_t mtu;                       //!< MTU reported by the target.
+	uint32_t turnaround_us;             //!< Target processing time of a request.
+	uint32_t flash_us;                  //!< Time to execute a data object.
+	uint32_t verify_us;                 //!< Time to execute an init packet.
+	uint32_t boot_us;                   //!< Time the target is deaf after a reset.
+	uint64_t rng;                       //!< Fault generator state.
+
+	uint64_t time_us;                   //!< Virtual clock.
+	uint64_t tx_free_us;                //!< Time the target's TX line is free.
+	uint64_t boot_end_us;               //!< Time the target is up again after a reset.
+
+	uint8_t req[UART_SIM_REQ_SIZE_MAX]; //!< Request being decoded.
+	uint32_t req_len;                   //!< Size of the request decoded so far.
+	int req_esc;                        //!< SLIP escape pending.
+	int req_bad;                        //!< Request corrupted, skipped up to the next frame end.
+
+	uart_sim_rsp_t rsp[UART_SIM_QUEUE_LEN];     //!< Responses queued.
+	uint32_t rsp_head;                  //!< First response queued.
+	uint32_t rsp_cnt;                   //!< Number of responses queued.
+
+	uint16_t prn;                       //!< Packet receipt notification interval.
+	uint16_t prn_cnt;                   //!< Write frames since the last notification.
+	uint8_t obj_type;                   //!< Object selected or created last.
+	uint8_t cmd[UART_SIM_CMD_SIZE_MAX]; //!< Init packet.
+	uint32_t cmd_len;                   //!< Init packet bytes received.
+	uint32_t cmd_size;                  //!< Init packet object size.
+	int cmd_valid;                      //!< Init packet executed.
+	init_packet_t init;                 //!< Init packet executed, parsed.
+	int init_valid;                     //!< Init packet parsed.
+	uint8_t *p_fw;                      //!< Firmware image.
+	uint32_t fw_len;                    //!< Firmware bytes received.
+	uint32_t fw_crc;                    //!< CRC of the firmware bytes received.
+	uint32_t fw_done;                   //!< Firmware bytes of the objects executed.
+	uint32_t fw_done_crc;               //!< CRC of the firmware bytes of the objects executed.
+	uint32_t obj_end;                   //!< End of the data object in progress.
+
+	uart_sim_fw_t installed[SIM_FW_NUM];    //!< Images installed, by firmware type.
+	char *p_state_file;                 //!< File keeping the images installed from one run to the next.
+
+	uart_sim_faults_t faults;           //!< Faults injected.
+} uart_sim_t;
+
+static int uart_sim_open(uart_drv_t *p_uart);
+static int uart_sim_close(uart_drv_t *p_uart);
+static int uart_sim_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
+static int uart_sim_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize);
+static int uart_sim_set_baud(uart_drv_t *p_uart, uint32_t baud_rate);
+static void uart_sim_sleep(uart_drv_t *p_uart, uint64_t time_us);
+
+const uart_drv_ops_t uart_sim_ops =
+{
+	UART_SIM_PREFIX,
+	uart_sim_open,
+	uart_sim_close,
+	uart_sim_send,
+	NULL,
+	uart_sim_receive,
+	uart_sim_set_baud,
+	NULL,
+	uart_sim_sleep
+};
+
+static uint64_t uart_sim_rand(uart_sim_t *p_sim)
+{
+	// xorshift64*, the faults are the same for the same seed
+	p_sim->rng ^= p_sim->rng >> 12;
+	p_sim->rng ^= p_sim->rng << 25;
+	p_sim->rng ^= p_sim->rng >> 27;
+
+	return p_sim->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static int uart_sim_chance(uart_sim_t *p_sim, double rate)
+{
+	if (rate <= 0.0)
+		return 0;
+
+	return (double)(uart_sim_rand(p_sim) >> 11) * (1.0 / 9007199254740992.0) < rate;
+}
+
+static void uart_sim_flip(uart_sim_t *p_sim, uint8_t *p_data, uint32_t size)
+{
+	uint64_t r = uart_sim_rand(p_sim);
+
+	*(p_data + (uint32_t)(r >> 3) % size) ^= (uint8_t)(1 << (r & 7));
+
+	p_sim->faults.flips++;
+}
+
+static uint64_t uart_sim_wire_us(uart_drv_t *p_uart, uint32_t size)
+{
+	uint32_t baud_rate = p_uart->baud_rate ? p_uart->baud_rate : UART_DRV_BAUD_RATE_DEF;
+
+	// start bit, 8 data bits, stop bit
+	return (uint64_t)size * 10 * 1000000 / baud_rate;
+}
+
+static void uart_sim_queue(uart_drv_t *p_uart, const uint8_t *p_frame, uint32_t size, uint64_t ready_us)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uart_sim_rsp_t *p_rsp;
+
+	// the target's TX is overrun, the response is lost
+	if (p_sim->rsp_cnt >= UART_SIM_QUEUE_LEN)
+		return;
+
+	p_rsp = &p_sim->rsp[(p_sim->rsp_head + p_sim->rsp_cnt) % UART_SIM_QUEUE_LEN];
+	memcpy(p_rsp->data, p_frame, size);
+	p_rsp->size = size;
+	p_rsp->pos = 0;
+	p_rsp->ready_us = ready_us;
+
+	p_sim->rsp_cnt++;
+}
+
+static void uart_sim_respond(uart_drv_t *p_uart, uint8_t op, uint8_t result, const uint8_t *p_data, uint32_t size, uint32_t proc_us)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uint8_t rsp[UART_SIM_RSP_SIZE_MAX];
+	uint8_t frame[UART_SIM_RSP_SIZE_MAX * 2 + 1];
+	uint32_t frame_size;
+	uint64_t ready_us;
+
+	rsp[0] = SIM_OP_RESPONSE;
+	rsp[1] = op;
+	rsp[2] = result;
+	if (size > 0)
+		memcpy(rsp + 3, p_data, size);
+
+	encode_slip(frame, &frame_size, rsp, size + 3);
+
+	ready_us = p_sim->time_us + p_sim->turnaround_us + proc_us;
+	if (ready_us < p_sim->tx_free_us)
+		ready_us = p_sim->tx_free_us;
+
+	if (uart_sim_chance(p_sim, p_sim->delay))
+	{
+		ready_us += p_sim->delay_us;
+
+		p_sim->faults.delays++;
+	}
+
+	ready_us += uart_sim_wire_us(p_uart, frame_size);
+	p_sim->tx_free_us = ready_us;
+
+	if (uart_sim_chance(p_sim, p_sim->drop))
+	{
+		p_sim->faults.drops++;
+
+		return;
+	}
+
+	if (uart_sim_chance(p_sim, p_sim->flip))
+		uart_sim_flip(p_sim, frame, frame_size);
+
+	uart_sim_queue(p_uart, frame, frame_size, ready_us);
+
+	if (uart_sim_chance(p_sim, p_sim->dup))
+	{
+		p_sim->tx_free_us += uart_sim_wire_us(p_uart, frame_size);
+
+		uart_sim_queue(p_uart, frame, frame_size, p_sim->tx_free_us);
+
+		p_sim->faults.dups++;
+	}
+}
+
+static void uart_sim_put_u32(uint8_t *p_data, uint32_t value)
+{
+	*p_data++ = (uint8_t)value;
+	*p_data++ = (uint8_t)(value >> 8);
+	*p_data++ = (uint8_t)(value >> 16);
+	*p_data = (uint8_t)(value >> 24);
+}
+
+static uint32_t uart_sim_get_u32(const uint8_t *p_data)
+{
+	return *p_data | (*(p_data + 1) << 8) | (*(p_data + 2) << 16) | ((uint32_t)*(p_data + 3) << 24);
+}
+
+// offset and CRC of the object selected
+static void uart_sim_obj_crc(uart_sim_t *p_sim, uint8_t *p_data)
+{
+	if (p_sim->obj_type == SIM_OBJ_DATA)
+	{
+		uart_sim_put_u32(p_data, p_sim->fw_len);
+		uart_sim_put_u32(p_data + 4, p_sim->fw_crc);
+	}
+	else
+	{
+		uart_sim_put_u32(p_data, p_sim->cmd_len);
+		uart_sim_put_u32(p_data + 4, crc32_compute(p_sim->cmd, p_sim->cmd_len, NULL));
+	}
+}
+
+// the data object in progress is lost, as on a reset or an abort
+static void uart_sim_drop_obj(uart_sim_t *p_sim)
+{
+	p_sim->fw_len = p_sim->fw_done;
+	p_sim->fw_crc = p_sim->fw_done_crc;
+	p_sim->obj_end = p_sim->fw_done;
+
+	if (!p_sim->cmd_valid)
+		p_sim->cmd_len = 0;
+}
+
+static void uart_sim_reset(uart_sim_t *p_sim)
+{
+	uart_sim_drop_obj(p_sim);
+
+	p_sim->prn = 0;
+	p_sim->prn_cnt = 0;
+	p_sim->obj_type = 0;
+	p_sim->req_len = 0;
+	p_sim->req_esc = 0;
+	p_sim->req_bad = 0;
+	p_sim->rsp_cnt = 0;
+	p_sim->tx_free_us = p_sim->time_us;
+	p_sim->boot_end_us = p_sim->time_us + p_sim->boot_us;
+
+	p_sim->faults.resets++;
+}
+
+static void uart_sim_create(uart_drv_t *p_uart, const uint8_t *p_req, uint32_t size)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uint8_t result = SIM_RES_SUCCESS;
+	uint32_t obj_size;
+
+	if (size < 6)
+	{
+		uart_sim_respond(p_uart, SIM_OP_CREATE, SIM_RES_INVALID_PARAMETER, NULL, 0, 0);
+
+		return;
+	}
+
+	obj_size = uart_sim_get_u32(p_req + 2);
+
+	if (*(p_req + 1) == SIM_OBJ_COMMAND)
+	{
+		if (obj_size > UART_SIM_CMD_SIZE_MAX)
+		{
+			result = SIM_RES_NO_RESOURCES;
+		}
+		else
+		{
+			// a new init packet starts the firmware over
+			p_sim->obj_type = SIM_OBJ_COMMAND;
+			p_sim->cmd_len = 0;
+			p_sim->cmd_size = obj_size;
+			p_sim->cmd_valid = 0;
+			p_sim->init_valid = 0;
+			p_sim->fw_done = 0;
+			p_sim->fw_done_crc = 0;
+			uart_sim_drop_obj(p_sim);
+		}
+	}
+	else if (*(p_req + 1) == SIM_OBJ_DATA)
+	{
+		if (!p_sim->cmd_valid)
+		{
+			result = SIM_RES_NOT_PERMITTED;
+		}
+		else if (!obj_size)
+		{
+			result = SIM_RES_INVALID_PARAMETER;
+		}
+		else if (obj_size > UART_SIM_DATA_SIZE_MAX || p_sim->fw_done + obj_size > UART_SIM_FW_SIZE_MAX)
+		{
+			result = SIM_RES_NO_RESOURCES;
+		}
+		else
+		{
+			uint8_t *p_fw = (uint8_t *)realloc(p_sim->p_fw, p_sim->fw_done + obj_size);
+
+			if (p_fw == NULL)
+			{
+				result = SIM_RES_NO_RESOURCES;
+			}
+			else
+			{
+				// a data object in progress is replaced
+				p_sim->p_fw = p_fw;
+				p_sim->obj_type = SIM_OBJ_DATA;
+				uart_sim_drop_obj(p_sim);
+				p_sim->obj_end = p_sim->fw_done + obj_size;
+			}
+		}
+	}
+	else
+	{
+		result = SIM_RES_UNSUPPORTED_TYPE;
+	}
+
+	p_sim->prn_cnt = 0;
+
+	uart_sim_respond(p_uart, SIM_OP_CREATE, result, NULL, 0, 0);
+}
+
+static void uart_sim_write(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t size)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uint8_t rsp[8];
+
+	// data past the end of the object is ignored
+	if (p_sim->obj_type == SIM_OBJ_COMMAND)
+	{
+		if (p_sim->cmd_len + size <= p_sim->cmd_size)
+		{
+			memcpy(p_sim->cmd + p_sim->cmd_len, p_data, size);
+			p_sim->cmd_len += size;
+		}
+	}
+	else if (p_sim->obj_type == SIM_OBJ_DATA)
+	{
+		if (p_sim->fw_len + size <= p_sim->obj_end)
+		{
+			memcpy(p_sim->p_fw + p_sim->fw_len, p_data, size);
+			p_sim->fw_crc = crc32_compute(p_data, size, &p_sim->fw_crc);
+			p_sim->fw_len += size;
+		}
+	}
+
+	p_sim->prn_cnt++;
+
+	if (p_sim->prn && p_sim->prn_cnt >= p_sim->prn)
+	{
+		p_sim->prn_cnt = 0;
+
+		uart_sim_obj_crc(p_sim, rsp);
+		uart_sim_respond(p_uart, SIM_OP_CRC_GET, SIM_RES_SUCCESS, rsp, sizeof(rsp), 0);
+	}
+}
+
+// the images installed survive the port, as the flash of a target survives a reset
+static void uart_sim_load_state(uart_sim_t *p_sim)
+{
+	FILE *p_file;
+	unsigned type, version, addr, len;
+
+	p_file = fopen(p_sim->p_state_file, "r");
+	if (p_file == NULL)
+		return;
+
+	while (fscanf(p_file, "%u %u %x %u", &type, &version, &addr, &len) == 4)
+	{
+		if (type < SIM_FW_NUM)
+		{
+			p_sim->installed[type].present = 1;
+			p_sim->installed[type].version = version;
+			p_sim->installed[type].addr = addr;
+			p_sim->installed[type].len = len;
+		}
+	}
+
+	fclose(p_file);
+}
+
+static void uart_sim_save_state(uart_sim_t *p_sim)
+{
+	FILE *p_file;
+	const uart_sim_fw_t *p_fw;
+	int type;
+
+	p_file = fopen(p_sim->p_state_file, "w");
+	if (p_file == NULL)
+	{
+		logger_error("Cannot write simulator state!");
+
+		return;
+	}
+
+	for (type = 0; type < SIM_FW_NUM; type++)
+	{
+		p_fw = p_sim->installed + type;
+
+		if (p_fw->present)
+			fprintf(p_file, "%u %u 0x%08X %u\n", type, p_fw->version, p_fw->addr, p_fw->len);
+	}
+
+	if (fclose(p_file))
+		logger_error("Cannot write simulator state!");
+}
+
+static void uart_sim_set_fw(uart_sim_t *p_sim, int type, uint32_t version, uint32_t addr, uint32_t len)
+{
+	p_sim->installed[type].present = 1;
+	p_sim->installed[type].version = version;
+	p_sim->installed[type].addr = addr;
+	p_sim->installed[type].len = len;
+}
+
+// the firmware of the init packet is complete, its images are installed as the bootloader would
+static void uart_sim_install(uart_sim_t *p_sim)
+{
+	const init_packet_t *p_init = &p_sim->init;
+	uint32_t sd_version = 0;
+
+	// the SoftDevice version is read from the image, as the host does
+	if (p_init->sd_size >= SIM_SD_INFO_VERSION_OFFSET + 4 &&
+		uart_sim_get_u32(p_sim->p_fw + SIM_SD_INFO_MAGIC_OFFSET) == SIM_SD_INFO_MAGIC)
+		sd_version = uart_sim_get_u32(p_sim->p_fw + SIM_SD_INFO_VERSION_OFFSET);
+
+	switch (p_init->type)
+	{
+	case INIT_PACKET_FW_APPLICATION:
+		uart_sim_set_fw(p_sim, SIM_FW_APPLICATION, p_init->fw_version, SIM_ADDR_APPLICATION, p_init->app_size);
+		break;
+
+	case INIT_PACKET_FW_SOFTDEVICE:
+		uart_sim_set_fw(p_sim, SIM_FW_SOFTDEVICE, sd_version, SIM_ADDR_SOFTDEVICE, p_init->sd_size);
+		break;
+
+	case INIT_PACKET_FW_BOOTLOADER:
+		uart_sim_set_fw(p_sim, SIM_FW_BOOTLOADER, p_init->fw_version, SIM_ADDR_BOOTLOADER, p_init->bl_size);
+		break;
+
+	case INIT_PACKET_FW_SOFTDEVICE_BOOTLOADER:
+		uart_sim_set_fw(p_sim, SIM_FW_SOFTDEVICE, sd_version, SIM_ADDR_SOFTDEVICE, p_init->sd_size);
+		uart_sim_set_fw(p_sim, SIM_FW_BOOTLOADER, p_init->fw_version, SIM_ADDR_BOOTLOADER, p_init->bl_size);
+		break;
+
+	default:
+		return;
+	}
+
+	if (p_sim->p_state_file != NULL)
+		uart_sim_save_state(p_sim);
+}
+
+// type, version, address and length of the n-th image installed
+static void uart_sim_fw_version(uart_sim_t *p_sim, uint8_t image, uint8_t *p_data)
+{
+	const uart_sim_fw_t *p_fw;
+	int type;
+
+	memset(p_data, 0, 13);
+	*p_data = SIM_FW_NONE;
+
+	for (type = 0; type < SIM_FW_NUM; type++)
+	{
+		p_fw = p_sim->installed + type;
+
+		if (p_fw->present && !image--)
+		{
+			*p_data = (uint8_t)type;
+			uart_sim_put_u32(p_data + 1, p_fw->version);
+			uart_sim_put_u32(p_data + 5, p_fw->addr);
+			uart_sim_put_u32(p_data + 9, p_fw->len);
+
+			break;
+		}
+	}
+}
+
+static void uart_sim_execute(uart_drv_t *p_uart)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uint8_t result = SIM_RES_NOT_PERMITTED;
+	uint32_t proc_us = 0;
+
+	if (p_sim->obj_type == SIM_OBJ_COMMAND)
+	{
+		if (p_sim->cmd_len > 0 && p_sim->cmd_len == p_sim->cmd_size)
+		{
+			p_sim->cmd_valid = 1;
+			p_sim->init_valid = !init_packet_parse(p_sim->cmd, p_sim->cmd_len, &p_sim->init);
+
+			result = SIM_RES_SUCCESS;
+			proc_us = p_sim->verify_us;
+		}
+	}
+	else if (p_sim->obj_type == SIM_OBJ_DATA)
+	{
+		// an object already executed may be executed again
+		if (p_sim->fw_len == p_sim->obj_end)
+		{
+			// the last object of the firmware activates it
+			if (p_sim->fw_len > p_sim->fw_done && p_sim->init_valid &&
+				p_sim->fw_len == p_sim->init.sd_size + p_sim->init.bl_size + p_sim->init.app_size)
+				uart_sim_install(p_sim);
+
+			if (p_sim->fw_len > p_sim->fw_done)
+				proc_us = p_sim->flash_us;
+
+			p_sim->fw_done = p_sim->fw_len;
+			p_sim->fw_done_crc = p_sim->fw_crc;
+
+			result = SIM_RES_SUCCESS;
+		}
+	}
+
+	uart_sim_respond(p_uart, SIM_OP_EXECUTE, result, NULL, 0, proc_us);
+}
+
+static void uart_sim_request(uart_drv_t *p_uart, const uint8_t *p_req, uint32_t size)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uint8_t rsp[20];
+	uint8_t op = *p_req;
+
+	switch (op)
+	{
+	case SIM_OP_WRITE:
+		if (uart_sim_chance(p_sim, p_sim->reset))
+			uart_sim_reset(p_sim);
+		else
+			uart_sim_write(p_uart, p_req + 1, size - 1);
+		break;
+
+	case SIM_OP_PING:
+		if (size < 2)
+			uart_sim_respond(p_uart, op, SIM_RES_INVALID_PARAMETER, NULL, 0, 0);
+		else
+			uart_sim_respond(p_uart, op, SIM_RES_SUCCESS, p_req + 1, 1, 0);
+		break;
+
+	case SIM_OP_RECEIPT_NOTIF_SET:
+		if (size < 3)
+		{
+			uart_sim_respond(p_uart, op, SIM_RES_INVALID_PARAMETER, NULL, 0, 0);
+		}
+		else
+		{
+			p_sim->prn = (uint16_t)(*(p_req + 1) | (*(p_req + 2) << 8));
+			p_sim->prn_cnt = 0;
+
+			uart_sim_respond(p_uart, op, SIM_RES_SUCCESS, NULL, 0, 0);
+		}
+		break;
+
+	case SIM_OP_MTU_GET:
+		rsp[0] = (uint8_t)p_sim->mtu;
+		rsp[1] = (uint8_t)(p_sim->mtu >> 8);
+
+		uart_sim_respond(p_uart, op, SIM_RES_SUCCESS, rsp, 2, 0);
+		break;
+
+	case SIM_OP_SELECT:
+		if (size < 2 || (*(p_req + 1) != SIM_OBJ_COMMAND && *(p_req + 1) != SIM_OBJ_DATA))
+		{
+			uart_sim_respond(p_uart, op, SIM_RES_UNSUPPORTED_TYPE, NULL, 0, 0);
+		}
+		else
+		{
+			p_sim->obj_type = *(p_req + 1);
+
+			uart_sim_put_u32(rsp, (p_sim->obj_type == SIM_OBJ_DATA) ? UART_SIM_DATA_SIZE_MAX : UART_SIM_CMD_SIZE_MAX);
+			uart_sim_obj_crc(p_sim, rsp + 4);
+
+			uart_sim_respond(p_uart, op, SIM_RES_SUCCESS, rsp, 12, 0);
+		}
+		break;
+
+	case SIM_OP_CREATE:
+		uart_sim_create(p_uart, p_req, size);
+		break;
+
+	case SIM_OP_CRC_GET:
+		uart_sim_obj_crc(p_sim, rsp);
+
+		uart_sim_respond(p_uart, op, SIM_RES_SUCCESS, rsp, 8, 0);
+		break;
+
+	case SIM_OP_EXECUTE:
+		uart_sim_execute(p_uart);
+		break;
+
+	case SIM_OP_FIRMWARE_VERSION:
+		uart_sim_fw_version(p_sim, (size < 2) ? 0 : *(p_req + 1), rsp);
+
+		uart_sim_respond(p_uart, op, SIM_RES_SUCCESS, rsp, 13, 0);
+		break;
+
+	case SIM_OP_HARDWARE_VERSION:
+		uart_sim_put_u32(rsp, 0x52832);
+		uart_sim_put_u32(rsp + 4, 0x41414142);
+		uart_sim_put_u32(rsp + 8, 0x80000);
+		uart_sim_put_u32(rsp + 12, 0x10000);
+		uart_sim_put_u32(rsp + 16, 0x1000);
+
+		uart_sim_respond(p_uart, op, SIM_RES_SUCCESS, rsp, 20, 0);
+		break;
+
+	case SIM_OP_ABORT:
+		uart_sim_drop_obj(p_sim);
+
+		uart_sim_respond(p_uart, op, SIM_RES_SUCCESS, NULL, 0, 0);
+		break;
+
+	default:
+		uart_sim_respond(p_uart, op, SIM_RES_OP_NOT_SUPPORTED, NULL, 0, 0);
+		break;
+	}
+}
+
+// SLIP decode the bytes received, a corrupted frame is skipped up to the next frame end
+static void uart_sim_rx_bytes(uart_drv_t *p_uart, const uint8_t *p_data, uint32_t size)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uint32_t n;
+	uint8_t b;
+
+	for (n = 0; n < size; n++)
+	{
+		// a reset loses the bytes received while the target boots
+		if (p_sim->time_us < p_sim->boot_end_us)
+			return;
+
+		b = *(p_data + n);
+
+		if (b == SLIP_END)
+		{
+			if (!p_sim->req_bad && p_sim->req_len > 0)
+				uart_sim_request(p_uart, p_sim->req, p_sim->req_len);
+
+			p_sim->req_len = 0;
+			p_sim->req_esc = 0;
+			p_sim->req_bad = 0;
+
+			continue;
+		}
+
+		if (p_sim->req_bad)
+			continue;
+
+		if (p_sim->req_esc)
+		{
+			p_sim->req_esc = 0;
+
+			if (b == SLIP_ESC_END)
+				b = SLIP_END;
+			else if (b == SLIP_ESC_ESC)
+				b = SLIP_ESC;
+			else
+			{
+				p_sim->req_bad = 1;
+
+				continue;
+			}
+		}
+		else if (b == SLIP_ESC)
+		{
+			p_sim->req_esc = 1;
+
+			continue;
+		}
+
+		if (p_sim->req_len >= sizeof(p_sim->req))
+			p_sim->req_bad = 1;
+		else
+			p_sim->req[p_sim->req_len++] = b;
+	}
+}
+
+// inject the faults of one frame sent by the host, up to and including its frame end
+static void uart_sim_rx_frame(uart_drv_t *p_uart, const uint8_t *p_frame, uint32_t size)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uint8_t frame[UART_SIM_REQ_SIZE_MAX];
+	int dup;
+
+	if (uart_sim_chance(p_sim, p_sim->drop))
+	{
+		p_sim->faults.drops++;
+
+		return;
+	}
+
+	dup = uart_sim_chance(p_sim, p_sim->dup);
+	if (dup)
+		p_sim->faults.dups++;
+
+	if (size <= sizeof(frame) && uart_sim_chance(p_sim, p_sim->flip))
+	{
+		memcpy(frame, p_frame, size);
+		uart_sim_flip(p_sim, frame, size);
+
+		p_frame = frame;
+	}
+
+	uart_sim_rx_bytes(p_uart, p_frame, size);
+
+	if (dup)
+		uart_sim_rx_bytes(p_uart, p_frame, size);
+}
+
+static int uart_sim_set_option(uart_sim_t *p_sim, const char *p_name, size_t name_len, const char *p_value)
+{
+	double value;
+	char *p_end;
+	size_t value_len;
+
+#define SIM_OPTION(name) (name_len == strlen(name) && !strncmp(p_name, name, name_len))
+
+	if (SIM_OPTION("state"))
+	{
+		value_len = strcspn(p_value, ",");
+
+		free(p_sim->p_state_file);
+		p_sim->p_state_file = (char *)malloc(value_len + 1);
+
+		if (p_sim->p_state_file == NULL || !value_len)
+			return 1;
+
+		memcpy(p_sim->p_state_file, p_value, value_len);
+		p_sim->p_state_file[value_len] = '\0';
+
+		return 0;
+	}
+
+	value = strtod(p_value, &p_end);
+	if (p_end == p_value || (*p_end != ',' && *p_end != '\0') || value < 0.0)
+		return 1;
+
+	if (SIM_OPTION("flip"))
+		p_sim->flip = value;
+	else if (SIM_OPTION("drop"))
+		p_sim->drop = value;
+	else if (SIM_OPTION("dup"))
+		p_sim->dup = value;
+	else if (SIM_OPTION("delay"))
+		p_sim->delay = value;
+	else if (SIM_OPTION("reset"))
+		p_sim->reset = value;
+	else if (SIM_OPTION("delay_ms"))
+		p_sim->delay_us = (uint32_t)(value * 1000);
+	else if (SIM_OPTION("mtu"))
+		p_sim->mtu = (uint32_t)value;
+	else if (SIM_OPTION("turnaround_us"))
+		p_sim->turnaround_us = (uint32_t)value;
+	else if (SIM_OPTION("flash_ms"))
+		p_sim->flash_us = (uint32_t)(value * 1000);
+	else if (SIM_OPTION("verify_ms"))
+		p_sim->verify_us = (uint32_t)(value * 1000);
+	else if (SIM_OPTION("boot_ms"))
+		p_sim->boot_us = (uint32_t)(value * 1000);
+	else if (SIM_OPTION("seed"))
+		p_sim->rng = (uint64_t)value * 0x9E3779B97F4A7C15ULL + 1;
+	else
+		return 1;
+
+#undef SIM_OPTION
+
+	return 0;
+}
+
+static int uart_sim_open(uart_drv_t *p_uart)
+{
+	int err_code = 0;
+	uart_sim_t *p_sim;
+	const char *p_opt = p_uart->p_addr;
+
+	p_sim = (uart_sim_t *)calloc(1, sizeof(uart_sim_t));
+
+	if (p_sim == NULL)
+	{
+		logger_error("Cannot allocate simulator state!");
+
+		return 1;
+	}
+
+	p_sim->delay_us = 1000000;
+	p_sim->mtu = UART_SIM_MTU_DEF;
+	p_sim->turnaround_us = 200;
+	p_sim->flash_us = 50000;
+	p_sim->verify_us = 200000;
+	p_sim->boot_us = 300000;
+	p_sim->rng = 0x9E3779B97F4A7C15ULL + 1;
+
+	while (!err_code && *p_opt != '\0')
+	{
+		const char *p_eq = strchr(p_opt, '=');
+		const char *p_next = strchr(p_opt, ',');
+
+		if (p_eq == NULL || (p_next != NULL && p_next < p_eq) ||
+			uart_sim_set_option(p_sim, p_opt, (size_t)(p_eq - p_opt), p_eq + 1))
+		{
+			logger_error("Invalid simulator options (%s)!", p_opt);
+
+			err_code = 1;
+		}
+
+		p_opt = (p_next != NULL) ? p_next + 1 : p_opt + strlen(p_opt);
+	}
+
+	if (!err_code && p_sim->p_state_file != NULL)
+		uart_sim_load_state(p_sim);
+
+	if (err_code)
+	{
+		free(p_sim->p_state_file);
+		free(p_sim);
+	}
+	else
+		p_uart->p_priv = p_sim;
+
+	return err_code;
+}
+
+static int uart_sim_close(uart_drv_t *p_uart)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+
+	if (p_sim == NULL)
+		return 1;
+
+	if (p_sim->p_fw != NULL)
+		free(p_sim->p_fw);
+
+	free(p_sim->p_state_file);
+	free(p_sim);
+
+	p_uart->p_priv = NULL;
+
+	return 0;
+}
+
+static int uart_sim_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	const uint8_t *p_end;
+	uint32_t size;
+
+	// the target handles the requests once they are all received
+	p_sim->time_us += uart_sim_wire_us(p_uart, nSize);
+
+	while (nSize > 0)
+	{
+		p_end = (const uint8_t *)memchr(pData, SLIP_END, nSize);
+		size = (p_end != NULL) ? (uint32_t)(p_end - pData) + 1 : nSize;
+
+		uart_sim_rx_frame(p_uart, pData, size);
+
+		pData += size;
+		nSize -= size;
+	}
+
+	return 0;
+}
+
+static int uart_sim_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+	uart_sim_rsp_t *p_rsp;
+	uint32_t length = 0;
+	uint32_t size;
+
+	if (!p_sim->rsp_cnt || p_sim->rsp[p_sim->rsp_head].ready_us > p_sim->time_us + UART_SIM_READ_TIMEOUT_US)
+	{
+		p_sim->time_us += UART_SIM_READ_TIMEOUT_US;
+		*pSize = 0;
+
+		return 0;
+	}
+
+	if (p_sim->rsp[p_sim->rsp_head].ready_us > p_sim->time_us)
+		p_sim->time_us = p_sim->rsp[p_sim->rsp_head].ready_us;
+
+	// everything received by now is read at once
+	while (p_sim->rsp_cnt > 0 && length < nSize)
+	{
+		p_rsp = &p_sim->rsp[p_sim->rsp_head];
+
+		if (p_rsp->ready_us > p_sim->time_us)
+			break;
+
+		size = p_rsp->size - p_rsp->pos;
+		if (size > nSize - length)
+			size = nSize - length;
+
+		memcpy(pData + length, p_rsp->data + p_rsp->pos, size);
+		length += size;
+		p_rsp->pos += size;
+
+		if (p_rsp->pos == p_rsp->size)
+		{
+			p_sim->rsp_head = (p_sim->rsp_head + 1) % UART_SIM_QUEUE_LEN;
+			p_sim->rsp_cnt--;
+		}
+	}
+
+	*pSize = length;
+
+	return 0;
+}
+
+static int uart_sim_set_baud(uart_drv_t *p_uart, uint32_t baud_rate)
+{
+	// the wire time follows p_uart->baud_rate
+	(void)p_uart;
+	(void)baud_rate;
+
+	return 0;
+}
+
+static void uart_sim_sleep(uart_drv_t *p_uart, uint64_t time_us)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+
+	p_sim->time_us += time_us;
+}
+
+uint64_t uart_sim_time_us(uart_drv_t *p_uart)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+
+	return (p_sim != NULL) ? p_sim->time_us : 0;
+}
+
+uint32_t uart_sim_fw_size(uart_drv_t *p_uart)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+
+	return (p_sim != NULL) ? p_sim->fw_done : 0;
+}
+
+void uart_sim_get_faults(uart_drv_t *p_uart, uart_sim_faults_t *p_faults)
+{
+	uart_sim_t *p_sim = (uart_sim_t *)p_uart->p_priv;
+
+	if (p_sim != NULL)
+		*p_faults = p_sim->faults;
+	else
+		memset(p_faults, 0, sizeof(*p_faults));
+}
@@ -0,0 +1,105 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#pragma once
+ 
+#ifndef _INC_UART_SIM
+#define _INC_UART_SIM
+
+#include <stdint.h>
+#include "uart_drv.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/*
+ * Simulated DFU target with fault injection, selected by the port name:
+ *
+ *   sim:[<option>=<value>[,<option>=<value>...]]
+ *
+ * Fault rates are probabilities per SLIP frame, in either direction:
+ *
+ *   flip      one bit of the frame is flipped
+ *   drop      the frame is lost
+ *   dup       the frame is received twice
+ *   delay     the response comes delay_ms late
+ *   reset     the target resets on a write frame, losing the object in progress
+ *
+ * Target and link options: seed, delay_ms (1000), mtu (131), turnaround_us (200),
+ * flash_ms (50, per data object), verify_ms (200, per init packet), boot_ms (300).
+ *
+ * The images of a firmware complete are installed as their init packet gives
+ * them and reported by FIRMWARE_VERSION. state=<file> keeps them in a file from
+ * one open of the port to the next.
+ *
+ * The target runs in the caller's thread on a virtual clock, advanced by the
+ * wire time at the port's bit rate and by the target's processing time. A read
+ * with no data ready takes the read timeout of the TTY backend.
+ */
+
+// port name prefix selecting the simulated target
+#define UART_SIM_PREFIX         "sim:"
+
+/**
+* @brief Faults injected so far.
+*/
+typedef struct {
+	uint32_t flips;                     //!< Frames with a bit flipped.
+	uint32_t drops;                     //!< Frames lost.
+	uint32_t dups;                      //!< Frames duplicated.
+	uint32_t delays;                    //!< Responses delayed.
+	uint32_t resets;                    //!< Target resets.
+} uart_sim_faults_t;
+
+// virtual time elapsed since the port was opened
+uint64_t uart_sim_time_us(uart_drv_t *p_uart);
+
+// firmware bytes the target has executed so far
+uint32_t uart_sim_fw_size(uart_drv_t *p_uart);
+
+void uart_sim_get_faults(uart_drv_t *p_uart, uart_sim_faults_t *p_faults);
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_UART_SIM
@@ -38,41 +38,532 @@
 *
 */
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
 #include <string.h>
+#ifndef WIN32
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <errno.h>
+#endif
 #include "uart_slip.h"
 #include "slip_enc.h"
+#include "sys_time.h"
 #include "logging.h"
 
-#define UART_SLIP_BUFF_SIZE		(UART_SLIP_SIZE_MAX * 2 + 1)
+// decode a frame of the RX data; in resync mode, a malformed frame is dropped and counted,
+// an empty one skipped, and -1 returned to read on
+static int uart_slip_decode(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize, const uint8_t *p_frame, uint32_t frame_len)
+{
+	if (!p_uart->slip_resync)
+		return decode_slip(pData, pSize, p_frame, frame_len);
+
+	if (decode_slip_frame(pData, nSize, pSize, p_frame, frame_len))
+	{
+		UART_DRV_STATS_ADD(p_uart->stats.rx_dropped, 1);
+		UART_DRV_STATS_ADD(p_uart->stats.rx_discarded, frame_len);
+
+		logger_info_2("Malformed frame of %u bytes dropped.", frame_len);
+
+		return -1;
+	}
+
+	return *pSize ? 0 : -1;
+}
+
+// in resync mode, the RX data filling the buffer without a SLIP_END is line noise:
+// it is discarded, and so is the data up to the next SLIP_END
+static void uart_slip_skip(uart_drv_t *p_uart, uint32_t length)
+{
+	UART_DRV_STATS_ADD(p_uart->stats.rx_discarded, length);
+	p_uart->p_slip->rx_skip = 1;
+
+	logger_info_2("No SLIP_END in %u bytes, skipping to the next one.", length);
+}
+
+#ifndef WIN32
+
+// number of decoded frames the RX thread may queue, a power of 2
+#define UART_SLIP_RX_QUEUE_LEN      64
+
+// time to wait for a frame, as a TTY read does
+#define UART_SLIP_RX_TIMEOUT_US     500000
+
+// sem_clockwait() waits on the monotonic clock, from glibc 2.30
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+#define UART_SLIP_RX_CLOCKWAIT
+#endif
+
+// polling period of the queue without sem_clockwait()
+#define UART_SLIP_RX_POLL_US        1000
+
+typedef struct
+{
+	uint8_t data[UART_SLIP_BUFF_SIZE];  //!< Decoded frame.
+	uint32_t len;                       //!< Decoded frame size.
+	int err_code;                       //!< Read or decode result.
+	uint64_t time_us;                   //!< Arrival time.
+} uart_slip_frame_t;
+
+// frames decoded by the RX thread, a single producer, single consumer lock-free queue
+typedef struct uart_slip_rx_s
+{
+	uart_slip_frame_t queue[UART_SLIP_RX_QUEUE_LEN];
+	uint32_t head;                      //!< Next slot written, by the RX thread only.
+	uint32_t tail;                      //!< Next slot read, by the consumer only.
+	sem_t frames;                       //!< Frames queued, to wait for one.
+	int stop;                           //!< Stop receiving.
+	uint32_t dropped;                   //!< Frames lost to a full queue.
+	pthread_t thread;
+} uart_slip_rx_t;
+
+static void uart_slip_rx_push(uart_drv_t *p_uart, const uint8_t *p_frame, uint32_t frame_len, int err_code, uint64_t time_us)
+{
+	uart_slip_rx_t *p_rx = p_uart->p_slip->p_rx;
+	uint32_t head = p_rx->head;
+	uart_slip_frame_t *p_slot;
+
+	if (head - __atomic_load_n(&p_rx->tail, __ATOMIC_ACQUIRE) >= UART_SLIP_RX_QUEUE_LEN)
+	{
+		p_rx->dropped++;
+
+		return;
+	}
+
+	p_slot = p_rx->queue + (head & (UART_SLIP_RX_QUEUE_LEN - 1));
+
+	p_slot->len = 0;
+
+	if (!err_code)
+	{
+		err_code = uart_slip_decode(p_uart, p_slot->data, sizeof(p_slot->data), &p_slot->len, p_frame, frame_len);
+
+		// dropped, the slot is not published
+		if (err_code < 0)
+			return;
+	}
+
+	p_slot->err_code = err_code;
+	p_slot->time_us = time_us;
+
+	// the slot is filled before it is published
+	__atomic_store_n(&p_rx->head, head + 1, __ATOMIC_RELEASE);
+
+	sem_post(&p_rx->frames);
+}
+
+// read and decode the frames as they arrive, until the port is closed
+static void *uart_slip_rx_thread(void *p_context)
+{
+	uart_drv_t *p_uart = (uart_drv_t *)p_context;
+	uart_slip_t *p_slip = p_uart->p_slip;
+	uart_slip_rx_t *p_rx = p_slip->p_rx;
+	uint32_t slip_len = 0;
+	uint32_t length, frame_len;
+	const uint8_t *p_end;
+	uint64_t time_us;
+	int err_code = 0;
+
+	while (!err_code && !__atomic_load_n(&p_rx->stop, __ATOMIC_ACQUIRE))
+	{
+		if (slip_len >= sizeof(p_slip->rx_buff))
+		{
+			if (p_uart->slip_resync)
+			{
+				uart_slip_skip(p_uart, slip_len);
+			}
+			else
+			{
+				logger_error("UART buffer overflow!");
+
+				uart_slip_rx_push(p_uart, NULL, 0, 1, sys_time_us());
+			}
+
+			slip_len = 0;
+		}
+
+		length = 0;
+		err_code = uart_drv_receive(p_uart, p_slip->rx_buff + slip_len, sizeof(p_slip->rx_buff) - slip_len, &length);
+
+		time_us = sys_time_us();
+
+		// the consumer gets the error, the port is not read any more
+		if (err_code)
+		{
+			uart_slip_rx_push(p_uart, NULL, 0, err_code, time_us);
+			break;
+		}
+
+		slip_len += length;
+
+		while ((p_end = (const uint8_t *)memchr(p_slip->rx_buff, SLIP_END, slip_len)) != NULL)
+		{
+			frame_len = (uint32_t)(p_end - p_slip->rx_buff) + 1;
+
+			if (p_slip->rx_skip)
+			{
+				UART_DRV_STATS_ADD(p_uart->stats.rx_discarded, frame_len);
+				p_slip->rx_skip = 0;
+			}
+			else
+			{
+				uart_slip_rx_push(p_uart, p_slip->rx_buff, frame_len, 0, time_us);
+			}
+
+			slip_len -= frame_len;
+			memmove(p_slip->rx_buff, p_slip->rx_buff + frame_len, slip_len);
+		}
+	}
 
-static uint8_t uart_slip_buff[UART_SLIP_BUFF_SIZE];
+	return NULL;
+}
+
+// wait for a frame from the RX thread, returns 0 once one is queued
+// the deadline is kept on the monotonic clock, a change of the wall clock does not move it
+static int uart_slip_rx_wait(uart_slip_rx_t *p_rx, uint64_t timeout_us)
+{
+	struct timespec ts;
+#ifdef UART_SLIP_RX_CLOCKWAIT
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	ts.tv_sec += (time_t)(timeout_us / 1000000);
+	ts.tv_nsec += (long)(timeout_us % 1000000) * 1000;
+	if (ts.tv_nsec >= 1000000000)
+	{
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	// a signal ends the wait, as it ends a TTY read
+	return sem_clockwait(&p_rx->frames, CLOCK_MONOTONIC, &ts) ? 1 : 0;
+#else
+	uint64_t deadline_us = sys_time_us() + timeout_us;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = UART_SLIP_RX_POLL_US * 1000;
+
+	// the relative sleeps do not depend on the wall clock either, a signal ends the wait
+	while (sem_trywait(&p_rx->frames))
+	{
+		if (errno != EAGAIN || sys_time_us() >= deadline_us || nanosleep(&ts, NULL))
+			return 1;
+	}
+
+	return 0;
+#endif
+}
+
+// take the oldest frame queued, once waited for
+static int uart_slip_rx_take(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
+{
+	uart_slip_t *p_slip = p_uart->p_slip;
+	uart_slip_rx_t *p_rx = p_slip->p_rx;
+	uint32_t tail = p_rx->tail;
+	const uart_slip_frame_t *p_slot = p_rx->queue + (tail & (UART_SLIP_RX_QUEUE_LEN - 1));
+	int err_code = p_slot->err_code;
+
+	if (!err_code && p_slot->len > nSize)
+	{
+		logger_error("Cannot decode SLIP!");
+
+		err_code = 1;
+	}
+
+	if (!err_code)
+	{
+		memcpy(pData, p_slot->data, p_slot->len);
+		*pSize = p_slot->len;
+	}
+
+	p_slip->rx_time_us = p_slot->time_us;
+
+	// the slot is read before it is released
+	__atomic_store_n(&p_rx->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return err_code;
+}
+
+static void uart_slip_rx_start(uart_drv_t *p_uart)
+{
+	uart_slip_t *p_slip = p_uart->p_slip;
+	uart_slip_rx_t *p_rx;
+
+	// only a TTY may be read and written from different threads, a record needs the events in order
+	if (p_uart->p_ops != &uart_tty_ops || p_uart->p_RecordName != NULL)
+	{
+		logger_info_2("No RX thread on %s.", p_uart->p_PortName);
+
+		return;
+	}
+
+	p_rx = (uart_slip_rx_t *)calloc(1, sizeof(uart_slip_rx_t));
+
+	if (p_rx == NULL || sem_init(&p_rx->frames, 0, 0))
+	{
+		free(p_rx);
+
+		return;
+	}
+
+	p_slip->p_rx = p_rx;
+
+	if (pthread_create(&p_rx->thread, NULL, uart_slip_rx_thread, p_uart))
+	{
+		sem_destroy(&p_rx->frames);
+		free(p_rx);
+		p_slip->p_rx = NULL;
+	}
+}
+
+static void uart_slip_rx_stop(uart_drv_t *p_uart)
+{
+	uart_slip_rx_t *p_rx = p_uart->p_slip->p_rx;
+
+	if (p_rx == NULL)
+		return;
+
+	// the RX thread stops after its current read
+	__atomic_store_n(&p_rx->stop, 1, __ATOMIC_RELEASE);
+	pthread_join(p_rx->thread, NULL);
+
+	if (p_rx->dropped)
+		logger_info_1("RX queue full, %u frames dropped.", p_rx->dropped);
+
+	sem_destroy(&p_rx->frames);
+	free(p_rx);
+	p_uart->p_slip->p_rx = NULL;
+}
+
+#endif
 
 int uart_slip_open(uart_drv_t *p_uart)
 {
-	return uart_drv_open(p_uart);
+	int err_code;
+	uart_slip_t *p_slip;
+
+	p_slip = (uart_slip_t *)calloc(1, sizeof(uart_slip_t));
+	p_uart->p_slip = p_slip;
+
+	if (p_slip == NULL)
+	{
+		logger_error("Cannot allocate SLIP buffers!");
+
+		return 1;
+	}
+
+	// the frames grow to the target MTU once it is known
+	p_slip->tx_size_max = UART_SLIP_SIZE_MAX;
+	p_slip->p_tx_buff = (uint8_t *)malloc(UART_SLIP_BUFF_SIZE);
+
+	if (p_slip->p_tx_buff != NULL && p_uart->tx_batch_size > 0)
+	{
+		p_slip->batch_max = p_uart->tx_batch_size;
+		if (p_slip->batch_max < UART_SLIP_BUFF_SIZE)
+			p_slip->batch_max = UART_SLIP_BUFF_SIZE;
+
+		p_slip->p_batch = (uint8_t *)malloc(p_slip->batch_max);
+	}
+
+	if (p_slip->p_tx_buff == NULL || (p_uart->tx_batch_size > 0 && p_slip->p_batch == NULL))
+	{
+		logger_error("Cannot allocate SLIP buffers!");
+
+		err_code = 1;
+	}
+	else
+	{
+		err_code = uart_drv_open(p_uart);
+	}
+
+	p_slip->tx_time_us = sys_time_us();
+
+	if (err_code)
+	{
+		free(p_slip->p_batch);
+		free(p_slip->p_tx_buff);
+		free(p_slip);
+		p_uart->p_slip = NULL;
+	}
+#ifndef WIN32
+	else if (p_uart->rx_thread)
+	{
+		uart_slip_rx_start(p_uart);
+	}
+#endif
+
+	return err_code;
 }
 
 int uart_slip_close(uart_drv_t *p_uart)
 {
+	uart_slip_t *p_slip = p_uart->p_slip;
+
+	if (p_slip == NULL)
+		return 1;
+
+	uart_slip_flush(p_uart);
+
+#ifndef WIN32
+	uart_slip_rx_stop(p_uart);
+#endif
+
+	if (p_uart->stats.rx_discarded)
+		logger_info_1("SLIP resync: %u malformed frames dropped, %llu bytes discarded.",
+			p_uart->stats.rx_dropped, (unsigned long long)p_uart->stats.rx_discarded);
+
+	free(p_slip->p_batch);
+	free(p_slip->p_tx_buff);
+	free(p_slip);
+	p_uart->p_slip = NULL;
+
 	return uart_drv_close(p_uart);
 }
 
+uint32_t uart_slip_set_tx_size(uart_drv_t *p_uart, uint32_t nSize)
+{
+	uart_slip_t *p_slip = p_uart->p_slip;
+	uint32_t size_cap = p_uart->frame_size_cap ? p_uart->frame_size_cap : UART_SLIP_SIZE_CAP_DEF;
+	uint32_t buff_size;
+	uint8_t *p_buff;
+
+	if (nSize > size_cap)
+		nSize = size_cap;
+
+	// the buffers only grow, the frames gathered stay where they are
+	if (nSize <= p_slip->tx_size_max)
+		return nSize;
+
+	uart_slip_flush(p_uart);
+
+	buff_size = nSize * 2 + 1;
+
+	p_buff = (uint8_t *)realloc(p_slip->p_tx_buff, buff_size);
+	if (p_buff == NULL)
+		return p_slip->tx_size_max;
+
+	p_slip->p_tx_buff = p_buff;
+
+	// a batch holds at least one frame
+	if (p_slip->p_batch != NULL && p_slip->batch_max < buff_size)
+	{
+		p_buff = (uint8_t *)realloc(p_slip->p_batch, buff_size);
+		if (p_buff == NULL)
+			return p_slip->tx_size_max;
+
+		p_slip->p_batch = p_buff;
+		p_slip->batch_max = buff_size;
+	}
+
+	p_slip->tx_size_max = nSize;
+
+	return nSize;
+}
+
+void uart_slip_batch_begin(uart_drv_t *p_uart)
+{
+	uart_slip_t *p_slip = p_uart->p_slip;
+
+	if (p_slip->p_batch != NULL)
+		p_slip->batching = 1;
+}
+
+int uart_slip_flush(uart_drv_t *p_uart)
+{
+	int err_code = 0;
+	uart_slip_t *p_slip = p_uart->p_slip;
+
+	if (p_slip->batch_cnt > 0)
+	{
+		// one write for all the frames gathered
+		err_code = uart_drv_send_v(p_uart, p_slip->batch_iov, p_slip->batch_cnt);
+
+		p_slip->batch_cnt = 0;
+		p_slip->batch_len = 0;
+	}
+
+	p_slip->batching = 0;
+
+	return err_code;
+}
+
 int uart_slip_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+{
+	slip_iov_t iov;
+
+	iov.pData = pData;
+	iov.nSize = nSize;
+
+	return uart_slip_send_iov(p_uart, &iov, 1);
+}
+
+int uart_slip_send_iov(uart_drv_t *p_uart, const slip_iov_t *pIov, uint32_t nCount)
+{
+	return uart_slip_send_iov_crc(p_uart, pIov, nCount, nCount, NULL);
+}
+
+int uart_slip_send_iov_crc(uart_drv_t *p_uart, const slip_iov_t *pIov, uint32_t nCount, uint32_t nCrcStart, uint32_t *pCrc)
 {
 	int err_code = 0;
+	uart_slip_t *p_slip = p_uart->p_slip;
+	uint32_t nSize = 0;
 	uint32_t nSlipSize;
+	uint8_t *pSlipData;
+	uint32_t n;
+
+	for (n = 0; n < nCount; n++)
+		nSize += (pIov + n)->nSize;
 
-	if (nSize > UART_SLIP_SIZE_MAX)
+	if (nSize > p_slip->tx_size_max)
 	{
 		logger_error("Cannot encode SLIP!");
 
-		err_code = 1;
+		return 1;
+	}
+
+	if (p_slip->batching)
+	{
+		// make room for the worst case encoding
+		if (p_slip->batch_cnt >= UART_DRV_IOV_MAX ||
+			p_slip->batch_len + nSize * 2 + 1 > p_slip->batch_max)
+		{
+			err_code = uart_slip_flush(p_uart);
+
+			p_slip->batching = 1;
+		}
+
+		pSlipData = p_slip->p_batch + p_slip->batch_len;
 	}
 	else
 	{
-		encode_slip(uart_slip_buff, &nSlipSize, pData, nSize);
+		pSlipData = p_slip->p_tx_buff;
+	}
+
+	if (!err_code)
+	{
+		// encode straight from the caller's buffers into the output buffer
+		if (pCrc != NULL)
+			encode_slip_iov_crc(pSlipData, &nSlipSize, pIov, nCount, nCrcStart, pCrc);
+		else
+			encode_slip_iov(pSlipData, &nSlipSize, pIov, nCount);
+
+		p_uart->stats.tx_frames++;
+		p_slip->tx_time_us = sys_time_us();
 
-		err_code = uart_drv_send(p_uart, uart_slip_buff, nSlipSize);
+		if (p_slip->batching)
+		{
+			p_slip->batch_iov[p_slip->batch_cnt].pData = pSlipData;
+			p_slip->batch_iov[p_slip->batch_cnt].nSize = nSlipSize;
+			p_slip->batch_cnt++;
+			p_slip->batch_len += nSlipSize;
+		}
+		else
+		{
+			err_code = uart_drv_send(p_uart, pSlipData, nSlipSize);
+		}
 	}
 
 	return err_code;
@@ -81,12 +572,80 @@ int uart_slip_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
 int uart_slip_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
 {
 	int err_code = 0;
+	uart_slip_t *p_slip = p_uart->p_slip;
 	uint32_t sizeBuffer;
-	uint32_t length, slip_len = 0;
+	uint32_t length, slip_len;
+	const uint8_t *p_end;
 
-	do
+	// a response is expected, the gathered frames must go out first
+	err_code = uart_slip_flush(p_uart);
+	if (err_code)
+		return err_code;
+
+#ifndef WIN32
+	// the frames have been read and decoded as they arrived
+	if (p_slip->p_rx != NULL)
 	{
-		sizeBuffer = sizeof(uart_slip_buff) - slip_len;
+		if (!uart_slip_rx_wait(p_slip->p_rx, UART_SLIP_RX_TIMEOUT_US))
+			return uart_slip_rx_take(p_uart, pData, nSize, pSize);
+
+		if (p_uart->p_cancel != NULL && *p_uart->p_cancel)
+			logger_error("DFU cancelled!");
+		else
+			logger_error("Read no data from UART!");
+
+		return 1;
+	}
+#endif
+
+	// the data following the last frame decoded comes first
+	slip_len = p_slip->rx_len;
+	p_slip->rx_len = 0;
+
+	while (!err_code)
+	{
+		p_end = (const uint8_t *)memchr(p_slip->rx_buff, SLIP_END, slip_len);
+
+		if (p_end != NULL)
+		{
+			uint32_t frame_len = (uint32_t)(p_end - p_slip->rx_buff) + 1;
+			int decode_err = -1;
+
+			if (p_slip->rx_skip)
+			{
+				UART_DRV_STATS_ADD(p_uart->stats.rx_discarded, frame_len);
+				p_slip->rx_skip = 0;
+			}
+			else
+			{
+				decode_err = uart_slip_decode(p_uart, pData, nSize, pSize, p_slip->rx_buff, frame_len);
+			}
+
+			p_slip->rx_time_us = p_slip->read_time_us;
+
+			// keep the next frames, if several have been read at once
+			slip_len -= frame_len;
+			memmove(p_slip->rx_buff, p_slip->rx_buff + frame_len, slip_len);
+
+			// a frame dropped to resync, the next one is read
+			if (decode_err < 0)
+				continue;
+
+			err_code = decode_err;
+			p_slip->rx_len = slip_len;
+
+			break;
+		}
+
+		sizeBuffer = sizeof(p_slip->rx_buff) - slip_len;
+		if (!sizeBuffer && p_uart->slip_resync)
+		{
+			uart_slip_skip(p_uart, slip_len);
+
+			slip_len = 0;
+			sizeBuffer = sizeof(p_slip->rx_buff);
+		}
+
 		if (!sizeBuffer)
 		{
 			logger_error("UART buffer overflow!");
@@ -97,13 +656,18 @@ int uart_slip_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32
 		}
 
 		length = 0;
-		err_code = uart_drv_receive(p_uart, uart_slip_buff + slip_len, sizeBuffer, &length);
+		err_code = uart_drv_receive(p_uart, p_slip->rx_buff + slip_len, sizeBuffer, &length);
 		if (err_code)
 			break;
 
+		p_slip->read_time_us = sys_time_us();
+
 		if (!length)
 		{
-			logger_error("Read no data from UART!");
+			if (p_uart->p_cancel != NULL && *p_uart->p_cancel)
+				logger_error("DFU cancelled!");
+			else
+				logger_error("Read no data from UART!");
 
 			err_code = 1;
 
@@ -111,12 +675,41 @@ int uart_slip_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32
 		}
 
 		slip_len += length;
+	}
 
-		if (!decode_slip(pData, pSize, uart_slip_buff, slip_len))
-		{
+	return err_code;
+}
+
+void uart_slip_drain(uart_drv_t *p_uart)
+{
+	uart_slip_t *p_slip = p_uart->p_slip;
+	const uint8_t slip_end = SLIP_END;
+	uint32_t length;
+
+	uart_slip_flush(p_uart);
+
+	// terminate any partial frame held by the peer, its response is discarded too
+	uart_drv_send(p_uart, &slip_end, 1);
+
+#ifndef WIN32
+	if (p_slip->p_rx != NULL)
+	{
+		uint8_t frame[UART_SLIP_BUFF_SIZE];
+
+		while (!uart_slip_rx_wait(p_slip->p_rx, UART_SLIP_RX_TIMEOUT_US))
+			uart_slip_rx_take(p_uart, frame, sizeof(frame), &length);
+
+		return;
+	}
+#endif
+
+	do
+	{
+		length = 0;
+		if (uart_drv_receive(p_uart, p_slip->rx_buff, sizeof(p_slip->rx_buff), &length))
 			break;
-		}
-	} while (!err_code);
+	} while (length > 0);
 
-	return err_code;
+	p_slip->rx_len = 0;
+	p_slip->rx_skip = 0;
 }
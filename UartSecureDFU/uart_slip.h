@@ -45,6 +45,7 @@
 
 #include <stdint.h>
 #include "uart_drv.h"
+#include "slip_enc.h"
 
 
 #ifdef __cplusplus
@@ -52,17 +53,65 @@ extern "C" {
 #endif  /* __cplusplus */
 
 
+// largest frame received, and largest frame sent until the target MTU is known
 #define UART_SLIP_SIZE_MAX		128
 
+#define UART_SLIP_BUFF_SIZE		(UART_SLIP_SIZE_MAX * 2 + 1)
 
+// default host cap of the frames sent, the target MTU sizes them up to it
+#define UART_SLIP_SIZE_CAP_DEF		1024
+
+// default TX batch budget in bytes
+#define UART_SLIP_BATCH_SIZE_DEF	8192
+
+typedef struct uart_slip_s {
+	uint8_t rx_buff[UART_SLIP_BUFF_SIZE];   //!< Encoded RX data.
+	uint32_t rx_len;                    //!< Encoded RX data not decoded yet.
+	uint8_t *p_tx_buff;                 //!< Encoded TX frame.
+	uint32_t tx_size_max;               //!< Largest TX frame, decoded.
+	uint64_t tx_time_us;                //!< Time of the last frame sent, the link is idle since.
+	uint64_t rx_time_us;                //!< Arrival time of the last frame received.
+	uint64_t read_time_us;              //!< Time of the last read, the frames it holds arrived then.
+	struct uart_slip_rx_s *p_rx;        //!< RX thread, if started.
+	int rx_skip;                        //!< RX data is skipped up to the next SLIP_END, in resync mode.
+
+	int batching;                       //!< TX frames are being gathered.
+	uint8_t *p_batch;                   //!< Encoded TX frames gathered.
+	uint32_t batch_len;                 //!< Size of the frames gathered.
+	uint32_t batch_max;                 //!< TX batch budget.
+	uart_drv_iov_t batch_iov[UART_DRV_IOV_MAX];     //!< Frames gathered.
+	uint32_t batch_cnt;                 //!< Number of frames gathered.
+} uart_slip_t;
+
+
+// open the port, and start its RX thread if p_uart->rx_thread is set and the backend allows it
 int uart_slip_open(uart_drv_t *p_uart);
 
 int uart_slip_close(uart_drv_t *p_uart);
 
+// size the TX buffers for frames of up to nSize bytes, within the host cap; returns the size granted
+uint32_t uart_slip_set_tx_size(uart_drv_t *p_uart, uint32_t nSize);
+
 int uart_slip_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
 
+// send the concatenation of nCount gather elements as one SLIP frame
+int uart_slip_send_iov(uart_drv_t *p_uart, const slip_iov_t *pIov, uint32_t nCount);
+
+// as uart_slip_send_iov(), updating the running CRC-32 in *pCrc over the elements from nCrcStart on
+int uart_slip_send_iov_crc(uart_drv_t *p_uart, const slip_iov_t *pIov, uint32_t nCount, uint32_t nCrcStart, uint32_t *pCrc);
+
 int uart_slip_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize);
 
+// resynchronize after a lost frame: end the partial frame the peer may hold,
+// and discard the RX data pending until the link is quiet
+void uart_slip_drain(uart_drv_t *p_uart);
+
+// gather the following frames and write them together, up to the TX batch budget
+void uart_slip_batch_begin(uart_drv_t *p_uart);
+
+// write the frames gathered and stop gathering
+int uart_slip_flush(uart_drv_t *p_uart);
+
 
 #ifdef __cplusplus
 }   /* ... extern "C" */
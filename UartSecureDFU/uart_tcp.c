@@ -0,0 +1,555 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "uart_drv.h"
+#include "telnet.h"
+#include "sys_time.h"
+#include "logging.h"
+
+#define UART_TCP_PREFIX             "tcp:"
+#define UART_RFC2217_PREFIX         "rfc2217:"
+
+// read timeout, the same as the TTY backend
+#define UART_TCP_READ_TIMEOUT_MS    500
+
+// time to wait for the RFC2217 server to confirm a setting
+#define UART_RFC2217_ACK_TIMEOUT_MS 2000
+
+typedef struct {
+	int rfc2217;                        //!< Telnet COM port control enabled.
+	int corked;                         //!< TX frames are being batched.
+	uint64_t opt_sent;                  //!< Telnet options already answered.
+	uint32_t baud_ack;                  //!< Bit rate confirmed by the RFC2217 server.
+	int fd;                             //!< Socket descriptor.
+	telnet_rx_t telnet;                 //!< Telnet command decoder.
+} uart_tcp_t;
+
+static int uart_tcp_open(uart_drv_t *p_uart);
+static int uart_rfc2217_open(uart_drv_t *p_uart);
+static int uart_tcp_close(uart_drv_t *p_uart);
+static int uart_tcp_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
+static int uart_tcp_send_v(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount);
+static int uart_tcp_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize);
+static int uart_rfc2217_set_baud(uart_drv_t *p_uart, uint32_t baud_rate);
+
+const uart_drv_ops_t uart_tcp_ops =
+{
+	UART_TCP_PREFIX,
+	uart_tcp_open,
+	uart_tcp_close,
+	uart_tcp_send,
+	uart_tcp_send_v,
+	uart_tcp_receive,
+	NULL,
+	NULL,
+	NULL
+};
+
+const uart_drv_ops_t uart_rfc2217_ops =
+{
+	UART_RFC2217_PREFIX,
+	uart_rfc2217_open,
+	uart_tcp_close,
+	uart_tcp_send,
+	NULL,
+	uart_tcp_receive,
+	uart_rfc2217_set_baud,
+	NULL,
+	NULL
+};
+
+static void put_uint32_be(uint8_t *p_data, uint32_t data)
+{
+	*(p_data + 0) = (uint8_t)(data >> 24);
+	*(p_data + 1) = (uint8_t)(data >> 16);
+	*(p_data + 2) = (uint8_t)(data >>  8);
+	*(p_data + 3) = (uint8_t)(data >>  0);
+}
+
+static uint32_t get_uint32_be(const uint8_t *p_data)
+{
+	return ((uint32_t)*(p_data + 0) << 24) | ((uint32_t)*(p_data + 1) << 16) |
+		((uint32_t)*(p_data + 2) << 8) | ((uint32_t)*(p_data + 3) << 0);
+}
+
+static int uart_tcp_write(int fd, const uint8_t *pData, uint32_t nSize)
+{
+	int err_code = 0;
+
+	while (nSize > 0)
+	{
+		ssize_t length = send(fd, pData, nSize, MSG_NOSIGNAL);
+
+		if (length < 0 && errno == EINTR)
+			continue;
+
+		if (length <= 0)
+		{
+			logger_error("Cannot write TCP port!");
+
+			err_code = 1;
+			break;
+		}
+
+		pData += length;
+		nSize -= length;
+	}
+
+	return err_code;
+}
+
+// start or stop batching of the TX frames
+static void uart_tcp_cork(uart_tcp_t *p_tcp, int cork)
+{
+	if (p_tcp->corked != cork)
+	{
+#ifdef TCP_CORK
+		setsockopt(p_tcp->fd, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+#endif
+		p_tcp->corked = cork;
+	}
+}
+
+// answer the server's telnet option negotiation
+static void uart_rfc2217_handler(void *p_context, uint8_t cmd, uint8_t opt, const uint8_t *p_sb, uint32_t sb_len)
+{
+	uart_tcp_t *p_tcp = (uart_tcp_t *)p_context;
+	uint8_t reply[3];
+	int supported = (opt == TELNET_OPT_BINARY || opt == TELNET_OPT_COM_PORT || opt == TELNET_OPT_SGA);
+
+	if (cmd == TELNET_SB)
+	{
+		if (opt == TELNET_OPT_COM_PORT && sb_len == 5 &&
+			p_sb[0] == RFC2217_SET_BAUDRATE + RFC2217_SERVER_OFFSET)
+		{
+			p_tcp->baud_ack = get_uint32_be(p_sb + 1);
+		}
+	}
+	else if ((cmd == TELNET_DO || cmd == TELNET_WILL) && opt < 64 && !(p_tcp->opt_sent & ((uint64_t)1 << opt)))
+	{
+		if (cmd == TELNET_DO)
+			telnet_tx_option(reply, supported ? TELNET_WILL : TELNET_WONT, opt);
+		else
+			telnet_tx_option(reply, supported ? TELNET_DO : TELNET_DONT, opt);
+
+		p_tcp->opt_sent |= ((uint64_t)1 << opt);
+
+		uart_tcp_write(p_tcp->fd, reply, sizeof(reply));
+	}
+}
+
+// read and decode available data, returns the number of data bytes or -1 on error
+static int32_t uart_tcp_read(uart_tcp_t *p_tcp, uint8_t *pData, uint32_t nSize, int timeout_ms)
+{
+	struct pollfd pfd;
+	ssize_t length;
+	int ret;
+
+	pfd.fd = p_tcp->fd;
+	pfd.events = POLLIN;
+
+	ret = poll(&pfd, 1, timeout_ms);
+
+	if (ret < 0)
+		return (errno == EINTR) ? 0 : -1;
+
+	if (ret == 0)
+		return 0;
+
+	length = recv(p_tcp->fd, pData, nSize, 0);
+
+	if (length == 0)
+	{
+		logger_error("TCP connection closed by remote!");
+
+		return -1;
+	}
+	else if (length < 0)
+	{
+		return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+	}
+
+	if (p_tcp->rfc2217)
+		length = telnet_rx_decode(&p_tcp->telnet, pData, length);
+
+	return length;
+}
+
+static int uart_tcp_connect(uart_drv_t *p_uart, int rfc2217)
+{
+	int err_code = 0;
+	uart_tcp_t *p_tcp;
+	char host[256];
+	const char *p_port;
+	struct addrinfo hints, *p_res = NULL, *p_ai;
+	int fd = -1;
+	int on = 1;
+	size_t len;
+
+	// host:port, IPv6 addresses in brackets
+	p_port = strrchr(p_uart->p_addr, ':');
+
+	if (p_port == NULL || (len = p_port - p_uart->p_addr) == 0 || len >= sizeof(host))
+	{
+		logger_error("Invalid TCP address (expected host:port)!");
+
+		return 1;
+	}
+
+	if (p_uart->p_addr[0] == '[' && p_uart->p_addr[len - 1] == ']')
+	{
+		memcpy(host, p_uart->p_addr + 1, len - 2);
+		host[len - 2] = '\0';
+	}
+	else
+	{
+		memcpy(host, p_uart->p_addr, len);
+		host[len] = '\0';
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(host, p_port + 1, &hints, &p_res))
+	{
+		logger_error("Cannot resolve TCP address!");
+
+		return 1;
+	}
+
+	for (p_ai = p_res; p_ai != NULL; p_ai = p_ai->ai_next)
+	{
+		fd = socket(p_ai->ai_family, p_ai->ai_socktype, p_ai->ai_protocol);
+
+		if (fd < 0)
+			continue;
+
+		if (!connect(fd, p_ai->ai_addr, p_ai->ai_addrlen))
+			break;
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(p_res);
+
+	if (fd < 0)
+	{
+		logger_error("Cannot connect TCP port!");
+
+		return 1;
+	}
+
+	// frames are small and latency bound, send them without delay
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	p_tcp = (uart_tcp_t *)calloc(1, sizeof(uart_tcp_t));
+
+	if (p_tcp == NULL)
+	{
+		logger_error("Cannot allocate TCP port state!");
+
+		close(fd);
+
+		err_code = 1;
+	}
+	else
+	{
+		p_tcp->fd = fd;
+		p_tcp->rfc2217 = rfc2217;
+
+		telnet_rx_init(&p_tcp->telnet, uart_rfc2217_handler, p_tcp);
+
+		p_uart->p_priv = p_tcp;
+		p_uart->tty_fd = fd;
+	}
+
+	return err_code;
+}
+
+// send a COM port setting, waiting for the server to confirm the bit rate
+static int uart_rfc2217_send_baud(uart_tcp_t *p_tcp, uint32_t baud_rate)
+{
+	int err_code;
+	uint8_t value[4];
+	uint8_t cmd[6 + 2 * sizeof(value)];
+	uint8_t data[64];
+	uint64_t time_end;
+
+	put_uint32_be(value, baud_rate);
+
+	p_tcp->baud_ack = 0;
+
+	err_code = uart_tcp_write(p_tcp->fd, cmd, telnet_tx_com_port(cmd, RFC2217_SET_BAUDRATE, value, sizeof(value)));
+
+	time_end = sys_time_us() + UART_RFC2217_ACK_TIMEOUT_MS * 1000;
+
+	while (!err_code && p_tcp->baud_ack != baud_rate)
+	{
+		uint64_t time_us = sys_time_us();
+
+		if (time_us >= time_end)
+		{
+			logger_error("RFC2217 server did not confirm the bit rate!");
+
+			err_code = 1;
+		}
+		// no device data is expected while the port is being configured
+		else if (uart_tcp_read(p_tcp, data, sizeof(data), (int)((time_end - time_us) / 1000) + 1) < 0)
+		{
+			logger_error("Cannot read TCP port!");
+
+			err_code = 1;
+		}
+	}
+
+	return err_code;
+}
+
+static int uart_tcp_open(uart_drv_t *p_uart)
+{
+	return uart_tcp_connect(p_uart, 0);
+}
+
+static int uart_rfc2217_open(uart_drv_t *p_uart)
+{
+	int err_code;
+	uart_tcp_t *p_tcp;
+	uint8_t value;
+	// three options, then four COM port settings, each value possibly doubled as an IAC
+	uint8_t cmd[3 * 3 + 4 * (6 + 2 * sizeof(value))];
+	uint32_t len = 0;
+
+	err_code = uart_tcp_connect(p_uart, 1);
+
+	if (!err_code)
+	{
+		p_tcp = (uart_tcp_t *)p_uart->p_priv;
+
+		len += telnet_tx_option(cmd + len, TELNET_WILL, TELNET_OPT_BINARY);
+		len += telnet_tx_option(cmd + len, TELNET_DO, TELNET_OPT_BINARY);
+		len += telnet_tx_option(cmd + len, TELNET_WILL, TELNET_OPT_COM_PORT);
+		p_tcp->opt_sent = ((uint64_t)1 << TELNET_OPT_BINARY) | ((uint64_t)1 << TELNET_OPT_COM_PORT);
+
+		// 8N1 with RTS/CTS flow control, the same as the TTY backend
+		value = 8;
+		len += telnet_tx_com_port(cmd + len, RFC2217_SET_DATASIZE, &value, 1);
+		value = RFC2217_PARITY_NONE;
+		len += telnet_tx_com_port(cmd + len, RFC2217_SET_PARITY, &value, 1);
+		value = RFC2217_STOPSIZE_1;
+		len += telnet_tx_com_port(cmd + len, RFC2217_SET_STOPSIZE, &value, 1);
+		value = RFC2217_CONTROL_HW_FLOW;
+		len += telnet_tx_com_port(cmd + len, RFC2217_SET_CONTROL, &value, 1);
+
+		err_code = uart_tcp_write(p_tcp->fd, cmd, len);
+
+		if (!err_code)
+			err_code = uart_rfc2217_send_baud(p_tcp, p_uart->baud_rate ? p_uart->baud_rate : UART_DRV_BAUD_RATE_DEF);
+
+		if (err_code)
+			uart_tcp_close(p_uart);
+	}
+
+	return err_code;
+}
+
+static int uart_tcp_close(uart_drv_t *p_uart)
+{
+	int err_code = 0;
+	uart_tcp_t *p_tcp = (uart_tcp_t *)p_uart->p_priv;
+
+	if (p_tcp != NULL)
+	{
+		if (close(p_tcp->fd))
+		{
+			logger_error("Cannot close TCP port!");
+
+			err_code = 1;
+		}
+
+		free(p_tcp);
+
+		p_uart->p_priv = NULL;
+		p_uart->tty_fd = -1;
+	}
+	else
+		err_code = 1;
+
+	return err_code;
+}
+
+static int uart_tcp_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+{
+	int err_code = 0;
+	uart_tcp_t *p_tcp = (uart_tcp_t *)p_uart->p_priv;
+
+	// frames written before the next read go out together
+	uart_tcp_cork(p_tcp, 1);
+
+	if (p_tcp->rfc2217)
+	{
+		uint8_t buff[512];
+		uint32_t stp;
+
+		while (!err_code && nSize > 0)
+		{
+			stp = (nSize < sizeof(buff) / 2) ? nSize : sizeof(buff) / 2;
+
+			err_code = uart_tcp_write(p_tcp->fd, buff, telnet_tx_encode(buff, pData, stp));
+
+			pData += stp;
+			nSize -= stp;
+		}
+	}
+	else
+	{
+		err_code = uart_tcp_write(p_tcp->fd, pData, nSize);
+	}
+
+	return err_code;
+}
+
+static int uart_tcp_send_v(uart_drv_t *p_uart, const uart_drv_iov_t *pIov, uint32_t nCount)
+{
+	int err_code = 0;
+	uart_tcp_t *p_tcp = (uart_tcp_t *)p_uart->p_priv;
+	struct iovec iov[UART_DRV_IOV_MAX];
+	struct msghdr msg;
+	uint32_t n;
+
+	for (n = 0; n < nCount; n++)
+	{
+		iov[n].iov_base = (void *)(pIov + n)->pData;
+		iov[n].iov_len = (pIov + n)->nSize;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = nCount;
+
+	uart_tcp_cork(p_tcp, 1);
+
+	while (msg.msg_iovlen > 0)
+	{
+		ssize_t length = sendmsg(p_tcp->fd, &msg, MSG_NOSIGNAL);
+
+		if (length < 0 && errno == EINTR)
+			continue;
+
+		if (length <= 0)
+		{
+			logger_error("Cannot write TCP port!");
+
+			err_code = 1;
+			break;
+		}
+
+		// skip the elements written, then continue a partial one
+		while (msg.msg_iovlen > 0 && (size_t)length >= msg.msg_iov->iov_len)
+		{
+			length -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+
+		if (msg.msg_iovlen > 0)
+		{
+			msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + length;
+			msg.msg_iov->iov_len -= length;
+		}
+	}
+
+	return err_code;
+}
+
+static int uart_tcp_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
+{
+	int err_code = 0;
+	uart_tcp_t *p_tcp = (uart_tcp_t *)p_uart->p_priv;
+	uint64_t time_end = sys_time_us() + UART_TCP_READ_TIMEOUT_MS * 1000;
+	int32_t length = 0;
+
+	// a read means a response is expected, flush the batched frames
+	uart_tcp_cork(p_tcp, 0);
+
+	// telnet commands may arrive without any data
+	do
+	{
+		uint64_t time_us = sys_time_us();
+
+		if (time_us >= time_end)
+			break;
+
+		length = uart_tcp_read(p_tcp, pData, nSize, (int)((time_end - time_us) / 1000) + 1);
+	} while (length == 0);
+
+	if (length < 0)
+	{
+		logger_error("Cannot read TCP port!");
+
+		err_code = 1;
+	}
+	else
+		*pSize = length;
+
+	return err_code;
+}
+
+static int uart_rfc2217_set_baud(uart_drv_t *p_uart, uint32_t baud_rate)
+{
+	uart_tcp_t *p_tcp = (uart_tcp_t *)p_uart->p_priv;
+
+	uart_tcp_cork(p_tcp, 0);
+
+	return uart_rfc2217_send_baud(p_tcp, baud_rate);
+}
@@ -38,21 +38,39 @@
 *
 */
 
+#include <stdio.h>
 #include <string.h>
 #include "uart_drv.h"
 #include "logging.h"
 
-int uart_drv_open(uart_drv_t *p_uart)
+static int uart_tty_open(uart_drv_t *p_uart);
+static int uart_tty_close(uart_drv_t *p_uart);
+static int uart_tty_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize);
+static int uart_tty_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize);
+static int uart_tty_set_baud(uart_drv_t *p_uart, uint32_t baud_rate);
+
+const uart_drv_ops_t uart_tty_ops =
+{
+	NULL,
+	uart_tty_open,
+	uart_tty_close,
+	uart_tty_send,
+	NULL,
+	uart_tty_receive,
+	uart_tty_set_baud,
+	NULL,
+	NULL
+};
+
+static int uart_tty_open(uart_drv_t *p_uart)
 {
 	int err_code = 0;
-	const char *portName = p_uart->p_PortName;
-	CHAR portFileName[14];
+	const char *portName = p_uart->p_addr;
+	CHAR portFileName[MAX_PATH] = { 0 };
 	HANDLE handlePort_ = INVALID_HANDLE_VALUE;
 
-	strcpy(portFileName, "\\\\.\\");
-	if (strlen(portName) <= 6)
-		strcat(portFileName, portName);
-	else
+	// _snprintf() fails on truncation
+	if (_snprintf(portFileName, sizeof(portFileName) - 1, "\\\\.\\%s", portName) < 0)
 	{
 		logger_error("Invalid COM port!");
 
@@ -91,7 +109,7 @@ int uart_drv_open(uart_drv_t *p_uart)
 
 		if (!err_code)
 		{
-			config_.BaudRate = 115200;		// Specify buad rate of communicaiton.
+			config_.BaudRate = p_uart->baud_rate ? p_uart->baud_rate : UART_DRV_BAUD_RATE_DEF;	// Specify buad rate of communicaiton.
 			config_.StopBits = 0;			// Specify stopbit of communication.
 			config_.Parity = 0;				// Specify parity of communication.
 			config_.ByteSize = 8;			// Specify byte of size of communication.
@@ -145,7 +163,7 @@ int uart_drv_open(uart_drv_t *p_uart)
 	if (err_code && handlePort_ != INVALID_HANDLE_VALUE)
 	{
 		p_uart->portHandle = handlePort_;
-		uart_drv_close(p_uart);
+		uart_tty_close(p_uart);
 
 		handlePort_ = INVALID_HANDLE_VALUE;
 	}
@@ -155,7 +173,7 @@ int uart_drv_open(uart_drv_t *p_uart)
 	return err_code;
 }
 
-int uart_drv_close(uart_drv_t *p_uart)
+static int uart_tty_close(uart_drv_t *p_uart)
 {
 	int err_code = 0;
 	HANDLE portHandle = p_uart->portHandle;
@@ -175,7 +193,7 @@ int uart_drv_close(uart_drv_t *p_uart)
 	return err_code;
 }
 
-int uart_drv_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
+static int uart_tty_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
 {
 	int err_code = 0;
 	HANDLE portHandle = p_uart->portHandle;
@@ -195,7 +213,7 @@ int uart_drv_send(uart_drv_t *p_uart, const uint8_t *pData, uint32_t nSize)
 	return err_code;
 }
 
-int uart_drv_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
+static int uart_tty_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_t *pSize)
 {
 	int err_code = 0;
 	HANDLE portHandle = p_uart->portHandle;
@@ -216,3 +234,29 @@ int uart_drv_receive(uart_drv_t *p_uart, uint8_t *pData, uint32_t nSize, uint32_
 
 	return err_code;
 }
+
+static int uart_tty_set_baud(uart_drv_t *p_uart, uint32_t baud_rate)
+{
+	int err_code = 0;
+	DCB config_;
+
+	if (GetCommState(p_uart->portHandle, &config_) == FALSE)
+	{
+		logger_error("Cannot get COM configuration!");
+
+		err_code = 1;
+	}
+	else
+	{
+		config_.BaudRate = baud_rate;
+
+		if (SetCommState(p_uart->portHandle, &config_) == FALSE)
+		{
+			logger_error("Cannot set COM configuration!");
+
+			err_code = 1;
+		}
+	}
+
+	return err_code;
+}
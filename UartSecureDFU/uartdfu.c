@@ -0,0 +1,149 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#include <string.h>
+#include "uartdfu.h"
+#include "uart_slip.h"
+#include "dfu_serial.h"
+#include "logging.h"
+#include "sys_time.h"
+
+typedef struct
+{
+	const uartdfu_config_t *p_config;
+	dfu_result_t *p_dfu_result;
+} uartdfu_run_t;
+
+static void uartdfu_progress(void *p_context, uint32_t offset, uint32_t size, uint64_t eta_us)
+{
+	uartdfu_run_t *p_run = (uartdfu_run_t *)p_context;
+	const dfu_result_t *p_dfu_result = p_run->p_dfu_result;
+	uartdfu_progress_t progress;
+
+	progress.image = p_dfu_result->current;
+	progress.num_images = p_dfu_result->num_images;
+	progress.p_image_name = p_dfu_result->images[p_dfu_result->current].p_name;
+	progress.offset = offset;
+	progress.size = size;
+	progress.eta_us = eta_us;
+
+	p_run->p_config->progress_cb(p_run->p_config->p_context, &progress);
+}
+
+void uartdfu_config_init(uartdfu_config_t *p_config)
+{
+	memset(p_config, 0, sizeof(*p_config));
+
+	p_config->tx_batch_size = UART_SLIP_BATCH_SIZE_DEF;
+	p_config->keepalive_percent = DFU_KEEPALIVE_PERCENT_DEF;
+}
+
+int uartdfu_run(const uartdfu_config_t *p_config, uartdfu_result_t *p_result)
+{
+	int err_code;
+	uint64_t time_us = sys_time_us();
+	uart_drv_t uart;
+	dfu_package_t *p_pkg = NULL;
+	uartdfu_run_t run;
+
+	memset(p_result, 0, sizeof(*p_result));
+	memset(&uart, 0, sizeof(uart));
+
+	uart.p_PortName = p_config->p_port;
+	uart.p_ProfileName = p_config->p_profile;
+	uart.p_EtaLogName = p_config->p_eta_log;
+	uart.p_JournalName = p_config->p_journal;
+	uart.baud_rate = p_config->baud_rate;
+	uart.tx_batch_size = p_config->tx_batch_size;
+	uart.frame_size_cap = p_config->frame_size_cap;
+	uart.keepalive_percent = p_config->keepalive_percent;
+	uart.target_timeout_ms = p_config->target_timeout_ms;
+	uart.rx_thread = p_config->rx_thread;
+	uart.slip_resync = p_config->slip_resync;
+	uart.p_cancel = p_config->p_cancel;
+
+	if (p_config->progress_cb != NULL)
+	{
+		run.p_config = p_config;
+		run.p_dfu_result = &p_result->dfu;
+
+		uart.p_progress = uartdfu_progress;
+		uart.p_progress_context = &run;
+	}
+
+	if (p_config->p_port == NULL || (p_config->p_package == NULL && p_config->p_package_src == NULL))
+	{
+		logger_error("Invalid DFU configuration!");
+
+		err_code = 1;
+	}
+	else if (p_config->p_package_src != NULL)
+	{
+		err_code = dfu_package_load_source(p_config->p_package_src, &p_pkg);
+	}
+	else
+	{
+		err_code = dfu_package_load(p_config->p_package, &p_pkg);
+	}
+
+	p_result->load_time_us = sys_time_us() - time_us;
+
+	if (!err_code)
+		err_code = uart_slip_open(&uart);
+
+	if (!err_code)
+	{
+		if (p_config->verify_only)
+			err_code = dfu_verify_loaded_package(&uart, p_pkg);
+		else
+			err_code = dfu_send_loaded_package(&uart, p_pkg, p_config->skip_installed, &p_result->dfu);
+
+		p_result->stats = uart.stats;
+
+		uart_slip_close(&uart);
+	}
+
+	dfu_package_free(p_pkg);
+
+	p_result->err_code = err_code;
+	p_result->cancelled = (p_config->p_cancel != NULL && *p_config->p_cancel);
+	p_result->time_us = sys_time_us() - time_us;
+
+	return err_code;
+}
@@ -0,0 +1,119 @@
+/**
+* Copyright (c) 2018, Nordic Semiconductor ASA
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification,
+* are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form, except as embedded into a Nordic
+*    Semiconductor ASA integrated circuit in a product or a software update for
+*    such product, must reproduce the above copyright notice, this list of
+*    conditions and the following disclaimer in the documentation and/or other
+*    materials provided with the distribution.
+*
+* 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+*    contributors may be used to endorse or promote products derived from this
+*    software without specific prior written permission.
+*
+* 4. This software, with or without modification, must only be used with a
+*    Nordic Semiconductor ASA integrated circuit.
+*
+* 5. Any software provided in binary form under this license must not be reverse
+*    engineered, decompiled, modified and/or disassembled.
+*
+* THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+* OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+* OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+* GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+* HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+* LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+* OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+#pragma once
+ 
+#ifndef _INC_UARTDFU
+#define _INC_UARTDFU
+
+#include <stdint.h>
+#include "dfu.h"
+#include "uart_drv.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif  /* __cplusplus */
+
+/*
+ * libuartdfu: the DFU host as a library, for test stations linking it
+ * directly. A run is described by an explicit configuration, reports the
+ * firmware progress byte by byte and may be cancelled from another thread.
+ */
+
+/**
+* @brief Firmware progress, as the frames are sent.
+*/
+typedef struct
+{
+	int image;                          //!< Image being sent, in send order.
+	int num_images;                     //!< Number of images of the package.
+	const char *p_image_name;           //!< Image type name.
+	uint32_t offset;                    //!< Firmware bytes sent.
+	uint32_t size;                      //!< Firmware size.
+	uint64_t eta_us;                    //!< Firmware time left, predicted.
+} uartdfu_progress_t;
+
+typedef void (*uartdfu_progress_cb_t)(void *p_context, const uartdfu_progress_t *p_progress);
+
+typedef struct
+{
+	const char *p_port;                 //!< Serial port, as on the command line.
+	const char *p_package;              //!< Package file, DFU_PKG_STDIN for the standard input.
+	const dfu_pkg_source_t *p_package_src;  //!< Package in memory or from a file descriptor, used instead of p_package if set.
+	uint32_t baud_rate;                 //!< Bit rate, 0 for the default.
+	uint32_t tx_batch_size;             //!< SLIP TX batch budget in bytes, 0 for one write per frame.
+	uint32_t frame_size_cap;            //!< Host cap of the frames sent, 0 for the default.
+	uint32_t keepalive_percent;         //!< Idle share of the target timeout before a ping, 0 for no keepalive.
+	uint32_t target_timeout_ms;         //!< Shortest bootloader timeout, 0 for the SDK default.
+	int rx_thread;                      //!< Receive from a TTY port on a thread of its own.
+	int slip_resync;                    //!< Drop malformed frames and line noise, resync on the next SLIP_END.
+	const char *p_profile;              //!< Link profile file, NULL not to tune the link.
+	const char *p_eta_log;              //!< CSV file the predicted and actual times are appended to, may be NULL.
+	const char *p_journal;              //!< Transfer journal file, NULL not to resume interrupted transfers.
+	int skip_installed;                 //!< Skip the images the target already runs.
+	int verify_only;                    //!< Only check that the target runs the package.
+
+	uartdfu_progress_cb_t progress_cb;  //!< Optional, called from the calling thread.
+	void *p_context;                    //!< Progress callback context.
+	volatile int *p_cancel;             //!< Optional cancellation token, set it to stop the run.
+} uartdfu_config_t;
+
+typedef struct
+{
+	int err_code;                       //!< 0 on success.
+	int cancelled;                      //!< The run has been cancelled.
+	uint64_t load_time_us;              //!< Time to open the package and decompress its images.
+	uint64_t time_us;                   //!< Time of the whole run.
+	dfu_result_t dfu;                   //!< Outcome of each image.
+	uart_drv_stats_t stats;             //!< Port I/O counters.
+} uartdfu_result_t;
+
+// initialize a configuration with the defaults
+void uartdfu_config_init(uartdfu_config_t *p_config);
+
+// update or verify a target, blocking until done or cancelled, returns p_result->err_code
+int uartdfu_run(const uartdfu_config_t *p_config, uartdfu_result_t *p_result);
+
+#ifdef __cplusplus
+}   /* ... extern "C" */
+#endif  /* __cplusplus */
+
+
+#endif // _INC_UARTDFU
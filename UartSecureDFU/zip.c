@@ -175,6 +175,41 @@ cleanup:
     return NULL;
 }
 
+struct zip_t *zip_stream_open(const char *stream, size_t size, int level,
+                              char mode) {
+    struct zip_t *zip = NULL;
+
+    if (!stream || size < 1) {
+        // zip_t archive stream is empty or NULL
+        goto cleanup;
+    }
+
+    if (level < 0) level = MZ_DEFAULT_LEVEL;
+    if ((level & 0xF) > MZ_UBER_COMPRESSION) {
+        // Wrong compression level
+        goto cleanup;
+    }
+
+    // only reading is supported, the stream is not copied
+    if (mode != 'r') goto cleanup;
+
+    zip = (struct zip_t *)calloc((size_t)1, sizeof(struct zip_t));
+    if (!zip) goto cleanup;
+
+    zip->level = level;
+    if (!mz_zip_reader_init_mem(&(zip->archive), stream, size,
+                                level | MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY)) {
+        // Cannot initialize zip_archive reader
+        goto cleanup;
+    }
+
+    return zip;
+
+cleanup:
+    CLEANUP(zip);
+    return NULL;
+}
+
 void zip_close(struct zip_t *zip) {
     if (zip) {
         // Always finalize, even if adding failed for some reason, so we have a
@@ -588,6 +623,37 @@ int zip_entry_read(struct zip_t *zip, void **buf, size_t *bufsize) {
     return (*buf) ? 0 : -1;
 }
 
+int zip_entry_read_unchecked(struct zip_t *zip, void **buf, size_t *bufsize) {
+    mz_zip_archive *pzip = NULL;
+    mz_uint idx;
+    mz_uint flags = 0;
+
+    if (!zip) {
+        // zip_t handler is not initialized
+        return -1;
+    }
+
+    pzip = &(zip->archive);
+    if (pzip->m_zip_mode != MZ_ZIP_MODE_READING || zip->entry.index < 0) {
+        // the entry is not found or we do not have read access
+        return -1;
+    }
+
+    idx = (mz_uint)zip->entry.index;
+    if (mz_zip_reader_is_file_a_directory(pzip, idx)) {
+        // the entry is a directory
+        return -1;
+    }
+
+    if (!zip->entry.method) {
+        // STORED data is the entry itself, skip the CRC-32 pass
+        flags |= MZ_ZIP_FLAG_COMPRESSED_DATA;
+    }
+
+    *buf = mz_zip_reader_extract_to_heap(pzip, idx, bufsize, flags);
+    return (*buf) ? 0 : -1;
+}
+
 int zip_entry_noallocread(struct zip_t *zip, void *buf, size_t bufsize) {
     mz_zip_archive *pzip = NULL;
     mz_uint idx;
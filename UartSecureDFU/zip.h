@@ -46,6 +46,22 @@ struct zip_t;
 */
 extern struct zip_t *zip_open(const char *zipname, int level, char mode);
 
+/*
+  Opens zip archive stream from memory, for reading only.
+
+  Args:
+    stream: zip archive stream, it is not copied and must stay valid until
+            the archive is closed.
+    size: stream size.
+    level: compression level (0-9 are the standard zlib-style levels).
+    mode: file access mode, only 'r' is supported.
+
+  Returns:
+    The zip archive handler or NULL on error
+*/
+extern struct zip_t *zip_stream_open(const char *stream, size_t size,
+                                     int level, char mode);
+
 /*
   Closes the zip archive, releases resources - always finalize.
 
@@ -197,6 +213,21 @@ extern int zip_entry_fwrite(struct zip_t *zip, const char *filename);
 */
 extern int zip_entry_read(struct zip_t *zip, void **buf, size_t *bufsize);
 
+/*
+  Extracts the current zip entry into output buffer, as zip_entry_read().
+  The CRC-32 of a STORED entry is not checked, it is left to the caller
+  (see zip_entry_crc32). DEFLATED entries are checked while decompressing.
+
+  Args:
+    zip: zip archive handler.
+    buf: output buffer.
+    bufsize: output buffer size (in bytes).
+
+  Returns:
+    The return code - 0 on success, negative number (< 0) on error.
+*/
+extern int zip_entry_read_unchecked(struct zip_t *zip, void **buf, size_t *bufsize);
+
 /*
   Extracts the current zip entry into a memory buffer using no memory allocation.
 